@@ -0,0 +1,43 @@
+#include <benchmark/benchmark.h>
+
+#include <sstream>
+
+#include "common.h"
+#include "metadata.h"
+
+using MD = reven::binresource::Metadata;
+
+class BenchMDWriter : reven::binresource::MetadataWriter {
+public:
+	static MD dummy_md() {
+		return write(42, "1.0.0-dummy", "BenchMetaDataWriter", "1.0.0", "Benchmarks version 1.0.0", 42424242);
+	}
+};
+
+static void BM_metadata_serialize(benchmark::State& state)
+{
+	const auto md = BenchMDWriter::dummy_md();
+	std::stringstream stream;
+
+	for (auto _ : state) {
+		stream.seekp(0);
+		md.serialize(stream);
+	}
+
+	state.SetBytesProcessed(state.iterations() * stream.tellp());
+}
+BENCHMARK(BM_metadata_serialize);
+
+static void BM_metadata_deserialize(benchmark::State& state)
+{
+	std::stringstream stream;
+	BenchMDWriter::dummy_md().serialize(stream);
+
+	for (auto _ : state) {
+		stream.seekg(0);
+		benchmark::DoNotOptimize(MD::deserialize(reven::binresource::metadata_version, stream));
+	}
+
+	state.SetBytesProcessed(state.iterations() * stream.tellg());
+}
+BENCHMARK(BM_metadata_deserialize);
@@ -0,0 +1,274 @@
+#include <benchmark/benchmark.h>
+
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "metadata.h"
+#include "reader.h"
+#include "writer.h"
+
+using MD = reven::binresource::Metadata;
+using Reader = reven::binresource::Reader;
+using Writer = reven::binresource::Writer;
+
+class BenchMDWriter : reven::binresource::MetadataWriter {
+public:
+	static MD dummy_md() {
+		return write(42, "1.0.0-dummy", "BenchMetaDataWriter", "1.0.0", "Benchmarks version 1.0.0", 42424242);
+	}
+
+	static MD dummy_md2() {
+		return write(24, "1.2.0-dummy", "BenchMetaDataWriter2", "1.2.0", "Benchmarks version 1.2.0", 42424243);
+	}
+};
+
+struct transient_directory {
+	//! Path of created directory.
+	std::string path;
+
+	//! Create a uniquely named temporary directory in the temporary directory of the system.
+	//! Throw if directory cannot be created.
+	transient_directory() {
+		const char* tmp_dir = getenv("TMPDIR");
+		std::string tmpl = std::string(tmp_dir != nullptr ? tmp_dir : "/tmp") + "/rvnbinresource-bench-XXXXXX";
+
+		if (mkdtemp(&tmpl[0]) == nullptr) {
+			throw std::runtime_error("Can't create the directory " + tmpl);
+		}
+
+		this->path = tmpl;
+	}
+
+	//! Delete created directory and the files it contains.
+	~transient_directory() {
+		DIR* dir = opendir(this->path.c_str());
+		if (dir == nullptr) {
+			return;
+		}
+
+		while (const auto* entry = readdir(dir)) {
+			const std::string name = entry->d_name;
+			if (name != "." && name != "..") {
+				unlink((this->path + "/" + name).c_str());
+			}
+		}
+
+		closedir(dir);
+		rmdir(this->path.c_str());
+	}
+};
+
+static transient_directory tmp_dir;
+
+//! Size of the payload of the resources read by the payload benchmarks
+constexpr std::size_t payload_size = 64 * 1024 * 1024;
+
+//! Backend used to store the resource
+enum class Backend {
+	//! std::stringstream given to the stream overloads
+	StringStream,
+	//! std::fstream given to the stream overloads
+	FStream,
+	//! Filename overloads
+	File,
+};
+
+std::string backend_path(const char* name) {
+	return tmp_dir.path + "/" + name;
+}
+
+template <Backend backend>
+Writer create_writer(const std::string& path, const MD& md) {
+	switch (backend) {
+		case Backend::StringStream:
+			return Writer::create(std::make_unique<std::stringstream>(), md);
+		case Backend::FStream:
+			return Writer::create(
+				std::make_unique<std::fstream>(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc), md
+			);
+		case Backend::File:
+			break;
+	}
+
+	return Writer::create(path.c_str(), md);
+}
+
+//! Content of the resource used by the StringStream backend
+const std::string& payload_resource() {
+	static const std::string resource = []() {
+		auto writer = Writer::create(std::make_unique<std::stringstream>(), BenchMDWriter::dummy_md());
+
+		const std::vector<char> block(1024 * 1024, 'a');
+		for (std::size_t written = 0; written < payload_size; written += block.size()) {
+			writer.stream().write(block.data(), block.size());
+		}
+
+		return static_cast<std::stringstream&>(*std::move(writer).finalize()).str();
+	}();
+
+	return resource;
+}
+
+//! Filename of the resource used by the FStream and File backends
+const std::string& payload_file() {
+	static const std::string path = []() {
+		const auto path = backend_path("payload.bin");
+
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out.write(payload_resource().data(), payload_resource().size());
+
+		return path;
+	}();
+
+	return path;
+}
+
+template <Backend backend>
+Reader open_reader(const std::string& path, const std::string& content) {
+	switch (backend) {
+		case Backend::StringStream:
+			return Reader::open(std::make_unique<std::stringstream>(content));
+		case Backend::FStream:
+			return Reader::open(std::make_unique<std::fstream>(path, std::ios::binary | std::ios::in));
+		case Backend::File:
+			break;
+	}
+
+	return Reader::open(path.c_str());
+}
+
+template <Backend backend>
+static void BM_writer_create(benchmark::State& state)
+{
+	const auto md = BenchMDWriter::dummy_md();
+	const auto path = backend_path("create.bin");
+
+	for (auto _ : state) {
+		auto writer = create_writer<backend>(path, md);
+		benchmark::DoNotOptimize(writer.md_size());
+	}
+}
+BENCHMARK_TEMPLATE(BM_writer_create, Backend::StringStream);
+BENCHMARK_TEMPLATE(BM_writer_create, Backend::FStream);
+BENCHMARK_TEMPLATE(BM_writer_create, Backend::File);
+
+template <Backend backend>
+static void BM_writer_set_metadata(benchmark::State& state)
+{
+	const auto md = BenchMDWriter::dummy_md();
+	const auto md2 = BenchMDWriter::dummy_md2();
+	auto writer = create_writer<backend>(backend_path("set_metadata.bin"), md);
+
+	bool flip = false;
+	for (auto _ : state) {
+		writer.set_metadata(flip ? md : md2);
+		flip = !flip;
+	}
+}
+BENCHMARK_TEMPLATE(BM_writer_set_metadata, Backend::StringStream);
+BENCHMARK_TEMPLATE(BM_writer_set_metadata, Backend::FStream);
+BENCHMARK_TEMPLATE(BM_writer_set_metadata, Backend::File);
+
+template <Backend backend>
+static void BM_reader_open(benchmark::State& state)
+{
+	const auto path = backend_path("open.bin");
+	std::string content;
+
+	{
+		auto writer = Writer::create(std::make_unique<std::stringstream>(), BenchMDWriter::dummy_md());
+		content = static_cast<std::stringstream&>(*std::move(writer).finalize()).str();
+
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out.write(content.data(), content.size());
+	}
+
+	for (auto _ : state) {
+		auto reader = open_reader<backend>(path, content);
+		benchmark::DoNotOptimize(reader.md_size());
+	}
+}
+BENCHMARK_TEMPLATE(BM_reader_open, Backend::StringStream);
+BENCHMARK_TEMPLATE(BM_reader_open, Backend::FStream);
+BENCHMARK_TEMPLATE(BM_reader_open, Backend::File);
+
+template <Backend backend>
+static void BM_write_sequential(benchmark::State& state)
+{
+	const std::vector<char> block(state.range(0), 'a');
+	auto writer = create_writer<backend>(backend_path("write.bin"), BenchMDWriter::dummy_md());
+
+	std::size_t written = 0;
+	for (auto _ : state) {
+		// Wrap around to keep the size of the resource bounded
+		if (written + block.size() > payload_size) {
+			writer.stream().seekp(writer.md_size());
+			written = 0;
+		}
+
+		writer.stream().write(block.data(), block.size());
+		written += block.size();
+	}
+
+	writer.stream().flush();
+
+	state.SetBytesProcessed(state.iterations() * block.size());
+}
+BENCHMARK_TEMPLATE(BM_write_sequential, Backend::StringStream)->RangeMultiplier(16)->Range(16, 1024 * 1024);
+BENCHMARK_TEMPLATE(BM_write_sequential, Backend::FStream)->RangeMultiplier(16)->Range(16, 1024 * 1024);
+BENCHMARK_TEMPLATE(BM_write_sequential, Backend::File)->RangeMultiplier(16)->Range(16, 1024 * 1024);
+
+template <Backend backend>
+static void BM_read_sequential(benchmark::State& state)
+{
+	std::vector<char> block(state.range(0));
+	auto reader = open_reader<backend>(payload_file(), payload_resource());
+
+	std::size_t read = 0;
+	for (auto _ : state) {
+		if (read + block.size() > payload_size) {
+			reader.stream().seekg(reader.md_size());
+			read = 0;
+		}
+
+		reader.stream().read(block.data(), block.size());
+		read += block.size();
+	}
+
+	state.SetBytesProcessed(state.iterations() * block.size());
+}
+BENCHMARK_TEMPLATE(BM_read_sequential, Backend::StringStream)->RangeMultiplier(16)->Range(16, 1024 * 1024);
+BENCHMARK_TEMPLATE(BM_read_sequential, Backend::FStream)->RangeMultiplier(16)->Range(16, 1024 * 1024);
+BENCHMARK_TEMPLATE(BM_read_sequential, Backend::File)->RangeMultiplier(16)->Range(16, 1024 * 1024);
+
+template <Backend backend>
+static void BM_read_random(benchmark::State& state)
+{
+	std::vector<char> block(state.range(0));
+	auto reader = open_reader<backend>(payload_file(), payload_resource());
+
+	const std::uint64_t block_count = payload_size / block.size();
+	// Deterministic pseudo-random sequence, so that runs are comparable
+	std::uint64_t seed = 42;
+
+	for (auto _ : state) {
+		seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+
+		reader.stream().seekg(reader.md_size() + (seed >> 33) % block_count * block.size());
+		reader.stream().read(block.data(), block.size());
+	}
+
+	state.SetBytesProcessed(state.iterations() * block.size());
+}
+BENCHMARK_TEMPLATE(BM_read_random, Backend::StringStream)->RangeMultiplier(16)->Range(16, 1024 * 1024);
+BENCHMARK_TEMPLATE(BM_read_random, Backend::FStream)->RangeMultiplier(16)->Range(16, 1024 * 1024);
+BENCHMARK_TEMPLATE(BM_read_random, Backend::File)->RangeMultiplier(16)->Range(16, 1024 * 1024);
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+namespace reven {
+namespace binresource {
+
+//! Default size of the buffer of the streams of the resources opened from a filename
+constexpr std::size_t default_stream_buffer_size = 1024 * 1024;
+
+///
+/// Non-owning view of a memory area to write, for the vectored writes
+///
+struct ConstBuffer {
+	const void* data;
+	std::size_t size;
+};
+
+///
+/// Non-owning view of a memory area to fill, for the vectored reads
+///
+struct MutableBuffer {
+	void* data;
+	std::size_t size;
+};
+
+}} // namespace reven::binresource
@@ -3,7 +3,14 @@
 namespace reven {
 namespace binresource {
 
-constexpr std::uint32_t metadata_version = 1;
+constexpr std::uint32_t metadata_version = 2;
 constexpr std::uint64_t magic = 0x72766e62696e7273; // rvnbinrs for "reven binary resource"
 
+constexpr std::uint32_t pack_version = 1;
+constexpr std::uint64_t pack_magic = 0x72766e627061636b; // rvnbpack for "reven binary pack"
+
+constexpr std::uint32_t delta_version = 1;
+constexpr std::uint64_t delta_magic = 0x72766e6264656c74; // rvnbdelt for "reven binary delta"
+constexpr std::uint64_t signature_magic = 0x72766e627369676e; // rvnbsign for "reven binary signature"
+
 }} // namespace reven::binresource
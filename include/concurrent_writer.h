@@ -0,0 +1,111 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include "metadata.h"
+#include "writer.h"
+
+namespace reven {
+namespace binresource {
+
+//! Default time the finalization of a ConcurrentWriter waits for the reserved ranges to be written
+constexpr std::chrono::milliseconds default_finalize_timeout{10000};
+
+///
+/// Writer of a resource whose payload is written by several threads in parallel.
+/// Each producer reserves a range of the payload, then writes it with positional writes, without any lock: the
+/// ranges can be written in any order and concurrently.
+/// The finalization waits for all the reserved ranges to be written, so the file is consistent afterwards. A range
+/// that is never written, e.g. because its producer failed, makes the finalization fail instead.
+///
+/// Example:
+///
+/// ```cpp
+/// auto writer = ConcurrentWriter::create("foo.bin", md);
+/// // On any thread:
+/// const auto offset = writer.append(chunk.data(), chunk.size());
+/// // Once all the producers are done reserving:
+/// std::move(writer).finalize();
+/// ```
+///
+class ConcurrentWriter {
+public:
+	///
+	/// \brief create Create a resource with the metadata and filename passed in parameter
+	/// \param filename The filename of the resource to open
+	/// \param md The metadata to write in the file
+	/// \param options Options of the writing of the file. Only the size hint is used.
+	/// \throws WriterError if an error occurs during the writing of the file
+	static ConcurrentWriter create(const char* filename, const Metadata& md,
+	                               const WriterOptions& options = WriterOptions{});
+
+	ConcurrentWriter(ConcurrentWriter&&);
+	ConcurrentWriter& operator=(ConcurrentWriter&&);
+
+	//! Close the writer if it wasn't finalized, without waiting for the reserved ranges: they must all be written.
+	//! The errors are ignored.
+	~ConcurrentWriter();
+
+public:
+	//! The size of the metadata (the offset from the beginning of the file to the position 0 for the user)
+	std::size_t md_size() const;
+
+	///
+	/// \brief reserve Reserve the next `size` bytes of the payload. Thread-safe.
+	/// The range must be written completely with `write` before the finalization can complete.
+	/// \param size The size of the range
+	/// \return The offset of the range in the payload
+	/// \throws WriterError if the writer is finalized
+	std::uint64_t reserve(std::uint64_t size);
+
+	///
+	/// \brief write Write data in a reserved range of the payload. Thread-safe.
+	/// A range can be written in several calls, but each byte must be written exactly once.
+	/// \param offset The offset in the payload of the data
+	/// \param data The data to write
+	/// \param size The size of the data
+	/// \throws WriterError if an error occurs during the writing
+	void write(std::uint64_t offset, const void* data, std::uint64_t size);
+
+	///
+	/// \brief append Reserve a range and write data in it. Thread-safe.
+	/// \param data The data to write
+	/// \param size The size of the data
+	/// \return The offset of the data in the payload
+	/// \throws WriterError if the writer is finalized or if an error occurs during the writing
+	std::uint64_t append(const void* data, std::uint64_t size);
+
+	//! Size of the payload reserved so far
+	std::uint64_t size() const;
+
+	///
+	/// \brief set_metadata Update the metadata of the resource. Thread-safe.
+	/// \param md The metadata to write in the resource
+	/// \throws WriterError if an error occurs during the writing of the resource
+	void set_metadata(const Metadata& md);
+
+	///
+	/// \brief finalize Stop accepting reservations, wait for all the reserved ranges to be written and set the file to
+	/// its final size. Must not be called concurrently with other calls on the writer, and the producers still
+	/// writing when the timeout expires must not use the writer anymore.
+	/// \param timeout The maximum time to wait for the reserved ranges to be written
+	/// \throws WriterError if a write failed or if a reserved range wasn't written before the timeout
+	void finalize(std::chrono::milliseconds timeout = default_finalize_timeout) &&;
+
+private:
+	struct State;
+
+	explicit ConcurrentWriter(std::unique_ptr<State>&& state);
+
+	//! Stop accepting reservations, wait up to `timeout` for the pending writes and close the file. Returns false if a
+	//! write failed or if a reserved range wasn't written.
+	bool close(std::chrono::milliseconds timeout);
+
+private:
+	//! Stored in a pointer because the atomics are not movable
+	std::unique_ptr<State> state_;
+};
+
+}} // namespace reven::binresource
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+#include "metadata.h"
+#include "writer.h"
+
+namespace reven {
+namespace binresource {
+
+//! Default size of the blocks compared by the deltas
+constexpr std::size_t default_delta_block_size = 64 * 1024;
+
+///
+/// Exception that occurs when a signature or a delta can't be made or applied
+///
+class DeltaError : public std::runtime_error {
+public:
+	DeltaError(const char* msg) : std::runtime_error(msg) {}
+};
+
+///
+/// Hashes of the blocks of the payload of a resource, from which a delta to a new version of the resource is made.
+/// The signature is much smaller than the resource, so it can be sent to where the new version is, instead of the
+/// resource itself.
+///
+class Signature {
+public:
+	///
+	/// \brief compute Read the payload of a resource and hash its blocks
+	/// \param filename The filename of the resource
+	/// \param block_size The size of the blocks
+	/// \throws DeltaError if the resource can't be read
+	static Signature compute(const char* filename, std::size_t block_size = default_delta_block_size);
+
+	///
+	/// \brief deserialize Read a signature written by `serialize`
+	/// \throws DeltaError if the stream doesn't contain a signature
+	static Signature deserialize(std::istream& in);
+
+public:
+	//! Write the signature in the stream
+	void serialize(std::ostream& out) const;
+
+	//! The type of the resource
+	std::uint32_t type() const { return type_; }
+	std::uint64_t block_size() const { return block_size_; }
+	std::uint64_t payload_size() const { return payload_size_; }
+
+	//! The hashes of each block of the payload
+	const std::vector<std::array<std::uint64_t, 2>>& block_hashes() const { return block_hashes_; }
+
+private:
+	Signature() = default;
+
+private:
+	std::uint32_t type_ = 0;
+	std::uint64_t block_size_ = 0;
+	std::uint64_t payload_size_ = 0;
+	std::vector<std::array<std::uint64_t, 2>> block_hashes_;
+};
+
+//! Statistics of a delta made by `make_delta`
+struct DeltaStats {
+	//! Number of bytes of the new payload taken from the base resource
+	std::uint64_t copied_size = 0;
+	//! Number of bytes of the new payload stored in the delta
+	std::uint64_t literal_size = 0;
+};
+
+///
+/// \brief make_delta Write the delta from the resource of the signature to a new version of this resource.
+/// The new payload is compared block by block with the base one, and only the blocks that can't be found in the base
+/// resource are stored in the delta, along with the metadata of the new version.
+/// \param base The signature of the base resource
+/// \param filename The filename of the new version of the resource, with the same type as the base one
+/// \param delta The stream receiving the delta
+/// \throws DeltaError if the resources have different types, or if an error occurs during the reading or the writing
+DeltaStats make_delta(const Signature& base, const char* filename, std::ostream& delta);
+
+///
+/// \brief apply_delta Create the new version of a resource from the base resource and a delta made from its
+/// signature. The blocks taken from the base resource are checked against the hashes of the signature.
+/// \param base The filename of the base resource
+/// \param delta The stream containing the delta
+/// \param filename The filename of the new version of the resource to create, which can be the base resource
+/// \param options Options of the writing of the new version of the resource. The new version is always written
+/// atomically (see `WriterOptions::atomic`): it only appears once complete, and a previous file is left as is on
+/// failure.
+/// \throws DeltaError if the delta wasn't made for the base resource or is corrupted, or if an error occurs during
+/// the reading or the writing
+void apply_delta(const char* base, std::istream& delta, const char* filename,
+                 const WriterOptions& options = WriterOptions{});
+
+}} // namespace reven::binresource
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+namespace reven {
+namespace binresource {
+
+///
+/// Kinds of operations done on the stream of a Reader or a Writer
+///
+enum class IoOperation {
+	Read,
+	Write,
+	Seek,
+	Flush,
+};
+
+constexpr std::size_t io_operation_count = 4;
+
+//! Name of the operation, for display purposes
+const char* io_operation_name(IoOperation op);
+
+///
+/// Histogram of latencies with power of two buckets: the bucket `i` counts the latencies in [2^i, 2^(i+1)) nanoseconds
+/// (and 0 nanoseconds for the bucket 0).
+/// Thread-safe.
+///
+class LatencyHistogram {
+public:
+	static constexpr std::size_t bucket_count = 64;
+
+	LatencyHistogram() { reset(); }
+
+	void record(std::uint64_t ns);
+	void reset();
+
+	std::uint64_t count() const;
+	std::uint64_t bucket(std::size_t i) const { return buckets_[i].load(std::memory_order_relaxed); }
+
+	//! Upper bound in nanoseconds of the bucket containing the `p` percentile (0 < p <= 100)
+	std::uint64_t percentile(double p) const;
+
+private:
+	std::array<std::atomic<std::uint64_t>, bucket_count> buckets_;
+};
+
+///
+/// Counters of the operations done on the streams of Readers and Writers.
+/// A same IoStats can be shared by several Readers and Writers to aggregate their operations. Thread-safe.
+///
+/// Example:
+///
+/// ```cpp
+/// auto stats = std::make_shared<IoStats>();
+/// auto reader = Reader::open("foo.bin");
+/// reader.instrument(stats);
+/// // ... use reader.stream() ...
+/// stats->dump(std::cerr);
+/// ```
+class IoStats {
+public:
+	IoStats() { reset(); }
+
+	IoStats(const IoStats&) = delete;
+	IoStats& operator=(const IoStats&) = delete;
+
+	//! Record one call to the underlying stream buffer
+	void record(IoOperation op, std::uint64_t bytes, std::uint64_t ns);
+	void reset();
+
+	//! Number of calls to the underlying stream buffer
+	std::uint64_t calls(IoOperation op) const { return counters(op).calls.load(std::memory_order_relaxed); }
+	//! Number of bytes transferred
+	std::uint64_t bytes(IoOperation op) const { return counters(op).bytes.load(std::memory_order_relaxed); }
+	//! Total time spent in nanoseconds
+	std::uint64_t time_ns(IoOperation op) const { return counters(op).time_ns.load(std::memory_order_relaxed); }
+	const LatencyHistogram& latency(IoOperation op) const { return counters(op).latency; }
+
+	//! Write a human readable summary of the counters
+	void dump(std::ostream& out) const;
+
+private:
+	struct Counters {
+		std::atomic<std::uint64_t> calls;
+		std::atomic<std::uint64_t> bytes;
+		std::atomic<std::uint64_t> time_ns;
+		LatencyHistogram latency;
+	};
+
+	const Counters& counters(IoOperation op) const { return counters_[static_cast<std::size_t>(op)]; }
+
+	std::array<Counters, io_operation_count> counters_;
+};
+
+}} // namespace reven::binresource
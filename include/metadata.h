@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <string>
 #include <stdexcept>
@@ -7,6 +8,10 @@
 namespace reven {
 namespace binresource {
 
+namespace detail {
+struct HeaderExtension;
+}
+
 ///
 /// Root metadata exception. Catch this exception to catch all exceptions related to metadata.
 ///
@@ -35,6 +40,8 @@ constexpr std::size_t format_version_max_size = 512;
 constexpr std::size_t tool_name_max_size = 512;
 constexpr std::size_t tool_version_max_size = 512;
 constexpr std::size_t tool_info_max_size = 2048;
+//! Size of the area at the end of the serialized metadata reserved to the library, since the metadata version 2
+constexpr std::size_t metadata_extension_size = 64;
 
 ///
 /// Raw Metadata class that contains the metadata in the format stored and retrieved by the reader.
@@ -58,8 +65,27 @@ public:
 	/// The date of the generation
 	std::uint64_t generation_date() const { return generation_date_; }
 
+	//! Size in bytes of the serialized metadata
+	static constexpr std::size_t serialized_size =
+		sizeof(std::uint32_t) + 4 * sizeof(std::size_t) +
+		format_version_max_size + tool_name_max_size + tool_version_max_size + tool_info_max_size +
+		sizeof(std::uint64_t) + metadata_extension_size;
+
+	///
+	/// \brief serialize Write the metadata in the stream with the layout of the current metadata version, with a single
+	/// write. The area reserved to the library is left empty.
+	/// \throws WriteMetadataError if the stream can't be written
 	void serialize(std::ostream& out) const;
 
+	///
+	/// \brief serialize Write the metadata in the stream with the layout of `metadata_version`, so that it can be read
+	/// back by `deserialize` with the same version. The area reserved to the library is left empty.
+	/// \throws WriteMetadataError if the version isn't supported or if the stream can't be written
+	void serialize(std::uint32_t metadata_version, std::ostream& out) const;
+
+	//! Write the metadata in a buffer of at least `serialized_size` bytes, with an empty area reserved to the library
+	void serialize(char* buffer) const;
+
 private:
 	// General clients are not expected to be able to build Metadata
 	Metadata() = default;
@@ -70,11 +96,15 @@ private:
 	std::string tool_version_;
 	std::string tool_info_;
 	std::uint64_t generation_date_;
+	// Maintained by the library, zeroed in the metadata built by clients
+	std::array<char, metadata_extension_size> extension_ = {};
 
 	// Special class that is allowed to build Metadata
 	friend class MetadataWriter;
 	// Special permission for Reader to build Metadata
 	friend class Reader;
+	// Access to the area reserved to the library
+	friend struct detail::HeaderExtension;
 };
 
 ///
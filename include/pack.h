@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "metadata.h"
+#include "reader.h"
+#include "writer.h"
+
+namespace reven {
+namespace binresource {
+
+///
+/// Writer of a pack: a single file bundling many resources, called members, each one identified by a unique name.
+/// The members are stored one after the other, and a directory of the members is written at the end of the pack at
+/// its finalization, so that PackReader can open any member without going through the others.
+///
+/// Example:
+///
+/// ```cpp
+/// auto pack = PackWriter::create("trace.pack");
+/// {
+///     auto writer = pack.add("foo", md);
+///     writer.stream().write(data, size);
+/// }
+/// pack.add("bar", "bar.bin");
+/// std::move(pack).finalize();
+/// ```
+///
+/// An existing pack can be opened again to add, replace or remove members without rewriting the others: the new
+/// members and the new directory are appended to the pack, and the space of the replaced members becomes dead space,
+/// reclaimed by `compact`.
+///
+class PackWriter {
+public:
+	///
+	/// \brief create Create an empty pack
+	/// \param filename The filename of the pack
+	/// \param options Options of the writing of the members. Only the buffer size and the durability are used.
+	/// \throws WriterError if the pack can't be created, or if another writer is updating it
+	static PackWriter create(const char* filename, const WriterOptions& options = WriterOptions{});
+
+	///
+	/// \brief open Open an existing pack to change its members. The changes are appended after the current directory,
+	/// which the readers keep using until the writer is finalized, or if it never is.
+	/// \param filename The filename of the pack
+	/// \param options Options of the writing of the members. Only the buffer size and the durability are used.
+	/// \throws WriterError if the file isn't a complete pack, or if another writer is updating it
+	static PackWriter open(const char* filename, const WriterOptions& options = WriterOptions{});
+
+	///
+	/// \brief compact Rewrite a pack without its dead space. The members are copied within the kernel when the file
+	/// system allows it, and the new pack atomically replaces the previous one once it is durable: the readers that
+	/// opened the previous pack can keep reading it.
+	/// \param filename The filename of the pack
+	/// \throws WriterError if an error occurs during the reading of the pack or the writing of the new one, or if
+	/// another writer is updating it
+	static void compact(const char* filename);
+
+	PackWriter(PackWriter&&);
+	PackWriter& operator=(PackWriter&&);
+
+	//! Close the pack. If it wasn't finalized, the pack keeps the directory it was opened with, and a created pack has
+	//! none and can't be read.
+	~PackWriter();
+
+public:
+	///
+	/// \brief add Add a new member to the pack, to be written with the returned writer.
+	/// The writer must be finalized or destroyed before the next member is added and before the finalization of the
+	/// pack. Its stream can be sought and rewritten like the stream of any resource.
+	/// \param name The name of the member, unique in the pack
+	/// \param md The metadata of the member
+	/// \throws WriterError if the name is already used, if the writer of the previous member isn't finalized or if an
+	/// error occurs during the writing
+	Writer add(const char* name, const Metadata& md);
+
+	///
+	/// \brief add Add a copy of an existing resource to the pack
+	/// \param name The name of the member, unique in the pack
+	/// \param filename The filename of the resource to copy
+	/// \throws WriterError if the name is already used, if the file isn't a resource or can't be copied
+	void add(const char* name, const char* filename);
+
+	///
+	/// \brief replace Like `add`, but replacing the member with the same name if there is one. The previous member is
+	/// only dropped once the new one is added successfully.
+	Writer replace(const char* name, const Metadata& md);
+
+	///
+	/// \brief replace Like `add`, but replacing the member with the same name if there is one
+	void replace(const char* name, const char* filename);
+
+	///
+	/// \brief remove Remove a member from the pack
+	/// \throws WriterError if there is no member with the name
+	void remove(const char* name);
+
+	//! Number of members added so far
+	std::size_t member_count() const;
+
+	///
+	/// \brief finalize Write the directory of the pack and close it. With a durability other than `Durability::None`,
+	/// the pack is synced to the disk.
+	/// \throws WriterError if an error occurs during the writing
+	void finalize() &&;
+
+private:
+	struct State;
+
+	explicit PackWriter(std::unique_ptr<State>&& state);
+
+	Writer add_writer(const char* name, const Metadata& md, bool replace);
+	void add_file(const char* name, const char* filename, bool replace);
+
+	//! Throw if a member can't be added with the name
+	void check_name(const char* name, bool replace) const;
+	//! Record the size of the member being written, if any
+	void close_member();
+	//! Start a new member at the end of the pack
+	std::uint64_t open_member(const char* name, bool replace);
+	//! Keep the member just added, dropping the previous member with the same name if any
+	void keep_member();
+	//! Remove the member just added after a failure
+	void abandon_member();
+
+private:
+	//! In a pointer to keep the writer movable
+	std::unique_ptr<State> state_;
+};
+
+///
+/// Reader of a pack written by PackWriter.
+/// The directory of the pack is memory-mapped at the opening, so opening a member doesn't read anything but the
+/// member itself, whatever the number of members. The readers of the members are independent from each other and
+/// from the pack reader, and can be used by different threads.
+///
+class PackReader {
+public:
+	//! Returned by `find` when there is no member with the name
+	static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+	///
+	/// \brief open Open a pack and map its directory
+	/// \param filename The filename of the pack
+	/// \param options Options of the reading of the members. Only the buffer size is used.
+	/// \throws ReaderError if the file isn't a complete pack
+	static PackReader open(const char* filename, const ReaderOptions& options = ReaderOptions{});
+
+	PackReader(PackReader&&);
+	PackReader& operator=(PackReader&&);
+	~PackReader();
+
+public:
+	std::size_t member_count() const;
+
+	//! Name of the member `index`. The members are sorted by name.
+	std::string name(std::size_t index) const;
+
+	//! Size of the member `index`, header included
+	std::uint64_t member_size(std::size_t index) const;
+
+	//! Size of the space of the pack used by neither its members nor its directory, reclaimed by
+	//! `PackWriter::compact`
+	std::uint64_t dead_size() const;
+
+	//! Index of the member with the name, or npos
+	std::size_t find(const char* name) const;
+
+	///
+	/// \brief open_member Open the member `index` of the pack. Thread-safe.
+	/// \throws ReaderError if the member can't be read
+	Reader open_member(std::size_t index) const;
+
+	///
+	/// \brief open_member Open the member of the pack with the name. Thread-safe.
+	/// \throws ReaderError if there is no such member or if it can't be read
+	Reader open_member(const char* name) const;
+
+private:
+	friend class PackWriter;
+
+	struct State;
+
+	explicit PackReader(std::unique_ptr<State>&& state);
+
+private:
+	std::unique_ptr<State> state_;
+};
+
+}} // namespace reven::binresource
@@ -1,13 +1,24 @@
 #pragma once
 
+#include <chrono>
 #include <istream>
 #include <memory>
 
+#include "buffer.h"
+#include "io_stats.h"
 #include "metadata.h"
+#include "tracing.h"
 
 namespace reven {
 namespace binresource {
 
+namespace detail {
+class InstrumentedBuf;
+}
+
+//! Default size of the chunks read in the background by a Reader with read-ahead
+constexpr std::size_t default_read_ahead_chunk_size = 1024 * 1024;
+
 ///
 /// Exception that occurs when there is an error in the reading
 ///
@@ -16,6 +27,43 @@ public:
 	ReaderError(const char* msg) : std::runtime_error(msg) {}
 };
 
+///
+/// Expected pattern of the accesses to the payload of a resource, used to tune the read-ahead of the system
+///
+enum class AccessPattern {
+	//! Default behavior of the system
+	Normal,
+	//! The payload is read sequentially: read-ahead more aggressively
+	Sequential,
+	//! The payload is read at random offsets: disable the read-ahead
+	Random,
+	//! The whole payload will be needed soon: start reading it in the background
+	WillNeed,
+};
+
+///
+/// Options of the resources opened from a filename by Reader
+///
+struct ReaderOptions {
+	//! Expected pattern of the accesses to the payload
+	AccessPattern access_pattern = AccessPattern::Normal;
+	//! Size of the buffer of the stream. Large buffers reduce the number of system calls of sequential reads.
+	std::size_t buffer_size = default_stream_buffer_size;
+	//! When not 0, a background thread reads up to `read_ahead_chunks` chunks of the file ahead of the position of
+	//! the stream, hiding the latency of the disk behind the processing of the data. Best used for sequential reads.
+	//! The chunks replace the buffer of the stream.
+	std::size_t read_ahead_chunks = 0;
+	//! Size of the chunks read in the background
+	std::size_t read_ahead_chunk_size = default_read_ahead_chunk_size;
+	//! Follow a resource still being written by a Writer created or opened from a filename: at the end of the
+	//! available data, the reads wait for the writer to write more instead of failing. The end of the file is only
+	//! reached once the writer is finalized or destroyed. Use `stream().readsome()` to only get the data already
+	//! available. Replaces the read-ahead.
+	bool follow = false;
+	//! When following, interval at which the file is checked, in addition to the notifications of the system
+	std::chrono::milliseconds follow_poll_interval = std::chrono::milliseconds(100);
+};
+
 ///
 /// Reader class used kinda like a std::istream but with the abstraction of the metadata
 /// The user could use independently a std::istream and this class without caring about the offset
@@ -26,8 +74,9 @@ public:
 	///
 	/// \brief open Open a resource from the filename passed in parameter
 	/// \param filename The filename of the resource to open
+	/// \param options Options of the reading of the file
 	/// \throws ReaderError if an error occurs during the reading of the file
-	static Reader open(const char* filename);
+	static Reader open(const char* filename, const ReaderOptions& options = ReaderOptions{});
 
 	///
 	/// \brief open Open a resource from a stream passed in parameter
@@ -35,6 +84,16 @@ public:
 	/// \throws ReaderError if an error occurs during the reading of the stream
 	static Reader open(std::unique_ptr<std::istream>&& stream);
 
+	///
+	/// \brief open_streaming Open a resource from a file descriptor that can't be sought, like a pipe or a socket.
+	/// The resource is read sequentially and the stream is never sought, so its position can't be changed and
+	/// `read_vec` isn't available. Resources written by `Writer::create_streaming` can be read this way: the end of
+	/// their payload is checked, and the stream is bad if it was cut before. The stream is bad on read errors too.
+	/// \param fd The file descriptor to read, owned by the reader
+	/// \param buffer_size The size of the buffer of the stream
+	/// \throws ReaderError if an error occurs during the reading of the header
+	static Reader open_streaming(int fd, std::size_t buffer_size = default_stream_buffer_size);
+
 public:
 	//! Return the stream used
 	std::istream& stream() {
@@ -49,16 +108,67 @@ public:
 	//! Returns the metadata read at the opening
 	const Metadata& metadata() const { return md_; }
 
+	//! Whether the content hash of the payload was stored by its writer. Only the resources created from a filename
+	//! whose payload was written sequentially through the stream or `write_vec` have one.
+	bool has_content_hash() const;
+
+	//! XXH64 of the whole payload, read from the header along with the metadata, or 0 if `has_content_hash` is false.
+	//! Resources with the same payload have the same hash, which can be used to deduplicate them.
+	std::uint64_t content_hash() const;
+
+	///
+	/// \brief advise Declare the expected pattern of the accesses to the payload.
+	/// This is only a hint: it has no effect on resources not opened from a filename.
+	void advise(AccessPattern pattern);
+
+	///
+	/// \brief prefetch Start reading a range of the payload in the background so that it is in the page cache when
+	/// needed. This is only a hint: it has no effect on resources not opened from a filename.
+	/// \param offset The offset of the range in the payload
+	/// \param size The size of the range
+	void prefetch(std::uint64_t offset, std::uint64_t size);
+
+	///
+	/// \brief read_vec Fill several buffers with the contiguous payload starting at `offset`.
+	/// On resources opened from a filename, this is done with a single system call, bypassing the buffer of the stream
+	/// and leaving its position unchanged.
+	/// \param offset The offset in the payload of the data to read
+	/// \param buffers The buffers to fill, in order
+	/// \param count The number of buffers
+	/// \return The number of bytes read, which is less than the total size of the buffers only at the end of the file
+	/// \throws ReaderError if an error occurs during the reading, or if the reader is streaming
+	std::size_t read_vec(std::uint64_t offset, const MutableBuffer* buffers, std::size_t count);
+
+	///
+	/// \brief instrument Record the operations done on the stream from now on in `stats`, which can be shared with
+	/// other readers and writers. Passing nullptr stops the recording.
+	void instrument(std::shared_ptr<IoStats> stats);
+
+	//! The statistics passed to `instrument`, or nullptr if the reader isn't instrumented
+	std::shared_ptr<IoStats> stats() const;
+
 private:
-	Reader(std::unique_ptr<std::istream>&& stream) : stream_{std::move(stream)} {
-		stream_->seekg(0);
+	//! A streaming reader starts at the current position of the stream, which is never sought
+	Reader(std::unique_ptr<std::istream>&& stream, bool streaming) : stream_{std::move(stream)}, streaming_(streaming) {
+		if (!streaming_) {
+			stream_->seekg(0);
+		}
 	}
 
+	//! `path` is the filename of the resource, or an empty string if unknown
+	static Reader do_open(std::unique_ptr<std::istream>&& stream, const char* path, bool streaming = false);
+
 	Metadata read_metadata(std::uint32_t metadata_version);
 
 private:
 	//! Stored in a pointer because ostream itself is not movable
 	std::unique_ptr<std::istream> stream_;
+	//! Descriptor of the file when the resource is opened from a filename, owned by stream_
+	int fd_ = -1;
+	//! Installed in the stream when instrumented, forwarding to the original buffer of the stream
+	std::shared_ptr<detail::InstrumentedBuf> instrumented_;
+	//! Whether the stream can't be sought
+	bool streaming_;
 
 	Metadata md_;
 	std::size_t md_size_;
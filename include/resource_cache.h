@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "reader.h"
+
+namespace reven {
+namespace binresource {
+
+//! Default size of the buffer of the streams of the resources opened by a ResourceCache. The resources are kept open
+//! for long and usually serve small reads, so the buffer would otherwise dominate the memory used by the cache.
+constexpr std::size_t default_cached_stream_buffer_size = 64 * 1024;
+
+///
+/// Budget of a ResourceCache. When one of the limits is exceeded, the least recently used resources are evicted.
+///
+struct CacheLimits {
+	//! Maximum number of resources kept open by the cache. 0 disables the caching.
+	std::size_t max_open = 256;
+	//! Maximum estimated memory (in bytes) used by the resources kept open by the cache. A resource opened with the
+	//! default options of the cache costs about 70 KiB, so that `max_open` is reached first with the default limits.
+	std::size_t max_memory = 64 * 1024 * 1024;
+};
+
+///
+/// Counters of a ResourceCache
+///
+struct CacheStats {
+	//! Number of requests served with an already opened resource
+	std::uint64_t hits = 0;
+	//! Number of requests that required to open the resource
+	std::uint64_t misses = 0;
+	//! Number of resources evicted to respect the limits, or because the file changed on disk
+	std::uint64_t evictions = 0;
+	//! Number of resources currently kept open
+	std::size_t open = 0;
+	//! Estimated memory currently used by the resources kept open
+	std::size_t memory = 0;
+};
+
+///
+/// Cache of opened resources, keyed by filename.
+/// The same Reader is shared by all the users requesting the same filename, saving the opening and the parsing of the
+/// metadata on each request. Note that the position of the stream is shared too, so concurrent users of the same
+/// Reader must synchronize their accesses to the stream.
+/// An evicted Reader stays alive until its last user releases it.
+/// A resource whose file was replaced or modified on disk since its opening is reopened.
+///
+class ResourceCache {
+public:
+	//! The cache shared by the whole process, with default limits
+	static ResourceCache& global();
+
+	//! Options of the readers opened by default, with a buffer of `default_cached_stream_buffer_size` bytes
+	static ReaderOptions default_reader_options();
+
+	//! The resources are opened with `options`
+	explicit ResourceCache(const CacheLimits& limits = CacheLimits{},
+	                       const ReaderOptions& options = default_reader_options())
+		: limits_(limits), options_(options) {}
+
+	ResourceCache(const ResourceCache&) = delete;
+	ResourceCache& operator=(const ResourceCache&) = delete;
+
+	///
+	/// \brief open Return the Reader of the resource, opening it if it isn't in the cache
+	/// \param filename The filename of the resource to open
+	/// \throws ReaderError if an error occurs during the reading of the file
+	std::shared_ptr<Reader> open(const char* filename);
+
+	//! Remove the resource from the cache if it is present
+	void erase(const char* filename);
+
+	//! Remove all the resources from the cache
+	void clear();
+
+	//! Change the limits of the cache, evicting resources if needed
+	void set_limits(const CacheLimits& limits);
+
+	CacheLimits limits() const;
+
+	CacheStats stats() const;
+
+private:
+	//! Identity of a file on disk, used to detect files modified since their opening
+	struct FileId {
+		std::uint64_t device;
+		std::uint64_t inode;
+		std::uint64_t size;
+		std::int64_t mtime_sec;
+		std::int64_t mtime_nsec;
+
+		bool operator==(const FileId& other) const;
+	};
+
+	struct Entry {
+		std::string filename;
+		FileId id;
+		std::shared_ptr<Reader> reader;
+		std::size_t cost;
+	};
+
+	using EntryList = std::list<Entry>;
+
+	void remove(EntryList::iterator it);
+	void evict();
+
+private:
+	mutable std::mutex mutex_;
+
+	CacheLimits limits_;
+	const ReaderOptions options_;
+	CacheStats stats_;
+
+	//! Most recently used first
+	EntryList entries_;
+	std::unordered_map<std::string, EntryList::iterator> index_;
+};
+
+}} // namespace reven::binresource
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "metadata.h"
+#include "reader.h"
+#include "writer.h"
+
+namespace reven {
+namespace binresource {
+
+//! Default maximum size of the payload of each segment of a segmented resource
+constexpr std::uint64_t default_segment_size = std::uint64_t(1) << 30;
+
+//! Filename of the segment `index` of the segmented resource `filename`
+std::string segment_filename(const char* filename, std::size_t index);
+
+///
+/// Writer of a resource split into several segment files of bounded size.
+/// Each segment is a complete resource with the same metadata, named after the filename of the resource (see
+/// `segment_filename`), whose payload is the next part of the logical payload. The segments can be moved and read
+/// independently, and `SegmentedReader` presents them as a single payload again.
+/// The header of each segment records an identifier of the resource, the index of the segment, and the number of
+/// segments once the resource is finalized, so that the segments of another resource with the same filename are never
+/// mixed in.
+///
+/// Example:
+///
+/// ```cpp
+/// auto writer = SegmentedWriter::create("foo.bin", md, 256 * 1024 * 1024);
+/// writer.write(data, size);
+/// std::move(writer).finalize();
+/// ```
+///
+class SegmentedWriter {
+public:
+	///
+	/// \brief create Create a segmented resource with the metadata and filename passed in parameter
+	/// \param filename The filename of the resource, from which the filenames of the segments are made
+	/// \param md The metadata to write in each segment
+	/// \param segment_size The maximum size of the payload of each segment
+	/// \param options Options of the writing of each segment
+	/// \throws WriterError if an error occurs during the writing of the first segment
+	static SegmentedWriter create(const char* filename, const Metadata& md,
+	                              std::uint64_t segment_size = default_segment_size,
+	                              const WriterOptions& options = WriterOptions{});
+
+	SegmentedWriter(SegmentedWriter&&) = default;
+	SegmentedWriter& operator=(SegmentedWriter&&) = default;
+
+public:
+	//! The size of the metadata of each segment
+	std::size_t md_size() const {
+		return current_->md_size();
+	}
+
+	///
+	/// \brief write Append data to the payload. The data is split at the end of the current segment if needed, and
+	/// the next segment is created when the current one is full.
+	/// \param data The data to write
+	/// \param size The size of the data
+	/// \throws WriterError if an error occurs during the writing
+	void write(const void* data, std::size_t size);
+
+	//! Size of the payload written so far
+	std::uint64_t size() const {
+		return size_;
+	}
+
+	//! Number of segments created so far
+	std::size_t segment_count() const {
+		return segment_count_;
+	}
+
+	///
+	/// \brief set_metadata Update the metadata of all the segments, including the next ones. The finished segments are
+	/// updated with the durability of the options of the writer.
+	/// \param md The metadata to write in the resource
+	/// \throws WriterError if an error occurs during the writing of a segment
+	void set_metadata(const Metadata& md);
+
+	///
+	/// \brief finalize Record the number of segments in each one, finalize the current segment, and remove the segments
+	/// left by a previous resource with the same filename after it
+	/// \throws WriterError if an error occurs during the writing
+	void finalize() &&;
+
+private:
+	SegmentedWriter(std::string filename, const Metadata& md, std::uint64_t segment_size, const WriterOptions& options);
+
+	//! Create the segment `segment_count_`
+	void create_segment();
+	//! Finalize the current segment and create the next one
+	void next_segment();
+
+private:
+	std::string filename_;
+	Metadata md_;
+	std::uint64_t segment_size_;
+	WriterOptions options_;
+	//! Identifier of the resource, recorded in each segment
+	std::uint64_t group_;
+
+	//! Stored in a pointer to be replaced at each segment
+	std::unique_ptr<Writer> current_;
+	std::size_t segment_count_ = 0;
+	//! Size of the payload of the current segment
+	std::uint64_t segment_written_ = 0;
+	std::uint64_t size_ = 0;
+};
+
+///
+/// Reader of a resource written by SegmentedWriter, presenting its segments as a single payload.
+/// The segments are independent resources: each one can be read by a different thread with `segment`, and
+/// `read_at` is thread-safe and reads the parts of a range lying in different segments in parallel.
+///
+class SegmentedReader {
+public:
+	///
+	/// \brief open Open all the segments of a segmented resource. If the resource wasn't finalized, the segments are
+	/// opened as long as they exist and belong to the same resource as the first one.
+	/// \param filename The filename of the resource, from which the filenames of the segments are made
+	/// \param options Options of the reading of each segment
+	/// \throws ReaderError if a segment can't be read, if the first one isn't a segment or if the resource was finalized
+	/// with more segments than found
+	static SegmentedReader open(const char* filename, const ReaderOptions& options = ReaderOptions{});
+
+	SegmentedReader(SegmentedReader&&) = default;
+	SegmentedReader& operator=(SegmentedReader&&) = default;
+
+public:
+	//! Returns the metadata of the first segment
+	const Metadata& metadata() const { return segments_.front().metadata(); }
+
+	//! Size of the whole payload
+	std::uint64_t size() const {
+		return offsets_.back();
+	}
+
+	std::size_t segment_count() const {
+		return segments_.size();
+	}
+
+	//! Reader of the segment `index`. Its stream must only be used by one thread at a time.
+	Reader& segment(std::size_t index) {
+		return segments_[index];
+	}
+
+	//! Offset in the whole payload of the beginning of the segment `index`
+	std::uint64_t segment_offset(std::size_t index) const {
+		return offsets_[index];
+	}
+
+	//! Index of the segment containing the offset of the whole payload
+	std::size_t segment_at(std::uint64_t offset) const;
+
+	///
+	/// \brief read_at Read a range of the whole payload without using the streams of the segments. Thread-safe.
+	/// \param offset The offset in the payload of the data to read
+	/// \param data The buffer to fill
+	/// \param size The size of the data to read
+	/// \return The number of bytes read, which is less than `size` only at the end of the payload
+	/// \throws ReaderError if an error occurs during the reading
+	std::size_t read_at(std::uint64_t offset, void* data, std::size_t size);
+
+private:
+	SegmentedReader() = default;
+
+private:
+	std::vector<Reader> segments_;
+	//! Offset of the beginning of each segment, followed by the size of the whole payload
+	std::vector<std::uint64_t> offsets_;
+};
+
+}} // namespace reven::binresource
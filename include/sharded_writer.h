@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "metadata.h"
+#include "writer.h"
+
+namespace reven {
+namespace binresource {
+
+namespace detail {
+class FileStream;
+}
+
+//! Default memory used by each shard of a ShardedWriter before it is spilled to disk
+constexpr std::size_t default_shard_memory = 64 * 1024 * 1024;
+
+///
+/// Writer of a resource whose payload is produced by several threads as records identified by a sequence number.
+/// Each producer writes its records in its own Shard, without any synchronization with the other producers. At the
+/// finalization, the records of all the shards are merged in the payload by increasing sequence number, so the output
+/// doesn't depend on the scheduling of the producers.
+/// The records are kept in memory, and only spilled to a temporary file next to the resource when a shard exceeds
+/// its memory budget.
+///
+/// Example:
+///
+/// ```cpp
+/// auto writer = ShardedWriter::create("foo.bin", md);
+/// // On each producer thread:
+/// auto& shard = writer.shard();
+/// shard.write(sequence, data, size);
+/// // Once all the producers are done:
+/// std::move(writer).finalize();
+/// ```
+///
+class ShardedWriter {
+public:
+	///
+	/// Records written by a single producer. Not thread-safe: each thread must use its own shard.
+	///
+	class Shard {
+	public:
+		Shard(const std::string& spill_directory, std::size_t max_memory);
+		~Shard();
+
+		Shard(const Shard&) = delete;
+		Shard& operator=(const Shard&) = delete;
+
+		///
+		/// \brief write Add a record to the shard.
+		/// Records with the same sequence number are ordered by shard, then in the order of their writing.
+		/// \param sequence The sequence number of the record, deciding its position in the payload
+		/// \param data The content of the record
+		/// \param size The size of the record
+		/// \throws WriterError if the shard can't be spilled to disk
+		void write(std::uint64_t sequence, const void* data, std::size_t size);
+
+		//! Number of bytes written in the shard
+		std::uint64_t size() const { return spilled_ + memory_.size(); }
+
+	private:
+		friend class ShardedWriter;
+
+		struct Record {
+			std::uint64_t sequence;
+			//! Offset of the record in the shard, counting the spilled data first
+			std::uint64_t offset;
+			std::size_t size;
+		};
+
+		void spill();
+
+		//! Copy the content of the record to the stream
+		void copy(const Record& record, std::ostream& out, std::vector<char>& scratch);
+
+	private:
+		std::string spill_directory_;
+		std::size_t max_memory_;
+
+		std::vector<Record> records_;
+		std::vector<char> memory_;
+
+		//! Temporary file receiving the data exceeding the memory budget, created on the first spill
+		std::unique_ptr<detail::FileStream> spill_;
+		std::uint64_t spilled_ = 0;
+	};
+
+	///
+	/// \brief create Create a resource with the metadata and filename passed in parameter
+	/// \param filename The filename of the resource to open
+	/// \param md The metadata to write in the file
+	/// \param options Options of the writing of the file
+	/// \param shard_memory The memory used by each shard before it is spilled to disk
+	/// \throws WriterError if an error occurs during the writing of the file
+	static ShardedWriter create(const char* filename, const Metadata& md, const WriterOptions& options = WriterOptions{},
+	                            std::size_t shard_memory = default_shard_memory);
+
+	///
+	/// \brief create Create a resource with the metadata and stream passed in parameter.
+	/// The shards are spilled in the temporary directory of the system.
+	/// \param stream The stream to write
+	/// \param md The metadata to write in the file
+	/// \param shard_memory The memory used by each shard before it is spilled to disk
+	/// \throws WriterError if an error occurs during the writing of the stream
+	static ShardedWriter create(std::unique_ptr<std::ostream>&& stream, const Metadata& md,
+	                            std::size_t shard_memory = default_shard_memory);
+
+public:
+	ShardedWriter(ShardedWriter&&) = default;
+	ShardedWriter& operator=(ShardedWriter&&) = default;
+
+	//! The size of the metadata (the offset from the beginning of the file to the position 0 for the user)
+	std::size_t md_size() const {
+		return writer_.md_size();
+	}
+
+	//! Return a new shard, to be used by a single producer. Thread-safe.
+	Shard& shard();
+
+	///
+	/// \brief finalize Merge the records of all the shards in the payload by sequence number and flush the stream.
+	/// Must not be called concurrently with the writing in the shards.
+	/// \return The stream, in case someone want to access it after the end of the writing
+	/// \throws WriterError if an error occurs during the writing
+	std::unique_ptr<std::ostream> finalize() &&;
+
+private:
+	ShardedWriter(Writer&& writer, std::string spill_directory, std::size_t shard_memory);
+
+private:
+	Writer writer_;
+	std::string spill_directory_;
+	std::size_t shard_memory_;
+
+	//! Stored in a pointer because mutexes are not movable
+	std::unique_ptr<std::mutex> mutex_;
+	std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+}} // namespace reven::binresource
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+
+namespace reven {
+namespace binresource {
+
+///
+/// Kinds of events reported to a Tracer
+///
+enum class TraceEventType {
+	ReaderOpen,
+	WriterCreate,
+	WriterOpen,
+	WriterSetMetadata,
+	Read,
+	Write,
+	Seek,
+	Flush,
+};
+
+//! Name of the event type, for display purposes
+const char* trace_event_name(TraceEventType type);
+
+///
+/// Event reported to a Tracer
+///
+struct TraceEvent {
+	TraceEventType type;
+	//! Filename of the resource, or an empty string if the resource was opened from a stream
+	const char* path;
+	//! Offset in the stream of the operation
+	std::uint64_t offset;
+	//! Number of bytes transferred, or size of the metadata for the opening events. Only known at the end.
+	std::uint64_t size;
+	//! Start of the operation, in nanoseconds on the steady clock
+	std::uint64_t timestamp_ns;
+	//! Duration of the operation in nanoseconds. Only known at the end.
+	std::uint64_t duration_ns;
+};
+
+///
+/// Interface of the receivers of the trace events. Implementations must be thread-safe.
+///
+class Tracer {
+public:
+	virtual ~Tracer() = default;
+
+	//! Called before the operation
+	virtual void begin(const TraceEvent& event) = 0;
+	//! Called after the operation, even if it failed
+	virtual void end(const TraceEvent& event) = 0;
+};
+
+///
+/// Set the Tracer receiving the events of the whole process, or nullptr to stop tracing.
+/// Only the readers and writers opened while a tracer is set report their payload I/O: the other ones aren't
+/// slowed down by the tracing.
+///
+void set_tracer(std::shared_ptr<Tracer> tracer);
+
+//! The Tracer receiving the events of the whole process, or nullptr
+std::shared_ptr<Tracer> tracer();
+
+///
+/// Tracer writing the events in the Chrome trace event format (JSON), to be loaded in chrome://tracing or Perfetto.
+/// The JSON array is closed at the destruction of the sink.
+///
+class ChromeTraceSink : public Tracer {
+public:
+	//! `out` isn't owned and must outlive the sink
+	explicit ChromeTraceSink(std::ostream& out);
+	~ChromeTraceSink() override;
+
+	void begin(const TraceEvent& event) override;
+	void end(const TraceEvent& event) override;
+
+private:
+	std::mutex mutex_;
+	std::ostream& out_;
+	bool first_ = true;
+};
+
+}} // namespace reven::binresource
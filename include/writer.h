@@ -2,12 +2,43 @@
 
 #include <ostream>
 #include <memory>
+#include <mutex>
+#include <string>
 
+#include "buffer.h"
+#include "io_stats.h"
 #include "metadata.h"
+#include "tracing.h"
 
 namespace reven {
 namespace binresource {
 
+namespace detail {
+class FileBuf;
+class InstrumentedBuf;
+class MappedBuf;
+class PipeBuf;
+}
+
+//! Default size by which the file of a memory-mapped writer is grown
+constexpr std::size_t default_mapped_growth = 64 * 1024 * 1024;
+
+//! Interval of the writeback of `Durability::Periodic` when `WriterOptions::writeback_interval` is 0
+constexpr std::uint64_t default_writeback_interval = 8 * 1024 * 1024;
+
+///
+/// Guarantee on the data of a resource written from a filename once its writer is finalized
+///
+enum class Durability {
+	//! The data is left in the page cache of the system, and written to the disk whenever the system decides to
+	None,
+	//! The data is synced to the disk at the finalization of the writer
+	AtEnd,
+	//! The writeback of the data is paced while writing (see `WriterOptions::writeback_interval`), so that the final
+	//! sync at the finalization of the writer has little left to do
+	Periodic,
+};
+
 ///
 /// Exception that occurs when there is an error in the writing
 ///
@@ -16,6 +47,35 @@ public:
 	WriterError(const char* msg) : std::runtime_error(msg) {}
 };
 
+///
+/// Options of the resources created or opened from a filename by Writer
+///
+struct WriterOptions {
+	//! Size of the buffer of the stream. Large buffers reduce the number of system calls of sequential writes.
+	std::size_t buffer_size = default_stream_buffer_size;
+	//! Expected size of the payload in bytes. When not 0, the disk space of the file is preallocated to limit its
+	//! fragmentation. The space that isn't used is released at the end of the writing.
+	std::uint64_t size_hint = 0;
+	//! When not 0, the writeback of the written data is started every `writeback_interval` bytes, and the writeback of
+	//! the previous interval is waited for, so that dirty pages don't pile up in the page cache.
+	std::uint64_t writeback_interval = 0;
+	//! When the writeback is paced, drop the pages already written back from the page cache
+	bool drop_written_pages = false;
+	//! When not 0, the written data is made durable every `commit_interval` bytes, and the size of the payload on disk
+	//! is recorded in the header along with a checksum of its end. If the writer crashes, opening the resource again
+	//! with `Writer::open` drops what was written after the last commit, so the writing can be resumed from there.
+	//! The payload is also committed at the finalization and destruction of the writer. Only the data written through
+	//! the stream and `write_vec` counts towards the interval.
+	std::uint64_t commit_interval = 0;
+	//! When true, `Writer::create` writes the resource in a temporary file of the same directory, renamed to the
+	//! filename of the resource at the finalization of the writer: readers never see a partially written resource,
+	//! and a previous resource with the same filename is replaced at once. If the writer is destroyed without being
+	//! finalized, the temporary file is removed and the previous resource is left untouched.
+	bool atomic = false;
+	//! Guarantee on the data once the writer is finalized. With atomic writers, the rename is made durable too.
+	Durability durability = Durability::None;
+};
+
 ///
 /// Writer class used kinda like a std::ostream but with the abstraction of the metadata
 /// The user could use independently a std::ostream and this class without caring about the offset
@@ -25,23 +85,55 @@ class Writer {
 public:
 	///
 	/// \brief create Create a resource with the metadata and filename passed in parameter
+	/// The file is locked until the writer is finalized or destroyed, so that readers can follow it while it is written.
 	/// \param filename The filename of the resource to open
 	/// \param md The metadata to write in the file
-	/// \throws WriterError if an error occurs during the writing of the file
-	static Writer create(const char* filename, const Metadata& md);
+	/// \param options Options of the writing of the file
+	/// \throws WriterError if an error occurs during the writing of the file, or if another writer holds its lock
+	static Writer create(const char* filename, const Metadata& md, const WriterOptions& options = WriterOptions{});
 
 	///
 	/// \brief create Create a resource with the metadata and stream passed in parameter
+	/// The header of the resources not created from a filename has no extension, as with the metadata version 1: they
+	/// are readable by the versions of the library older than it, but don't record commits nor a content hash.
 	/// \param stream The stream to write
 	/// \param md The metadata to write in the file
 	/// \throws WriterError if an error occurs during the writing of the stream
 	static Writer create(std::unique_ptr<std::ostream>&& stream, const Metadata& md);
 
+	///
+	/// \brief create_streaming Create a resource written to a file descriptor that can't be sought, like a pipe or a
+	/// socket, to be read by `Reader::open_streaming`. The resource is written sequentially and the stream is never
+	/// sought: its position can't be changed, and `set_metadata` and `write_at` aren't available.
+	/// The end of the payload is marked at the finalization or destruction of the writer, and the file descriptor is
+	/// closed when the stream is destroyed: `Reader::open_streaming` fails on a stream that ends before this mark.
+	/// \param fd The file descriptor to write, owned by the writer
+	/// \param md The metadata to write in the resource
+	/// \param buffer_size The size of the buffer of the stream
+	/// \throws WriterError if an error occurs during the writing of the header
+	static Writer create_streaming(int fd, const Metadata& md, std::size_t buffer_size = default_stream_buffer_size);
+
+	///
+	/// \brief create_mapped Create a resource written through a memory mapping of the file
+	/// The file is preallocated by increments of `growth` bytes and truncated to its final size when the stream is
+	/// flushed, at the finalization or at the destruction of the writer.
+	/// Payload can be written in place using `map` in addition to the stream.
+	/// \param filename The filename of the resource to open
+	/// \param md The metadata to write in the file
+	/// \param growth The size by which the file and its mapping are grown when needed
+	/// \throws WriterError if an error occurs during the writing of the file
+	static Writer create_mapped(const char* filename, const Metadata& md, std::size_t growth = default_mapped_growth);
+
 	///
 	/// \brief open Open an already versioned resource with the filename passed in parameter
+	/// If the payload of the resource was committed (see `WriterOptions::commit_interval`), the data written after the
+	/// last commit is dropped. The position of the stream is the beginning of the payload as usual.
+	/// The resources with the metadata version 1 are opened too, and keep it: their commits only make the payload
+	/// durable.
 	/// \param filename The filename of the resource to open
-	/// \throws WriterError if an error occurs during the reading of the file
-	static Writer open(const char* filename);
+	/// \param options Options of the writing of the file. The size hint is the expected size of the whole payload.
+	/// \throws WriterError if an error occurs during the reading of the file, or if another writer holds its lock
+	static Writer open(const char* filename, const WriterOptions& options = WriterOptions{});
 
 	///
 	/// \brief open Open an already versioned resource with the stream passed in parameter
@@ -49,16 +141,37 @@ public:
 	/// \throws WriterError if an error occurs during the reading of the stream
 	static Writer open(std::unique_ptr<std::iostream>&& stream);
 
+	///
+	/// \brief restamp Create a copy of a resource with another metadata.
+	/// The payload is copied within the kernel: the extents of the source are shared with the copy when the file
+	/// system supports it (e.g. Btrfs, XFS), otherwise they are copied with `copy_file_range`, and through a buffer as
+	/// a last resort.
+	/// \param source The filename of the resource to copy
+	/// \param destination The filename of the copy, which can't be the source
+	/// \param md The metadata of the copy
+	/// \param options Options of the writing of the copy
+	/// \throws WriterError if the source can't be read or if an error occurs during the writing of the copy
+	static void restamp(const char* source, const char* destination, const Metadata& md,
+	                    const WriterOptions& options = WriterOptions{});
+
 public:
 	//! Return the stream used
 	std::ostream& stream() {
 		return *stream_;
 	}
 
-	//! Retrieve the stream in case someone want to access it after the end of the writing
-	std::unique_ptr<std::ostream>&& finalize() && {
-		return std::move(stream_);
-	}
+	///
+	/// \brief commit Flush the stream and, on writers created or opened from a filename, make the payload durable and
+	/// record its size in the header as the point to resume from after a crash.
+	/// From then on, the payload is committed at the finalization and destruction of the writer too.
+	/// \throws WriterError if the payload can't be committed
+	void commit();
+
+	//! Flush and retrieve the stream in case someone want to access it after the end of the writing.
+	//! The readers following the resource reach its end from then on.
+	//! On writers created from a filename, the data is synced and the resource renamed according to the options.
+	//! The stream is bad if this fails.
+	std::unique_ptr<std::ostream> finalize() &&;
 
 	//! The size of the metadata (the offset from the beginning of the file to the position 0 for the user)
 	std::size_t md_size() const {
@@ -67,22 +180,107 @@ public:
 
 	///
 	/// \brief set_metadata Update the metadata of an already existing resource
+	/// On writers created or opened from a filename and on memory-mapped writers, the header is rewritten with a single
+	/// positional write: the position of the stream isn't used, so this is safe to call while other threads write
+	/// the payload.
 	/// \param md The metadata to write in the resource
-	/// \throws WriterError if an error occurs during the writing of the resource
+	/// \throws WriterError if an error occurs during the writing of the resource, or if the writer is streaming
 	void set_metadata(const Metadata& md);
 
+	///
+	/// \brief write_vec Write several buffers contiguously at the current position of the stream and move the position
+	/// after them. On writers created from a filename, this is done with a single system call, bypassing the buffer of
+	/// the stream.
+	/// \param buffers The buffers to write, in order
+	/// \param count The number of buffers
+	/// \throws WriterError if an error occurs during the writing
+	void write_vec(const ConstBuffer* buffers, std::size_t count);
+
+	///
+	/// \brief write_at Write data at an offset of the payload without moving the position of the stream.
+	/// Thread-safe with the other calls to `write_at`, but not with the use of the stream. The ranges never written
+	/// are left as holes in the file, which read as zeros.
+	/// On writers created or opened from a filename, this is a single positional write that bypasses the buffer of
+	/// the stream: the data written at the same range with the stream must be flushed before.
+	/// \param offset The offset in the payload of the data
+	/// \param data The data to write
+	/// \param size The size of the data
+	/// \throws WriterError if an error occurs during the writing, or if the writer is streaming
+	void write_at(std::uint64_t offset, const void* data, std::size_t size);
+
+	///
+	/// \brief map Give direct access to the next `size` bytes of the payload and move the position of the stream
+	/// after them. Only available on writers created with `create_mapped`.
+	/// The returned pointer is valid until the file is grown again, by a subsequent write or call to `map`.
+	/// \param size The number of bytes to map
+	/// \throws WriterError if the writer isn't memory-mapped or if the file can't be grown
+	char* map(std::size_t size);
+
+	///
+	/// \brief instrument Record the operations done on the stream from now on in `stats`, which can be shared with
+	/// other readers and writers. Passing nullptr stops the recording.
+	void instrument(std::shared_ptr<IoStats> stats);
+
+	//! The statistics passed to `instrument`, or nullptr if the writer isn't instrumented
+	std::shared_ptr<IoStats> stats() const;
+
 private:
-	Writer(std::unique_ptr<std::ostream>&& stream) : stream_{std::move(stream)} {
-		stream_->seekp(0);
+	//! Records the segments in the extension of their header
+	friend class SegmentedWriter;
+	//! Tracks the writer of the member being written
+	friend class PackWriter;
+
+	//! A streaming writer starts at the current position of the stream, which is never sought
+	Writer(std::unique_ptr<std::ostream>&& stream, bool streaming = false)
+		: stream_{std::move(stream)}, write_at_mutex_{std::make_unique<std::mutex>()}, streaming_(streaming) {
+		if (!streaming_) {
+			stream_->seekp(0);
+		}
 	}
 
+	//! `path` is the filename of the resource, or an empty string if unknown.
+	//! `fd` is the descriptor of the file behind the stream if the header must be written directly, or -1.
+	static Writer do_create(std::unique_ptr<std::ostream>&& stream, const Metadata& md, const char* path,
+	                        int fd = -1, bool streaming = false);
+	static Writer do_open(std::unique_ptr<std::iostream>&& stream, const char* path);
+
 	void write_metadata(const Metadata& md);
 
+	//! Use the options of a writer created or opened from a filename
+	void apply_options(detail::FileBuf& buf, const WriterOptions& options);
+
+	//! Sync the data and publish the temporary file of the writer created from a filename. Return false on failure.
+	bool complete();
+
+	//! Recover the resource opened from a filename from its extension, and clear its content hash
+	void open_extension(detail::FileBuf& buf, const WriterOptions& options);
+
 private:
 	//! Stored in a pointer because ostream itself is not movable
 	std::unique_ptr<std::ostream> stream_;
+	//! Buffer of the stream when the writer is memory-mapped, owned by stream_
+	detail::MappedBuf* mapped_ = nullptr;
+	//! Buffer of the stream when the resource is created from a filename, owned by stream_
+	detail::FileBuf* file_ = nullptr;
+	//! Buffer of the stream of a streaming writer, owned by stream_
+	detail::PipeBuf* pipe_ = nullptr;
+	//! Installed in the stream when instrumented, forwarding to the original buffer of the stream
+	std::shared_ptr<detail::InstrumentedBuf> instrumented_;
+	//! Serializes the calls to `write_at` and `set_metadata` on the streams that aren't files.
+	//! In a pointer to keep the writer movable.
+	std::unique_ptr<std::mutex> write_at_mutex_;
+	//! Whether the stream can't be sought
+	bool streaming_;
 
+	//! Filename of the resource, or an empty string if unknown
+	std::string path_;
 	std::size_t md_size_;
+	//! Version of the header of the resource. The extension of the header, with the committed size and the content
+	//! hash, only exists from the version 2.
+	std::uint32_t metadata_version_ = 0;
+	Durability durability_ = Durability::None;
+	//! Held while the writer writes a member of a pack, until it is finalized or destroyed
+	std::shared_ptr<void> pack_member_;
 };
 
 }} // namespace reven::binresource
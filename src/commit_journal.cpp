@@ -0,0 +1,144 @@
+#include "commit_journal.h"
+#include "file_buf.h"
+
+#include <algorithm>
+#include <cerrno>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace reven {
+namespace binresource {
+namespace detail {
+
+namespace {
+
+//! Size of the end of the payload covered by the checksum
+constexpr std::size_t checksum_size = 4096;
+
+//! FNV-1a of the last bytes of the payload of size `size`. Return false if they can't be read.
+bool tail_checksum(int fd, std::uint64_t payload_offset, std::uint64_t size, std::uint64_t& checksum) {
+	char buffer[checksum_size];
+	const auto count = std::min<std::uint64_t>(size, checksum_size);
+	const auto offset = payload_offset + size - count;
+
+	std::uint64_t read = 0;
+	while (read < count) {
+		const auto result = ::pread(fd, buffer + read, count - read, offset + read);
+
+		if (result < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (result <= 0) {
+			return false;
+		}
+
+		read += result;
+	}
+
+	checksum = 0xcbf29ce484222325;
+	for (std::uint64_t i = 0; i < count; ++i) {
+		checksum ^= static_cast<unsigned char>(buffer[i]);
+		checksum *= 0x100000001b3;
+	}
+
+	return true;
+}
+
+bool datasync(int fd) {
+	int result = 0;
+	do {
+		result = ::fdatasync(fd);
+	} while (result != 0 && errno == EINTR);
+
+	return result == 0;
+}
+
+} // anonymous namespace
+
+CommitJournal::CommitJournal(int fd, std::uint64_t payload_offset, std::uint64_t interval)
+	: fd_(fd), payload_offset_(payload_offset), interval_(interval) {}
+
+bool CommitJournal::written(std::uint64_t size) {
+	pending_ += size;
+
+	if (interval_ == 0 || pending_ < interval_) {
+		return true;
+	}
+
+	return commit();
+}
+
+bool CommitJournal::commit() {
+	const bool changed = changed_.exchange(false, std::memory_order_acquire);
+
+	if (!commit(changed)) {
+		// Not committed: the next commit can't be skipped either
+		if (changed) {
+			changed_.store(true, std::memory_order_release);
+		}
+		return false;
+	}
+
+	return true;
+}
+
+bool CommitJournal::commit(bool changed) {
+	struct stat st;
+	if (::fstat(fd_, &st) != 0 || static_cast<std::uint64_t>(st.st_size) < payload_offset_) {
+		return false;
+	}
+
+	const std::uint64_t size = st.st_size - payload_offset_;
+
+	// The size also catches the writes that weren't reported at all
+	if (committed_ && pending_ == 0 && !changed && size == committed_size_) {
+		return true;
+	}
+
+	// The payload must be on disk before the header refers to it
+	if (!datasync(fd_)) {
+		return false;
+	}
+
+	HeaderExtension extension;
+	extension.committed_size = size;
+
+	if (!tail_checksum(fd_, payload_offset_, extension.committed_size, extension.committed_checksum)) {
+		return false;
+	}
+
+	char buffer[metadata_extension_size];
+	extension.serialize(buffer);
+
+	// The other fields of the extension are left as is
+	if (!write_all(fd_, buffer + HeaderExtension::commit_offset, HeaderExtension::commit_size,
+	               HeaderExtension::offset + HeaderExtension::commit_offset) ||
+	    !datasync(fd_)) {
+		return false;
+	}
+
+	pending_ = 0;
+	committed_ = true;
+	committed_size_ = size;
+
+	return true;
+}
+
+bool CommitJournal::recover(int fd, std::uint64_t payload_offset, const HeaderExtension& extension) {
+	struct stat st;
+	if (::fstat(fd, &st) != 0 || static_cast<std::uint64_t>(st.st_size) < payload_offset + extension.committed_size) {
+		return false;
+	}
+
+	std::uint64_t checksum = 0;
+	if (!tail_checksum(fd, payload_offset, extension.committed_size, checksum) ||
+	    checksum != extension.committed_checksum) {
+		return false;
+	}
+
+	return ::ftruncate(fd, payload_offset + extension.committed_size) == 0;
+}
+
+}}} // namespace reven::binresource::detail
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "header_extension.h"
+
+namespace reven {
+namespace binresource {
+namespace detail {
+
+///
+/// Record periodically in the header of a resource the size of its payload known to be on disk, so that the resource
+/// can be recovered after a crash of its writer.
+///
+class CommitJournal {
+public:
+	//! `fd` isn't owned. `payload_offset` is the size of the header.
+	CommitJournal(int fd, std::uint64_t payload_offset, std::uint64_t interval);
+
+	//! Count data written to the file, and commit if `interval` bytes were written since the last commit.
+	//! Return false if the commit failed.
+	bool written(std::uint64_t size);
+
+	//! Data was written to the file without being counted, e.g. at an offset of the payload: the next commit can't be
+	//! skipped. Thread-safe.
+	void changed() { changed_.store(true, std::memory_order_release); }
+
+	//! Make the data written so far durable, then record the size of the payload in the header. Skipped if nothing
+	//! was written since the last commit. Return false on failure.
+	bool commit();
+
+	//! Check that the committed payload of the file is on disk and drop what was written after it.
+	//! Return false if the committed payload is missing or corrupted.
+	static bool recover(int fd, std::uint64_t payload_offset, const HeaderExtension& extension);
+
+private:
+	//! `changed` is whether data was written without being counted since the last commit
+	bool commit(bool changed);
+
+private:
+	int fd_;
+	std::uint64_t payload_offset_;
+	std::uint64_t interval_;
+
+	//! Data written since the last commit
+	std::uint64_t pending_ = 0;
+	std::atomic<bool> changed_{false};
+	bool committed_ = false;
+	//! Size of the payload recorded by the last commit
+	std::uint64_t committed_size_ = 0;
+};
+
+}}} // namespace reven::binresource::detail
@@ -0,0 +1,202 @@
+#include "concurrent_writer.h"
+#include "common.h"
+#include "file_buf.h"
+#include "header_extension.h"
+#include "instrumented_buf.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace reven {
+namespace binresource {
+
+namespace {
+
+// Nothing is recorded in the extension: the resources are readable by the versions of the library older than it
+constexpr std::uint32_t header_version = detail::metadata_version_without_extension;
+constexpr std::size_t header_size = detail::header_size(header_version);
+
+//! Set in the reserved size once the writer is finalized
+constexpr std::uint64_t closed_bit = std::uint64_t(1) << 63;
+
+} // anonymous namespace
+
+struct ConcurrentWriter::State {
+	int fd = -1;
+	std::uint64_t preallocated = 0;
+	//! Filename of the resource
+	std::string path;
+
+	//! Size of the payload reserved so far, with closed_bit set once finalized
+	std::atomic<std::uint64_t> reserved{0};
+	//! Number of bytes of the payload written so far, including the failed writes
+	std::atomic<std::uint64_t> written{0};
+	std::atomic<bool> failed{false};
+
+	~State() {
+		if (fd >= 0) {
+			::close(fd);
+		}
+	}
+};
+
+ConcurrentWriter::ConcurrentWriter(std::unique_ptr<State>&& state) : state_(std::move(state)) {}
+
+ConcurrentWriter::ConcurrentWriter(ConcurrentWriter&&) = default;
+
+ConcurrentWriter& ConcurrentWriter::operator=(ConcurrentWriter&& other) {
+	if (state_ != nullptr) {
+		close(std::chrono::milliseconds(0));
+	}
+
+	state_ = std::move(other.state_);
+	return *this;
+}
+
+ConcurrentWriter::~ConcurrentWriter() {
+	// Nobody can still be writing: the missing ranges will never come
+	if (state_ != nullptr) {
+		close(std::chrono::milliseconds(0));
+	}
+}
+
+ConcurrentWriter ConcurrentWriter::create(const char* filename, const Metadata& md, const WriterOptions& options) {
+	detail::TraceScope scope(binresource::tracer(), TraceEventType::WriterCreate, filename);
+
+	auto state = std::make_unique<State>();
+	state->path = filename;
+
+	state->fd = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	if (state->fd < 0) {
+		throw WriterError("Bad stream");
+	}
+
+	char header[detail::header_size(metadata_version)];
+	detail::serialize_header(md, header_version, header);
+
+	if (!detail::write_all(state->fd, header, header_size, 0)) {
+		throw WriterError("While writing metadata: Can't write the metadata");
+	}
+
+	// Preallocation is only an optimization: ignore the file systems that don't support it
+	if (options.size_hint != 0 &&
+	    ::fallocate(state->fd, FALLOC_FL_KEEP_SIZE, 0, header_size + options.size_hint) == 0) {
+		state->preallocated = header_size + options.size_hint;
+	}
+
+	scope.set_size(header_size);
+
+	return ConcurrentWriter(std::move(state));
+}
+
+std::size_t ConcurrentWriter::md_size() const {
+	return header_size;
+}
+
+std::uint64_t ConcurrentWriter::reserve(std::uint64_t size) {
+	// Never reserve after the finalization, which relies on the reserved size it saw
+	auto offset = state_->reserved.load(std::memory_order_relaxed);
+	do {
+		if ((offset & closed_bit) != 0) {
+			throw WriterError("Writer is finalized");
+		}
+	} while (!state_->reserved.compare_exchange_weak(offset, offset + size, std::memory_order_relaxed));
+
+	return offset;
+}
+
+void ConcurrentWriter::write(std::uint64_t offset, const void* data, std::uint64_t size) {
+	const bool ok = detail::write_all(state_->fd, static_cast<const char*>(data), size, header_size + offset);
+
+	if (!ok) {
+		state_->failed.store(true, std::memory_order_relaxed);
+	}
+
+	// Counted even on failure so that the finalization doesn't wait forever
+	state_->written.fetch_add(size, std::memory_order_release);
+
+	if (!ok) {
+		throw WriterError("Can't write the data");
+	}
+}
+
+std::uint64_t ConcurrentWriter::append(const void* data, std::uint64_t size) {
+	const auto offset = reserve(size);
+	write(offset, data, size);
+	return offset;
+}
+
+std::uint64_t ConcurrentWriter::size() const {
+	return state_->reserved.load(std::memory_order_relaxed) & ~closed_bit;
+}
+
+void ConcurrentWriter::set_metadata(const Metadata& md) {
+	detail::TraceScope scope(binresource::tracer(), TraceEventType::WriterSetMetadata, state_->path.c_str(),
+	                         sizeof(magic) + sizeof(metadata_version));
+	scope.set_size(header_size - sizeof(magic) - sizeof(metadata_version));
+
+	char buffer[Metadata::serialized_size];
+	md.serialize(buffer);
+
+	// The header has no extension: only the metadata of the previous version is written
+	if (!detail::write_all(state_->fd, buffer, sizeof(buffer) - metadata_extension_size,
+	                       sizeof(magic) + sizeof(metadata_version))) {
+		throw WriterError("While writing metadata: Can't write the metadata");
+	}
+}
+
+void ConcurrentWriter::finalize(std::chrono::milliseconds timeout) && {
+	const bool ok = close(timeout);
+	state_.reset();
+
+	if (!ok) {
+		throw WriterError("Can't write the data, or a reserved range wasn't written");
+	}
+}
+
+bool ConcurrentWriter::close(std::chrono::milliseconds timeout) {
+	const auto size = state_->reserved.fetch_or(closed_bit, std::memory_order_relaxed) & ~closed_bit;
+	const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+	// The producers are in the middle of their writes: wait for them with a bounded backoff, until the deadline in
+	// case a range is never written
+	bool complete = true;
+	auto backoff = std::chrono::microseconds(1);
+	while (state_->written.load(std::memory_order_acquire) < size) {
+		if (std::chrono::steady_clock::now() >= deadline) {
+			complete = false;
+			break;
+		}
+
+		std::this_thread::sleep_for(backoff);
+		backoff = std::min(backoff * 2, std::chrono::microseconds(1000));
+	}
+
+	bool ok = complete && !state_->failed.load(std::memory_order_relaxed);
+
+	// Ranges may have been written out of order: the final size is the one of the reserved payload
+	if (::ftruncate(state_->fd, header_size + size) != 0) {
+		ok = false;
+	}
+
+	if (state_->preallocated > header_size + size) {
+		// Release the space allocated after the end of the file
+		::fallocate(state_->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, header_size + size,
+		            state_->preallocated - header_size - size);
+	}
+
+	::close(state_->fd);
+	state_->fd = -1;
+
+	return ok;
+}
+
+}} // namespace reven::binresource
@@ -0,0 +1,129 @@
+#include "content_hash.h"
+
+#include <cstring>
+
+namespace reven {
+namespace binresource {
+namespace detail {
+
+namespace {
+
+constexpr std::uint64_t prime1 = 0x9e3779b185ebca87;
+constexpr std::uint64_t prime2 = 0xc2b2ae3d27d4eb4f;
+constexpr std::uint64_t prime3 = 0x165667b19e3779f9;
+constexpr std::uint64_t prime4 = 0x85ebca77c2b2ae63;
+constexpr std::uint64_t prime5 = 0x27d4eb2f165667c5;
+
+std::uint64_t rotl(std::uint64_t value, int bits) {
+	return (value << bits) | (value >> (64 - bits));
+}
+
+std::uint64_t read64(const unsigned char* data) {
+	std::uint64_t value;
+	std::memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+std::uint32_t read32(const unsigned char* data) {
+	std::uint32_t value;
+	std::memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+std::uint64_t round(std::uint64_t accumulator, std::uint64_t input) {
+	accumulator += input * prime2;
+	accumulator = rotl(accumulator, 31);
+	return accumulator * prime1;
+}
+
+std::uint64_t merge_round(std::uint64_t hash, std::uint64_t accumulator) {
+	hash ^= round(0, accumulator);
+	return hash * prime1 + prime4;
+}
+
+} // anonymous namespace
+
+ContentHash::ContentHash(std::uint64_t seed)
+	: seed_(seed), accumulators_{seed + prime1 + prime2, seed + prime2, seed, seed - prime1} {}
+
+void ContentHash::consume(const unsigned char* stripe) {
+	for (std::size_t i = 0; i < 4; ++i) {
+		accumulators_[i] = round(accumulators_[i], read64(stripe + i * 8));
+	}
+}
+
+void ContentHash::update(const void* data, std::size_t size) {
+	const auto* bytes = static_cast<const unsigned char*>(data);
+	total_size_ += size;
+
+	if (pending_size_ + size < sizeof(pending_)) {
+		std::memcpy(pending_ + pending_size_, bytes, size);
+		pending_size_ += size;
+		return;
+	}
+
+	if (pending_size_ > 0) {
+		const auto count = sizeof(pending_) - pending_size_;
+		std::memcpy(pending_ + pending_size_, bytes, count);
+		consume(pending_);
+
+		bytes += count;
+		size -= count;
+		pending_size_ = 0;
+	}
+
+	while (size >= sizeof(pending_)) {
+		consume(bytes);
+		bytes += sizeof(pending_);
+		size -= sizeof(pending_);
+	}
+
+	std::memcpy(pending_, bytes, size);
+	pending_size_ = size;
+}
+
+std::uint64_t ContentHash::digest() const {
+	std::uint64_t hash;
+
+	if (total_size_ >= sizeof(pending_)) {
+		hash = rotl(accumulators_[0], 1) + rotl(accumulators_[1], 7) + rotl(accumulators_[2], 12) +
+		       rotl(accumulators_[3], 18);
+
+		for (const auto accumulator : accumulators_) {
+			hash = merge_round(hash, accumulator);
+		}
+	} else {
+		hash = seed_ + prime5;
+	}
+
+	hash += total_size_;
+
+	const unsigned char* data = pending_;
+	const unsigned char* end = pending_ + pending_size_;
+
+	for (; data + 8 <= end; data += 8) {
+		hash ^= round(0, read64(data));
+		hash = rotl(hash, 27) * prime1 + prime4;
+	}
+
+	if (data + 4 <= end) {
+		hash ^= read32(data) * prime1;
+		hash = rotl(hash, 23) * prime2 + prime3;
+		data += 4;
+	}
+
+	for (; data < end; ++data) {
+		hash ^= *data * prime5;
+		hash = rotl(hash, 11) * prime1;
+	}
+
+	hash ^= hash >> 33;
+	hash *= prime2;
+	hash ^= hash >> 29;
+	hash *= prime3;
+	hash ^= hash >> 32;
+
+	return hash;
+}
+
+}}} // namespace reven::binresource::detail
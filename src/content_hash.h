@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace reven {
+namespace binresource {
+namespace detail {
+
+///
+/// Incremental XXH64 hash of a stream of bytes.
+/// Gives the same result as hashing all the bytes at once, whatever the sizes of the updates.
+///
+class ContentHash {
+public:
+	explicit ContentHash(std::uint64_t seed = 0);
+
+	void update(const void* data, std::size_t size);
+
+	//! Hash of the bytes passed to `update` so far. The hash can still be updated afterwards.
+	std::uint64_t digest() const;
+
+private:
+	//! Process a stripe of 32 bytes
+	void consume(const unsigned char* stripe);
+
+private:
+	std::uint64_t seed_;
+	std::uint64_t accumulators_[4];
+	std::uint64_t total_size_ = 0;
+
+	//! Beginning of the next stripe, waiting for the rest of its bytes
+	unsigned char pending_[32];
+	std::size_t pending_size_ = 0;
+};
+
+}}} // namespace reven::binresource::detail
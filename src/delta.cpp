@@ -0,0 +1,361 @@
+#include "delta.h"
+#include "common.h"
+#include "content_hash.h"
+#include "reader.h"
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+#include <sys/stat.h>
+
+namespace reven {
+namespace binresource {
+
+namespace {
+
+enum class DeltaOperation : std::uint64_t {
+	//! Consecutive blocks of the base resource, followed by their hashes
+	Copy = 0,
+	//! Data stored in the delta
+	Literal = 1,
+	End = 2,
+};
+
+//! Seed of the second hash of the blocks, which makes the collisions of the hashes of two blocks negligible
+constexpr std::uint64_t second_seed = 0x5265766e42696e52;
+
+using BlockHash = std::array<std::uint64_t, 2>;
+
+BlockHash hash_block(const char* data, std::size_t size) {
+	detail::ContentHash first;
+	detail::ContentHash second(second_seed);
+
+	first.update(data, size);
+	second.update(data, size);
+
+	return BlockHash{{first.digest(), second.digest()}};
+}
+
+Reader open_reader(const char* filename) {
+	try {
+		return Reader::open(filename);
+	} catch (const ReaderError& e) {
+		throw DeltaError((std::string("While reading the resource: ") + e.what()).c_str());
+	}
+}
+
+std::uint64_t payload_size_of(const char* filename, const Reader& reader) {
+	struct stat st;
+	if (::stat(filename, &st) != 0 || static_cast<std::uint64_t>(st.st_size) < reader.md_size()) {
+		throw DeltaError("Can't read the size of the payload");
+	}
+
+	return st.st_size - reader.md_size();
+}
+
+//! Size of the block `index` of a payload
+std::uint64_t block_size_at(std::uint64_t index, std::uint64_t block_size, std::uint64_t payload_size) {
+	return std::min(block_size, payload_size - index * block_size);
+}
+
+void read_block(Reader& reader, std::uint64_t offset, char* data, std::size_t size) {
+	MutableBuffer buffer{data, size};
+
+	try {
+		if (reader.read_vec(offset, &buffer, 1) == size) {
+			return;
+		}
+	} catch (const ReaderError& e) {
+		throw DeltaError((std::string("While reading the resource: ") + e.what()).c_str());
+	}
+
+	throw DeltaError("Can't read the payload");
+}
+
+template <typename T>
+void write_value(std::ostream& out, T value) {
+	out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+T read_value(std::istream& in) {
+	T value;
+	in.read(reinterpret_cast<char*>(&value), sizeof(value));
+
+	if (in.gcount() != sizeof(value)) {
+		throw DeltaError("Can't read enough data for the delta");
+	}
+
+	return value;
+}
+
+} // anonymous namespace
+
+Signature Signature::compute(const char* filename, std::size_t block_size) {
+	if (block_size == 0) {
+		throw DeltaError("The size of the blocks can't be 0");
+	}
+
+	auto reader = open_reader(filename);
+
+	Signature signature;
+	signature.type_ = reader.metadata().type();
+	signature.block_size_ = block_size;
+	signature.payload_size_ = payload_size_of(filename, reader);
+
+	std::vector<char> buffer(block_size);
+
+	for (std::uint64_t offset = 0; offset < signature.payload_size_; offset += block_size) {
+		const auto size = std::min<std::uint64_t>(block_size, signature.payload_size_ - offset);
+
+		read_block(reader, offset, buffer.data(), size);
+		signature.block_hashes_.push_back(hash_block(buffer.data(), size));
+	}
+
+	return signature;
+}
+
+void Signature::serialize(std::ostream& out) const {
+	write_value(out, signature_magic);
+	write_value(out, delta_version);
+	write_value(out, type_);
+	write_value(out, block_size_);
+	write_value(out, payload_size_);
+	write_value(out, static_cast<std::uint64_t>(block_hashes_.size()));
+	out.write(reinterpret_cast<const char*>(block_hashes_.data()), block_hashes_.size() * sizeof(BlockHash));
+
+	if (!out) {
+		throw DeltaError("Can't write the signature");
+	}
+}
+
+Signature Signature::deserialize(std::istream& in) {
+	if (read_value<std::uint64_t>(in) != signature_magic) {
+		throw DeltaError("Wrong magic");
+	}
+
+	if (read_value<std::uint32_t>(in) != delta_version) {
+		throw DeltaError("Unsupported signature version");
+	}
+
+	Signature signature;
+	signature.type_ = read_value<std::uint32_t>(in);
+	signature.block_size_ = read_value<std::uint64_t>(in);
+	signature.payload_size_ = read_value<std::uint64_t>(in);
+
+	const auto count = read_value<std::uint64_t>(in);
+
+	if (signature.block_size_ == 0 ||
+	    count != (signature.payload_size_ + signature.block_size_ - 1) / signature.block_size_) {
+		throw DeltaError("Corrupted signature");
+	}
+
+	for (std::uint64_t i = 0; i < count; ++i) {
+		signature.block_hashes_.push_back(read_value<BlockHash>(in));
+	}
+
+	return signature;
+}
+
+DeltaStats make_delta(const Signature& base, const char* filename, std::ostream& delta) {
+	auto reader = open_reader(filename);
+
+	if (reader.metadata().type() != base.type()) {
+		throw DeltaError("The resources have different types");
+	}
+
+	const auto size = payload_size_of(filename, reader);
+	const auto& base_hashes = base.block_hashes();
+
+	write_value(delta, delta_magic);
+	write_value(delta, delta_version);
+	write_value(delta, base.type());
+	write_value(delta, base.block_size());
+	write_value(delta, base.payload_size());
+	write_value(delta, size);
+	reader.metadata().serialize(metadata_version, delta);
+
+	// Find the blocks that moved by their first hash
+	std::unordered_map<std::uint64_t, std::uint64_t> base_blocks;
+	for (std::uint64_t i = base_hashes.size(); i-- > 0;) {
+		base_blocks[base_hashes[i][0]] = i;
+	}
+
+	const auto base_block_size = [&base](std::uint64_t index) {
+		return block_size_at(index, base.block_size(), base.payload_size());
+	};
+
+	// The blocks to copy are gathered in runs of consecutive blocks
+	std::uint64_t run_begin = 0;
+	std::uint64_t run_size = 0;
+
+	const auto write_run = [&] {
+		if (run_size == 0) {
+			return;
+		}
+
+		write_value(delta, DeltaOperation::Copy);
+		write_value(delta, run_begin);
+		write_value(delta, run_size);
+		delta.write(reinterpret_cast<const char*>(base_hashes.data() + run_begin), run_size * sizeof(BlockHash));
+
+		run_size = 0;
+	};
+
+	DeltaStats stats;
+	std::vector<char> buffer(base.block_size());
+
+	for (std::uint64_t offset = 0, index = 0; offset < size; offset += base.block_size(), ++index) {
+		const auto count = block_size_at(index, base.block_size(), size);
+
+		read_block(reader, offset, buffer.data(), count);
+		const auto hash = hash_block(buffer.data(), count);
+
+		// Most blocks that didn't change are at the same place
+		std::uint64_t match = index;
+		if (index >= base_hashes.size() || base_hashes[index] != hash || base_block_size(index) != count) {
+			const auto it = base_blocks.find(hash[0]);
+			match = it != base_blocks.end() && base_hashes[it->second] == hash && base_block_size(it->second) == count
+			        ? it->second : base_hashes.size();
+		}
+
+		if (match < base_hashes.size()) {
+			if (run_size != 0 && run_begin + run_size == match) {
+				++run_size;
+			} else {
+				write_run();
+				run_begin = match;
+				run_size = 1;
+			}
+
+			stats.copied_size += count;
+			continue;
+		}
+
+		write_run();
+
+		write_value(delta, DeltaOperation::Literal);
+		write_value(delta, count);
+		delta.write(buffer.data(), count);
+
+		stats.literal_size += count;
+	}
+
+	write_run();
+	write_value(delta, DeltaOperation::End);
+
+	if (!delta) {
+		throw DeltaError("Can't write the delta");
+	}
+
+	return stats;
+}
+
+void apply_delta(const char* base, std::istream& delta, const char* filename, const WriterOptions& options) {
+	if (read_value<std::uint64_t>(delta) != delta_magic) {
+		throw DeltaError("Wrong magic");
+	}
+
+	if (read_value<std::uint32_t>(delta) != delta_version) {
+		throw DeltaError("Unsupported delta version");
+	}
+
+	const auto type = read_value<std::uint32_t>(delta);
+	const auto base_block_size = read_value<std::uint64_t>(delta);
+	const auto base_payload_size = read_value<std::uint64_t>(delta);
+	const auto size = read_value<std::uint64_t>(delta);
+
+	if (base_block_size == 0) {
+		throw DeltaError("Corrupted delta");
+	}
+
+	auto reader = open_reader(base);
+
+	if (reader.metadata().type() != type || payload_size_of(base, reader) != base_payload_size) {
+		throw DeltaError("The delta wasn't made for this base resource");
+	}
+
+	// The new version is only published once complete: a delta found corrupted halfway leaves nothing behind, and the
+	// base resource can be replaced by its new version as it is read through its own descriptor
+	auto atomic_options = options;
+	atomic_options.atomic = true;
+
+	std::unique_ptr<Writer> writer;
+
+	try {
+		const auto md = Metadata::deserialize(metadata_version, delta);
+		writer = std::make_unique<Writer>(Writer::create(filename, md, atomic_options));
+	} catch (const MetadataError& e) {
+		throw DeltaError((std::string("While reading metadata: ") + e.what()).c_str());
+	} catch (const WriterError& e) {
+		throw DeltaError((std::string("While writing the resource: ") + e.what()).c_str());
+	}
+
+	auto& out = writer->stream();
+	std::vector<char> buffer(base_block_size);
+	std::uint64_t written = 0;
+
+	while (true) {
+		const auto operation = read_value<DeltaOperation>(delta);
+
+		if (operation == DeltaOperation::End) {
+			break;
+		}
+
+		if (operation == DeltaOperation::Copy) {
+			const auto begin = read_value<std::uint64_t>(delta);
+			const auto count = read_value<std::uint64_t>(delta);
+
+			for (auto index = begin; index < begin + count; ++index) {
+				const auto hash = read_value<BlockHash>(delta);
+
+				if (index >= (base_payload_size + base_block_size - 1) / base_block_size) {
+					throw DeltaError("Corrupted delta");
+				}
+
+				const auto block = block_size_at(index, base_block_size, base_payload_size);
+				read_block(reader, index * base_block_size, buffer.data(), block);
+
+				if (hash_block(buffer.data(), block) != hash) {
+					throw DeltaError("The delta wasn't made for this base resource");
+				}
+
+				out.write(buffer.data(), block);
+				written += block;
+			}
+		} else if (operation == DeltaOperation::Literal) {
+			const auto count = read_value<std::uint64_t>(delta);
+
+			if (count > base_block_size) {
+				throw DeltaError("Corrupted delta");
+			}
+
+			delta.read(buffer.data(), count);
+			if (static_cast<std::uint64_t>(delta.gcount()) != count) {
+				throw DeltaError("Can't read enough data for the delta");
+			}
+
+			out.write(buffer.data(), count);
+			written += count;
+		} else {
+			throw DeltaError("Corrupted delta");
+		}
+
+		if (!out) {
+			throw DeltaError("Can't write the resource");
+		}
+	}
+
+	if (written != size) {
+		throw DeltaError("Corrupted delta");
+	}
+
+	const auto stream = std::move(*writer).finalize();
+
+	if (!*stream) {
+		throw DeltaError("Can't write the resource");
+	}
+}
+
+}} // namespace reven::binresource
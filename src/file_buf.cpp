@@ -0,0 +1,735 @@
+#include "file_buf.h"
+#include "commit_journal.h"
+#include "content_hash.h"
+#include "follower.h"
+#include "header_extension.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace reven {
+namespace binresource {
+namespace detail {
+
+namespace {
+
+std::size_t page_size() {
+	static const auto size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+	return size;
+}
+
+} // anonymous namespace
+
+FileBuf::FileBuf(int fd, std::size_t buffer_size) : fd_(fd) {
+	const auto page = page_size();
+	buffer_size_ = std::max<std::size_t>((buffer_size + page - 1) / page * page, page);
+
+	void* buffer = nullptr;
+	if (::posix_memalign(&buffer, page, buffer_size_) != 0) {
+		throw std::bad_alloc();
+	}
+	buffer_.reset(static_cast<char*>(buffer));
+
+	setp(nullptr, nullptr);
+	setg(nullptr, nullptr, nullptr);
+}
+
+FileBuf::~FileBuf() {
+	if (fd_ < 0) {
+		return;
+	}
+
+	sync();
+	store_content_hash();
+
+	if (journal_ != nullptr) {
+		journal_->commit();
+	}
+
+	if (preallocated_ > 0) {
+		struct stat st;
+		if (::fstat(fd_, &st) == 0 && static_cast<std::uint64_t>(st.st_size) < preallocated_) {
+			// Release the space allocated after the end of the file
+			::fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, st.st_size, preallocated_ - st.st_size);
+		}
+	}
+
+	::close(fd_);
+
+	// Never published: the writing wasn't completed
+	if (!temporary_path_.empty()) {
+		::unlink(temporary_path_.c_str());
+	}
+}
+
+void FileBuf::preallocate(std::uint64_t size) {
+	if (fd_ < 0 || size <= preallocated_) {
+		return;
+	}
+
+	// Preallocation is only an optimization: ignore the file systems that don't support it
+	if (::fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, size) == 0) {
+		preallocated_ = size;
+	}
+}
+
+void FileBuf::pace_writeback(std::uint64_t interval, bool drop_pages) {
+	writeback_interval_ = interval;
+	drop_pages_ = drop_pages;
+}
+
+bool FileBuf::writev(const struct iovec* iov, std::size_t count) {
+	if (fd_ < 0) {
+		return false;
+	}
+
+	const auto pos = position();
+
+	std::vector<struct iovec> buffers;
+	buffers.reserve(count + 1);
+
+	std::uint64_t offset = pos;
+	if (pbase() != nullptr && pptr() > pbase()) {
+		buffers.push_back({pbase(), static_cast<std::size_t>(pptr() - pbase())});
+		offset = buffer_offset_;
+	}
+
+	std::uint64_t size = 0;
+	for (std::size_t i = 0; i < count; ++i) {
+		buffers.push_back(iov[i]);
+		size += iov[i].iov_len;
+	}
+
+	setp(nullptr, nullptr);
+	setg(nullptr, nullptr, nullptr);
+	buffer_offset_ = pos;
+
+	if (!write_at(buffers.data(), buffers.size(), offset)) {
+		return false;
+	}
+
+	buffer_offset_ = pos + size;
+	return true;
+}
+
+void FileBuf::slice(std::uint64_t begin, std::uint64_t end) {
+	slice_begin_ = begin;
+	slice_end_ = end;
+}
+
+void FileBuf::follow(std::unique_ptr<Follower>&& follower) {
+	follower_ = std::move(follower);
+}
+
+void FileBuf::journal(std::unique_ptr<CommitJournal>&& journal) {
+	journal_ = std::move(journal);
+}
+
+bool FileBuf::commit() {
+	if (sync() != 0) {
+		return false;
+	}
+
+	return journal_ == nullptr || journal_->commit();
+}
+
+void FileBuf::written_directly() {
+	if (journal_ != nullptr) {
+		journal_->changed();
+	}
+}
+
+void FileBuf::temporary(std::string path) {
+	temporary_path_ = std::move(path);
+}
+
+bool FileBuf::publish(const char* filename, bool durable) {
+	if (temporary_path_.empty() || ::rename(temporary_path_.c_str(), filename) != 0) {
+		return false;
+	}
+
+	temporary_path_.clear();
+
+	if (!durable) {
+		return true;
+	}
+
+	// The rename is an update of the directory, which must be synced separately
+	return sync_parent_directory(filename);
+}
+
+bool FileBuf::datasync() {
+	if (fd_ < 0 || sync() != 0) {
+		return false;
+	}
+
+	int result = 0;
+	do {
+		result = ::fdatasync(fd_);
+	} while (result != 0 && errno == EINTR);
+
+	return result == 0;
+}
+
+void FileBuf::hash_from(std::uint64_t offset) {
+	hash_ = std::make_unique<ContentHash>();
+	hash_end_ = offset;
+	hashing_stopped_ = false;
+}
+
+void FileBuf::stop_hashing() {
+	hashing_stopped_ = true;
+}
+
+bool FileBuf::store_content_hash() {
+	if (hash_ == nullptr || hashing_stopped_) {
+		return true;
+	}
+
+	if (sync() != 0) {
+		return false;
+	}
+
+	std::uint64_t size = 0;
+	if (!file_size(size)) {
+		return false;
+	}
+
+	// The end of the payload wasn't written through the buffer
+	if (size != hash_end_) {
+		return true;
+	}
+
+	return write_content_hash(fd_, true, hash_->digest());
+}
+
+FileBuf::int_type FileBuf::overflow(int_type c) {
+	if (fd_ < 0) {
+		return traits_type::eof();
+	}
+
+	if (pbase() == nullptr) {
+		if (!reset_buffer()) {
+			return traits_type::eof();
+		}
+	} else if (pptr() > pbase()) {
+		const std::size_t size = pptr() - pbase();
+		if (!write_at(pbase(), size, buffer_offset_)) {
+			return traits_type::eof();
+		}
+		buffer_offset_ += size;
+	}
+
+	setp(buffer_.get(), buffer_.get() + buffer_size_);
+
+	if (!traits_type::eq_int_type(c, traits_type::eof())) {
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+	}
+
+	return traits_type::not_eof(c);
+}
+
+std::streamsize FileBuf::xsputn(const char* s, std::streamsize n) {
+	if (fd_ < 0 || n <= 0) {
+		return 0;
+	}
+
+	const std::size_t pending = pbase() != nullptr ? pptr() - pbase() : 0;
+
+	// Writes that don't fit in the rest of the buffer bypass it: the pending data is written along with the new data
+	// in a single call, instead of filling the buffer, writing it and copying the rest of the new data
+	if (pending + static_cast<std::size_t>(n) > buffer_size_) {
+		const auto pos = position();
+
+		bool ok = true;
+		if (pending > 0) {
+			struct iovec iov[2] = {
+				{pbase(), pending},
+				{const_cast<char*>(s), static_cast<std::size_t>(n)},
+			};
+			ok = write_at(iov, 2, buffer_offset_);
+
+			setp(nullptr, nullptr);
+			buffer_offset_ = pos;
+		} else {
+			ok = reset_buffer() && write_at(s, n, pos);
+		}
+
+		if (!ok) {
+			return 0;
+		}
+
+		buffer_offset_ = pos + n;
+		return n;
+	}
+
+	std::streamsize written = 0;
+	while (written < n) {
+		if (pptr() == epptr() && traits_type::eq_int_type(overflow(traits_type::eof()), traits_type::eof())) {
+			break;
+		}
+
+		const auto size = std::min<std::streamsize>(n - written, epptr() - pptr());
+		std::memcpy(pptr(), s + written, size);
+		pbump(static_cast<int>(size));
+		written += size;
+	}
+
+	return written;
+}
+
+FileBuf::int_type FileBuf::underflow() {
+	if (gptr() != nullptr && gptr() < egptr()) {
+		return traits_type::to_int_type(*gptr());
+	}
+
+	if (fd_ < 0 || !reset_buffer()) {
+		return traits_type::eof();
+	}
+
+	const auto size = read_at(buffer_.get(), buffer_size_, buffer_offset_);
+
+	if (size <= 0) {
+		return traits_type::eof();
+	}
+
+	setg(buffer_.get(), buffer_.get(), buffer_.get() + size);
+
+	return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize FileBuf::xsgetn(char* s, std::streamsize n) {
+	std::streamsize read = 0;
+
+	while (read < n) {
+		if (gptr() != nullptr && gptr() < egptr()) {
+			const auto size = std::min<std::streamsize>(n - read, egptr() - gptr());
+			std::memcpy(s + read, gptr(), size);
+			gbump(static_cast<int>(size));
+			read += size;
+			continue;
+		}
+
+		// Large reads bypass the buffer
+		if (static_cast<std::size_t>(n - read) >= buffer_size_) {
+			if (fd_ < 0 || !reset_buffer()) {
+				break;
+			}
+
+			const auto size = read_at(s + read, n - read, buffer_offset_);
+
+			if (size <= 0) {
+				break;
+			}
+
+			buffer_offset_ += size;
+			read += size;
+			continue;
+		}
+
+		if (traits_type::eq_int_type(underflow(), traits_type::eof())) {
+			break;
+		}
+	}
+
+	return read;
+}
+
+std::streamsize FileBuf::showmanyc() {
+	if (fd_ < 0) {
+		return -1;
+	}
+
+	std::uint64_t size = 0;
+	if (!file_size(size)) {
+		return -1;
+	}
+
+	const auto pos = position();
+	if (size > pos) {
+		return size - pos;
+	}
+
+	// Nothing available right now, but more may come
+	if (follower_ != nullptr && follower_->writing()) {
+		return 0;
+	}
+
+	return -1;
+}
+
+FileBuf::pos_type FileBuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode) {
+	if (fd_ < 0) {
+		return pos_type(off_type(-1));
+	}
+
+	const auto pos = position();
+
+	off_type target = off;
+	if (dir == std::ios_base::cur) {
+		if (off == 0) {
+			return pos_type(off_type(pos));
+		}
+
+		target += pos;
+	} else if (dir == std::ios_base::end) {
+		if (!reset_buffer()) {
+			return pos_type(off_type(-1));
+		}
+
+		std::uint64_t size = 0;
+		if (!file_size(size)) {
+			return pos_type(off_type(-1));
+		}
+
+		target += size;
+	}
+
+	if (target < 0) {
+		return pos_type(off_type(-1));
+	}
+
+	// Stay in the data already read if possible
+	if (eback() != nullptr && static_cast<std::uint64_t>(target) >= buffer_offset_ &&
+	    static_cast<std::uint64_t>(target) <= buffer_offset_ + (egptr() - eback())) {
+		setg(eback(), eback() + (target - buffer_offset_), egptr());
+		return pos_type(target);
+	}
+
+	if (!reset_buffer()) {
+		return pos_type(off_type(-1));
+	}
+
+	buffer_offset_ = target;
+
+	return pos_type(target);
+}
+
+FileBuf::pos_type FileBuf::seekpos(pos_type pos, std::ios_base::openmode which) {
+	return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+int FileBuf::sync() {
+	if (pbase() == nullptr || pptr() == pbase()) {
+		return 0;
+	}
+
+	const std::size_t size = pptr() - pbase();
+	if (!write_at(pbase(), size, buffer_offset_)) {
+		return -1;
+	}
+
+	buffer_offset_ += size;
+	setp(buffer_.get(), buffer_.get() + buffer_size_);
+
+	return 0;
+}
+
+std::uint64_t FileBuf::position() const {
+	if (pbase() != nullptr) {
+		return buffer_offset_ + (pptr() - pbase());
+	}
+
+	if (eback() != nullptr) {
+		return buffer_offset_ + (gptr() - eback());
+	}
+
+	return buffer_offset_;
+}
+
+bool FileBuf::file_size(std::uint64_t& size) const {
+	struct stat st;
+	if (::fstat(fd_, &st) != 0) {
+		return false;
+	}
+
+	const auto end = std::min<std::uint64_t>(st.st_size, slice_end_);
+	size = end > slice_begin_ ? end - slice_begin_ : 0;
+
+	return true;
+}
+
+bool FileBuf::reset_buffer() {
+	const auto pos = position();
+	bool ok = true;
+
+	if (pbase() != nullptr && pptr() > pbase()) {
+		ok = write_at(pbase(), pptr() - pbase(), buffer_offset_);
+	}
+
+	setp(nullptr, nullptr);
+	setg(nullptr, nullptr, nullptr);
+	buffer_offset_ = pos;
+
+	return ok;
+}
+
+ssize_t FileBuf::read_at(char* data, std::size_t size, std::uint64_t offset) {
+	if (slice_end_ != UINT64_MAX) {
+		if (offset >= slice_end_ - slice_begin_) {
+			return 0;
+		}
+
+		size = std::min<std::uint64_t>(size, slice_end_ - slice_begin_ - offset);
+	}
+
+	while (true) {
+		const auto result = ::pread(fd_, data, size, slice_begin_ + offset);
+
+		if (result < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (result == 0 && follower_ != nullptr && follower_->wait(offset)) {
+			continue;
+		}
+
+		return result;
+	}
+}
+
+bool FileBuf::write_at(const char* data, std::size_t size, std::uint64_t offset) {
+	struct iovec iov = {const_cast<char*>(data), size};
+	return write_at(&iov, 1, offset);
+}
+
+bool FileBuf::write_at(struct iovec* iov, std::size_t count, std::uint64_t offset) {
+	const auto begin = offset;
+
+	if (hash_ != nullptr) {
+		hash_written(iov, count, offset);
+	}
+
+	while (count > 0) {
+		const auto result = ::pwritev(fd_, iov, static_cast<int>(std::min<std::size_t>(count, IOV_MAX)),
+		                              slice_begin_ + offset);
+
+		if (result < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+
+		offset += result;
+
+		// Skip what was written
+		std::size_t written = result;
+		while (count > 0 && written >= iov->iov_len) {
+			written -= iov->iov_len;
+			++iov;
+			--count;
+		}
+
+		if (count > 0) {
+			iov->iov_base = static_cast<char*>(iov->iov_base) + written;
+			iov->iov_len -= written;
+		}
+	}
+
+	after_write(begin, offset - begin);
+
+	return journal_ == nullptr || journal_->written(offset - begin);
+}
+
+void FileBuf::hash_written(const struct iovec* iov, std::size_t count, std::uint64_t offset) {
+	// Data written out of order, or written again
+	if (offset != hash_end_ || hashing_stopped_) {
+		hash_.reset();
+		return;
+	}
+
+	for (std::size_t i = 0; i < count; ++i) {
+		hash_->update(iov[i].iov_base, iov[i].iov_len);
+		hash_end_ += iov[i].iov_len;
+	}
+}
+
+void FileBuf::after_write(std::uint64_t offset, std::size_t size) {
+	if (writeback_interval_ == 0) {
+		return;
+	}
+
+	window_begin_ = std::min(window_begin_, offset);
+	window_end_ = std::max(window_end_, offset + size);
+
+	if (window_end_ - window_begin_ < writeback_interval_) {
+		return;
+	}
+
+	// Start the writeback of what was just written, and wait for the previous interval so that the amount of
+	// dirty pages stays bounded
+	::sync_file_range(fd_, slice_begin_ + window_begin_, window_end_ - window_begin_, SYNC_FILE_RANGE_WRITE);
+
+	if (previous_end_ > previous_begin_) {
+		::sync_file_range(fd_, slice_begin_ + previous_begin_, previous_end_ - previous_begin_,
+		                  SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+
+		if (drop_pages_) {
+			::posix_fadvise(fd_, slice_begin_ + previous_begin_, previous_end_ - previous_begin_,
+			                POSIX_FADV_DONTNEED);
+		}
+	}
+
+	previous_begin_ = window_begin_;
+	previous_end_ = window_end_;
+	window_begin_ = UINT64_MAX;
+	window_end_ = 0;
+}
+
+bool write_all(int fd, const char* data, std::size_t size, std::uint64_t offset) {
+	while (size > 0) {
+		const auto result = ::pwrite(fd, data, size, offset);
+
+		if (result < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+
+		data += result;
+		size -= result;
+		offset += result;
+	}
+
+	return true;
+}
+
+bool copy_range(int in, std::uint64_t in_offset, int out, std::uint64_t out_offset, std::uint64_t size) {
+	while (size > 0) {
+		loff_t in_off = in_offset;
+		loff_t out_off = out_offset;
+
+		const auto result = ::copy_file_range(in, &in_off, out, &out_off, std::min<std::uint64_t>(size, 1 << 30), 0);
+
+		if (result < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (result < 0) {
+			// Not supported between these files: copy the rest through a buffer
+			if (errno != ENOSYS && errno != EXDEV && errno != EINVAL && errno != EOPNOTSUPP) {
+				return false;
+			}
+			break;
+		}
+
+		if (result == 0) {
+			return false;
+		}
+
+		in_offset += result;
+		out_offset += result;
+		size -= result;
+	}
+
+	std::vector<char> buffer(std::min<std::uint64_t>(size, 1024 * 1024));
+
+	while (size > 0) {
+		const auto result = ::pread(in, buffer.data(), std::min<std::uint64_t>(size, buffer.size()), in_offset);
+
+		if (result < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (result <= 0 || !write_all(out, buffer.data(), result, out_offset)) {
+			return false;
+		}
+
+		in_offset += result;
+		out_offset += result;
+		size -= result;
+	}
+
+	return true;
+}
+
+std::string parent_directory(const char* filename) {
+	const char* slash = std::strrchr(filename, '/');
+
+	if (slash == nullptr) {
+		return ".";
+	}
+
+	if (slash == filename) {
+		return "/";
+	}
+
+	return std::string(filename, slash);
+}
+
+bool sync_parent_directory(const char* filename) {
+	const int dir = ::open(parent_directory(filename).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dir < 0) {
+		return false;
+	}
+
+	int result = 0;
+	do {
+		result = ::fsync(dir);
+	} while (result != 0 && errno == EINTR);
+
+	::close(dir);
+
+	return result == 0;
+}
+
+namespace {
+
+bool set_lock(int fd, short type) {
+	struct flock lock = {};
+	lock.l_type = type;
+	lock.l_whence = SEEK_SET;
+
+	int result = 0;
+	do {
+		result = ::fcntl(fd, F_OFD_SETLK, &lock);
+	} while (result != 0 && errno == EINTR);
+
+	// Depending on the system, a conflicting lock is reported as EACCES
+	if (result != 0 && errno == EACCES) {
+		errno = EWOULDBLOCK;
+	}
+
+	return result == 0;
+}
+
+} // anonymous namespace
+
+bool lock_file(int fd) {
+	return set_lock(fd, F_WRLCK);
+}
+
+void unlock_file(int fd) {
+	set_lock(fd, F_UNLCK);
+}
+
+bool file_locked(int fd) {
+	struct flock lock = {};
+	lock.l_type = F_RDLCK;
+	lock.l_whence = SEEK_SET;
+
+	if (::fcntl(fd, F_OFD_GETLK, &lock) != 0) {
+		return false;
+	}
+
+	return lock.l_type != F_UNLCK;
+}
+
+FileStream::FileStream(int fd, std::size_t buffer_size) : std::iostream(nullptr), buf_(fd, buffer_size) {
+	if (buf_.is_open()) {
+		rdbuf(&buf_);
+	}
+}
+
+}}} // namespace reven::binresource::detail
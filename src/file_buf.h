@@ -0,0 +1,196 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <streambuf>
+#include <string>
+
+#include <sys/uio.h>
+
+namespace reven {
+namespace binresource {
+namespace detail {
+
+class CommitJournal;
+class ContentHash;
+class Follower;
+
+///
+/// Buffered streambuf over a file descriptor.
+/// The same buffer is used either for reading or for writing, and the accesses to the file are done with
+/// positional calls at the offset tracked by the buffer, so the offset of the file descriptor itself is never used.
+/// The buffer is page-aligned and its size is rounded up to a multiple of the page size.
+///
+class FileBuf : public std::streambuf {
+public:
+	//! Take the ownership of the file descriptor
+	FileBuf(int fd, std::size_t buffer_size);
+	~FileBuf() override;
+
+	FileBuf(const FileBuf&) = delete;
+	FileBuf& operator=(const FileBuf&) = delete;
+
+	bool is_open() const { return fd_ >= 0; }
+	int fd() const { return fd_; }
+
+	//! Allocate the disk space of the file up to `size` bytes without changing its size.
+	//! The space allocated after the end of the file is released at the destruction of the buffer.
+	void preallocate(std::uint64_t size);
+
+	//! Start the writeback of the written data every `interval` bytes and wait for the writeback of the previous
+	//! interval. If `drop_pages` is true, the pages already written back are dropped from the page cache.
+	void pace_writeback(std::uint64_t interval, bool drop_pages);
+
+	//! Write the buffers contiguously at the current position, along with the pending data, with as few calls as
+	//! possible, and move the position after them.
+	bool writev(const struct iovec* iov, std::size_t count);
+
+	//! Only give access to the range [begin, end) of the file, at offsets relative to `begin`: the reads stop at `end`,
+	//! and the end of the stream is the end of the range, or of the file if it comes before.
+	//! Must be called before any access.
+	void slice(std::uint64_t begin, std::uint64_t end);
+
+	//! Wait for the file to grow with the follower instead of reaching the end of the file
+	void follow(std::unique_ptr<Follower>&& follower);
+
+	//! Report the written data to the journal, which is committed a last time at the destruction of the buffer
+	void journal(std::unique_ptr<CommitJournal>&& journal);
+	bool journaled() const { return journal_ != nullptr; }
+
+	//! Write the pending data and commit it to the journal, if any. Return false on failure.
+	bool commit();
+
+	//! Data was written to the file without the buffer, e.g. at an offset: let the journal know. Thread-safe.
+	void written_directly();
+
+	//! The file is a temporary file at `path`, removed at the destruction of the buffer unless it is published
+	void temporary(std::string path);
+	bool is_temporary() const { return !temporary_path_.empty(); }
+
+	//! Rename the temporary file to `filename`, replacing any previous file. If `durable` is true, the rename is
+	//! synced to the disk. Return false on failure.
+	bool publish(const char* filename, bool durable);
+
+	//! Write the pending data and sync the data of the file to the disk. Return false on failure.
+	bool datasync();
+
+	//! Hash the payload of the resource written through the buffer from `offset`, as long as it is written
+	//! contiguously. The hash is stored in the header of the resource a last time at the destruction of the buffer.
+	void hash_from(std::uint64_t offset);
+
+	//! Stop hashing, when the file is written without the buffer. Thread-safe.
+	void stop_hashing();
+
+	//! Write the pending data and store the hash in the header of the resource if the payload was written contiguously
+	//! up to the end of the file. Return false on failure.
+	bool store_content_hash();
+
+protected:
+	int_type overflow(int_type c) override;
+	std::streamsize xsputn(const char* s, std::streamsize n) override;
+	int_type underflow() override;
+	std::streamsize xsgetn(char* s, std::streamsize n) override;
+	std::streamsize showmanyc() override;
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+	int sync() override;
+
+private:
+	//! Current position in the file, taking the buffer into account
+	std::uint64_t position() const;
+	//! Size of the file, or of its slice. Return false on failure.
+	bool file_size(std::uint64_t& size) const;
+
+	//! Write the pending data and leave the buffer empty, positioned at the current position
+	bool reset_buffer();
+	bool write_at(const char* data, std::size_t size, std::uint64_t offset);
+	//! Read at `offset`, waiting for the file to grow when following it. Return the result of pread.
+	ssize_t read_at(char* data, std::size_t size, std::uint64_t offset);
+	//! Write the buffers contiguously at `offset` with as few calls as possible. `iov` is modified.
+	bool write_at(struct iovec* iov, std::size_t count, std::uint64_t offset);
+	void after_write(std::uint64_t offset, std::size_t size);
+	//! Hash the buffers about to be written at `offset`
+	void hash_written(const struct iovec* iov, std::size_t count, std::uint64_t offset);
+
+private:
+	int fd_;
+	std::size_t buffer_size_;
+	struct FreeDeleter {
+		void operator()(char* p) const { std::free(p); }
+	};
+	std::unique_ptr<char, FreeDeleter> buffer_;
+
+	//! Offset in the file of the beginning of the buffer
+	std::uint64_t buffer_offset_ = 0;
+
+	//! Range of the file given access to by `slice`. The offsets of the buffer are relative to its beginning.
+	std::uint64_t slice_begin_ = 0;
+	std::uint64_t slice_end_ = UINT64_MAX;
+
+	std::unique_ptr<Follower> follower_;
+	//! Path of the file if it is temporary, or an empty string
+	std::string temporary_path_;
+	std::unique_ptr<CommitJournal> journal_;
+
+	//! Hash of the data written so far, or nullptr if not hashing
+	std::unique_ptr<ContentHash> hash_;
+	//! End of the data hashed so far
+	std::uint64_t hash_end_ = 0;
+	//! Set by `stop_hashing`, which can be called by other threads: the hash is only dropped by the buffer itself
+	std::atomic<bool> hashing_stopped_{false};
+
+	//! Size of the disk space allocated by `preallocate`
+	std::uint64_t preallocated_ = 0;
+
+	std::uint64_t writeback_interval_ = 0;
+	bool drop_pages_ = false;
+	//! Range of the data written since the last start of writeback
+	std::uint64_t window_begin_ = UINT64_MAX;
+	std::uint64_t window_end_ = 0;
+	//! Range of the data whose writeback was started last
+	std::uint64_t previous_begin_ = 0;
+	std::uint64_t previous_end_ = 0;
+};
+
+//! Write all the data at `offset` of the file, retrying after partial writes and interruptions. Thread-safe.
+bool write_all(int fd, const char* data, std::size_t size, std::uint64_t offset);
+
+//! Copy `size` bytes of the file `in` at `in_offset` to the file `out` at `out_offset`, within the kernel when the file
+//! systems allow it. Return false on failure or if `in` is too short. Thread-safe.
+bool copy_range(int in, std::uint64_t in_offset, int out, std::uint64_t out_offset, std::uint64_t size);
+
+//! Directory containing the file
+std::string parent_directory(const char* filename);
+
+//! Sync the directory containing the file, to make its creation or renaming durable. Return false on failure.
+bool sync_parent_directory(const char* filename);
+
+//! Take an exclusive open file description lock on the whole file, held until it is unlocked or its last descriptor is
+//! closed. Unlike `flock`, the lock can be tested with `file_locked` without being taken. Return false with `errno` set
+//! on failure, `EWOULDBLOCK` if another description holds a lock on the file, even in the same process.
+bool lock_file(int fd);
+
+//! Release the lock taken by `lock_file`
+void unlock_file(int fd);
+
+//! Whether another open file description holds a lock on the file, without taking it
+bool file_locked(int fd);
+
+///
+/// Stream using a FileBuf
+///
+class FileStream : public std::iostream {
+public:
+	//! Take the ownership of the file descriptor, the stream is bad if it is negative
+	FileStream(int fd, std::size_t buffer_size);
+
+	FileBuf& buf() { return buf_; }
+
+private:
+	FileBuf buf_;
+};
+
+}}} // namespace reven::binresource::detail
@@ -0,0 +1,70 @@
+#include "follower.h"
+#include "file_buf.h"
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace reven {
+namespace binresource {
+namespace detail {
+
+Follower::Follower(int fd, const char* path, std::chrono::milliseconds poll_interval)
+	: fd_(fd), poll_interval_(poll_interval) {
+	inotify_fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	// Polling only is still correct, only slower to react
+	if (inotify_fd_ >= 0 && ::inotify_add_watch(inotify_fd_, path, IN_MODIFY | IN_CLOSE_WRITE) < 0) {
+		::close(inotify_fd_);
+		inotify_fd_ = -1;
+	}
+}
+
+Follower::~Follower() {
+	if (inotify_fd_ >= 0) {
+		::close(inotify_fd_);
+	}
+}
+
+bool Follower::wait(std::uint64_t size) {
+	while (true) {
+		if (this->size() > size) {
+			return true;
+		}
+
+		if (!writing()) {
+			// The writer may have flushed its last data just before releasing the lock
+			return this->size() > size;
+		}
+
+		if (inotify_fd_ < 0) {
+			::usleep(static_cast<useconds_t>(poll_interval_.count() * 1000));
+			continue;
+		}
+
+		struct pollfd pfd = {inotify_fd_, POLLIN, 0};
+		if (::poll(&pfd, 1, static_cast<int>(poll_interval_.count())) > 0) {
+			// Drain the events: only the state of the file matters
+			char events[4096];
+			while (::read(inotify_fd_, events, sizeof(events)) > 0) {
+			}
+		}
+	}
+}
+
+std::uint64_t Follower::size() const {
+	struct stat st;
+	if (::fstat(fd_, &st) != 0) {
+		return 0;
+	}
+
+	return st.st_size;
+}
+
+bool Follower::writing() const {
+	// Only test the lock: taking it, even shared and briefly, would make a writer opening the file fail
+	return file_locked(fd_);
+}
+
+}}} // namespace reven::binresource::detail
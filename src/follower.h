@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace reven {
+namespace binresource {
+namespace detail {
+
+///
+/// Wait for a file to grow while its writer holds a lock on it.
+/// The writers created from a filename hold an exclusive lock on their file (see `lock_file`) until they are finalized or destroyed.
+///
+class Follower {
+public:
+	//! `fd` isn't owned. `path` is watched with inotify if possible, and the file is polled every `poll_interval` anyway
+	Follower(int fd, const char* path, std::chrono::milliseconds poll_interval);
+	~Follower();
+
+	Follower(const Follower&) = delete;
+	Follower& operator=(const Follower&) = delete;
+
+	//! Wait until the file is larger than `size` or its writer is done.
+	//! Return false if the file won't grow beyond `size`.
+	bool wait(std::uint64_t size);
+
+	//! Current size of the file
+	std::uint64_t size() const;
+
+	//! Whether a writer still holds the lock of the file
+	bool writing() const;
+
+private:
+	int fd_;
+	//! inotify instance watching the file, or -1 if not available
+	int inotify_fd_ = -1;
+	std::chrono::milliseconds poll_interval_;
+};
+
+}}} // namespace reven::binresource::detail
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "common.h"
+#include "file_buf.h"
+#include "metadata.h"
+
+namespace reven {
+namespace binresource {
+namespace detail {
+
+///
+/// Content of the area of the metadata reserved to the library, since the metadata version 2.
+/// The fields are stored in this order, in native endianness, and the rest of the area is zeroed.
+/// The area belongs to the resource rather than to its metadata: it is zeroed at the creation of a resource, and each
+/// group of fields is updated on its own.
+///
+struct HeaderExtension {
+	//! Offset of the area in the resource
+	static constexpr std::size_t offset =
+		sizeof(magic) + sizeof(metadata_version) + Metadata::serialized_size - metadata_extension_size;
+
+	//! Range of the fields of the commits in the area
+	static constexpr std::size_t commit_offset = 0;
+	static constexpr std::size_t commit_size = 16;
+	//! Range of the fields of the content hash in the area
+	static constexpr std::size_t content_hash_offset = 16;
+	static constexpr std::size_t content_hash_size = 16;
+	//! Range of the fields of the segments in the area
+	static constexpr std::size_t segment_offset = 32;
+	static constexpr std::size_t segment_size = 16;
+	//! Range of the fields of the streams in the area
+	static constexpr std::size_t stream_offset = 48;
+	static constexpr std::size_t stream_size = 8;
+
+	//! Size of the payload made durable by the last commit of the writer, or 0 if the writer never committed
+	std::uint64_t committed_size = 0;
+	//! Checksum of the end of the committed payload, to detect a payload that didn't reach the disk
+	std::uint64_t committed_checksum = 0;
+
+	//! XXH64 of the whole payload, computed while it was written
+	std::uint64_t content_hash = 0;
+	//! False if the payload wasn't written sequentially, or if it was changed after its hash was computed
+	bool has_content_hash = false;
+
+	//! Identifier shared by the segments of a segmented resource, or 0 if the resource isn't a segment
+	std::uint64_t segment_group = 0;
+	//! Index of the segment in the segmented resource
+	std::uint32_t segment_index = 0;
+	//! Number of segments of the segmented resource, or 0 until it is finalized
+	std::uint32_t segment_count = 0;
+
+	//! True if the resource was sent through a stream, where its payload is followed by a StreamTrailer
+	bool stream_trailer = false;
+
+	//! Write the area in a buffer of `metadata_extension_size` bytes
+	void serialize(char* buffer) const {
+		const std::uint64_t flags = has_content_hash ? 1 : 0;
+
+		std::memset(buffer, 0, metadata_extension_size);
+		std::memcpy(buffer, &committed_size, sizeof(committed_size));
+		std::memcpy(buffer + 8, &committed_checksum, sizeof(committed_checksum));
+		std::memcpy(buffer + 16, &content_hash, sizeof(content_hash));
+		std::memcpy(buffer + 24, &flags, sizeof(flags));
+
+		std::memcpy(buffer + 32, &segment_group, sizeof(segment_group));
+		std::memcpy(buffer + 40, &segment_index, sizeof(segment_index));
+		std::memcpy(buffer + 44, &segment_count, sizeof(segment_count));
+
+		const std::uint64_t stream_flags = stream_trailer ? 1 : 0;
+		std::memcpy(buffer + 48, &stream_flags, sizeof(stream_flags));
+	}
+
+	static HeaderExtension deserialize(const char* buffer) {
+		HeaderExtension extension;
+		std::uint64_t flags = 0;
+
+		std::memcpy(&extension.committed_size, buffer, sizeof(extension.committed_size));
+		std::memcpy(&extension.committed_checksum, buffer + 8, sizeof(extension.committed_checksum));
+		std::memcpy(&extension.content_hash, buffer + 16, sizeof(extension.content_hash));
+		std::memcpy(&flags, buffer + 24, sizeof(flags));
+
+		extension.has_content_hash = (flags & 1) != 0;
+
+		std::memcpy(&extension.segment_group, buffer + 32, sizeof(extension.segment_group));
+		std::memcpy(&extension.segment_index, buffer + 40, sizeof(extension.segment_index));
+		std::memcpy(&extension.segment_count, buffer + 44, sizeof(extension.segment_count));
+
+		std::uint64_t stream_flags = 0;
+		std::memcpy(&stream_flags, buffer + 48, sizeof(stream_flags));
+
+		extension.stream_trailer = (stream_flags & 1) != 0;
+		return extension;
+	}
+
+	static HeaderExtension of(const Metadata& md) {
+		return deserialize(md.extension_.data());
+	}
+};
+
+//! Version of the header of the resources that don't use the extension, readable by the versions of the library older
+//! than the extension
+constexpr std::uint32_t metadata_version_without_extension = 1;
+
+//! Whether the header of the version has the extension
+constexpr bool has_extension(std::uint32_t version) {
+	return version >= 2;
+}
+
+//! Size of the header of a resource with the metadata version `version`, 1 or 2
+constexpr std::size_t header_size(std::uint32_t version) {
+	return sizeof(magic) + sizeof(metadata_version) + Metadata::serialized_size -
+	       (has_extension(version) ? 0 : metadata_extension_size);
+}
+
+//! Serialize the header of a new resource with the metadata version `version`, 1 or 2, whose extension is empty.
+//! The buffer must have room for the header of the current version, but only `header_size(version)` bytes are used.
+inline void serialize_header(const Metadata& md, std::uint32_t version, char* header) {
+	std::memcpy(header, &magic, sizeof(magic));
+	std::memcpy(header + sizeof(magic), &version, sizeof(version));
+	md.serialize(header + sizeof(magic) + sizeof(version));
+}
+
+//! Write the content hash in the extension of the header of the resource, or mark it as missing. Return false on
+//! failure.
+inline bool write_content_hash(int fd, bool has_content_hash, std::uint64_t content_hash) {
+	HeaderExtension extension;
+	extension.has_content_hash = has_content_hash;
+	extension.content_hash = content_hash;
+
+	char buffer[metadata_extension_size];
+	extension.serialize(buffer);
+
+	return write_all(fd, buffer + HeaderExtension::content_hash_offset, HeaderExtension::content_hash_size,
+	                 HeaderExtension::offset + HeaderExtension::content_hash_offset);
+}
+
+//! Write the fields of the segments in the extension of the header of the resource. Return false on failure.
+inline bool write_segment(int fd, std::uint64_t segment_group, std::uint32_t segment_index,
+                          std::uint32_t segment_count) {
+	HeaderExtension extension;
+	extension.segment_group = segment_group;
+	extension.segment_index = segment_index;
+	extension.segment_count = segment_count;
+
+	char buffer[metadata_extension_size];
+	extension.serialize(buffer);
+
+	return write_all(fd, buffer + HeaderExtension::segment_offset, HeaderExtension::segment_size,
+	                 HeaderExtension::offset + HeaderExtension::segment_offset);
+}
+
+}}} // namespace reven::binresource::detail
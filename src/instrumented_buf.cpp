@@ -0,0 +1,253 @@
+#include "instrumented_buf.h"
+
+namespace reven {
+namespace binresource {
+namespace detail {
+
+namespace {
+
+TraceEventType trace_event_type(IoOperation op) {
+	switch (op) {
+		case IoOperation::Read:
+			return TraceEventType::Read;
+		case IoOperation::Write:
+			return TraceEventType::Write;
+		case IoOperation::Seek:
+			return TraceEventType::Seek;
+		case IoOperation::Flush:
+			break;
+	}
+
+	return TraceEventType::Flush;
+}
+
+} // anonymous namespace
+
+///
+/// Measure of one operation forwarded to the inner buffer
+///
+class InstrumentedBuf::Measure {
+public:
+	Measure(InstrumentedBuf& buf, IoOperation op, std::ios_base::openmode mode)
+		: buf_(buf), op_(op), event_{trace_event_type(op), buf.path_.c_str(), 0, 0, 0, 0} {
+		if (buf_.tracer_ != nullptr) {
+			const auto pos = buf_.position(mode);
+			event_.offset = pos != unknown_position ? pos : 0;
+		}
+
+		event_.timestamp_ns = now_ns();
+
+		if (buf_.tracer_ != nullptr) {
+			buf_.tracer_->begin(event_);
+		}
+	}
+
+	void done(std::uint64_t bytes) {
+		event_.duration_ns = now_ns() - event_.timestamp_ns;
+		event_.size = bytes;
+
+		if (buf_.stats_ != nullptr) {
+			buf_.stats_->record(op_, bytes, event_.duration_ns);
+		}
+
+		if (buf_.tracer_ != nullptr) {
+			buf_.tracer_->end(event_);
+		}
+	}
+
+private:
+	InstrumentedBuf& buf_;
+	IoOperation op_;
+	TraceEvent event_;
+};
+
+constexpr std::uint64_t InstrumentedBuf::unknown_position;
+
+InstrumentedBuf::InstrumentedBuf(std::streambuf* inner) : inner_(inner) {
+	setg(nullptr, nullptr, nullptr);
+	setp(nullptr, nullptr);
+}
+
+void InstrumentedBuf::record(IoOperation op, std::uint64_t offset, std::uint64_t bytes, std::uint64_t timestamp_ns) {
+	const TraceEvent event{trace_event_type(op), path_.c_str(), offset, bytes, timestamp_ns, now_ns() - timestamp_ns};
+
+	if (stats_ != nullptr) {
+		stats_->record(op, bytes, event.duration_ns);
+	}
+
+	if (tracer_ != nullptr) {
+		tracer_->begin(event);
+		tracer_->end(event);
+	}
+}
+
+std::uint64_t InstrumentedBuf::position(std::ios_base::openmode which) {
+	auto& position = (which & std::ios_base::out) ? put_position_ : get_position_;
+
+	if (position == unknown_position) {
+		const auto pos = inner_->pubseekoff(0, std::ios_base::cur, which);
+		if (pos != pos_type(off_type(-1))) {
+			position = static_cast<std::uint64_t>(pos);
+		}
+	}
+
+	return position;
+}
+
+void InstrumentedBuf::moved(std::ios_base::openmode which, std::uint64_t bytes) {
+	if (which & std::ios_base::out) {
+		if (put_position_ != unknown_position) {
+			put_position_ += bytes;
+		}
+		get_position_ = unknown_position;
+	} else {
+		if (get_position_ != unknown_position) {
+			get_position_ += bytes;
+		}
+		put_position_ = unknown_position;
+	}
+}
+
+void InstrumentedBuf::sought(std::ios_base::openmode which, pos_type result) {
+	const auto position = result != pos_type(off_type(-1)) ? static_cast<std::uint64_t>(result) : unknown_position;
+
+	get_position_ = (which & std::ios_base::in) ? position : unknown_position;
+	put_position_ = (which & std::ios_base::out) ? position : unknown_position;
+}
+
+InstrumentedBuf::int_type InstrumentedBuf::underflow() {
+	Measure measure(*this, IoOperation::Read, std::ios_base::in);
+	const auto result = inner_->sgetc();
+	measure.done(0);
+	return result;
+}
+
+InstrumentedBuf::int_type InstrumentedBuf::uflow() {
+	Measure measure(*this, IoOperation::Read, std::ios_base::in);
+	const auto result = inner_->sbumpc();
+	const std::uint64_t bytes = traits_type::eq_int_type(result, traits_type::eof()) ? 0 : 1;
+	measure.done(bytes);
+	moved(std::ios_base::in, bytes);
+	return result;
+}
+
+std::streamsize InstrumentedBuf::xsgetn(char* s, std::streamsize n) {
+	Measure measure(*this, IoOperation::Read, std::ios_base::in);
+	const auto result = inner_->sgetn(s, n);
+	measure.done(result);
+	moved(std::ios_base::in, result);
+	return result;
+}
+
+std::streamsize InstrumentedBuf::showmanyc() {
+	return inner_->in_avail();
+}
+
+InstrumentedBuf::int_type InstrumentedBuf::pbackfail(int_type c) {
+	get_position_ = unknown_position;
+	put_position_ = unknown_position;
+
+	if (traits_type::eq_int_type(c, traits_type::eof())) {
+		return inner_->sungetc();
+	}
+
+	return inner_->sputbackc(traits_type::to_char_type(c));
+}
+
+InstrumentedBuf::int_type InstrumentedBuf::overflow(int_type c) {
+	if (traits_type::eq_int_type(c, traits_type::eof())) {
+		return traits_type::not_eof(c);
+	}
+
+	Measure measure(*this, IoOperation::Write, std::ios_base::out);
+	const auto result = inner_->sputc(traits_type::to_char_type(c));
+	const std::uint64_t bytes = traits_type::eq_int_type(result, traits_type::eof()) ? 0 : 1;
+	measure.done(bytes);
+	moved(std::ios_base::out, bytes);
+	return result;
+}
+
+std::streamsize InstrumentedBuf::xsputn(const char* s, std::streamsize n) {
+	Measure measure(*this, IoOperation::Write, std::ios_base::out);
+	const auto result = inner_->sputn(s, n);
+	measure.done(result);
+	moved(std::ios_base::out, result);
+	return result;
+}
+
+InstrumentedBuf::pos_type InstrumentedBuf::seekoff(off_type off, std::ios_base::seekdir dir,
+                                                   std::ios_base::openmode which) {
+	// Position queries (tellg/tellp) aren't seeks
+	if (off == 0 && dir == std::ios_base::cur) {
+		return inner_->pubseekoff(off, dir, which);
+	}
+
+	Measure measure(*this, IoOperation::Seek, which);
+	const auto result = inner_->pubseekoff(off, dir, which);
+	measure.done(0);
+	sought(which, result);
+	return result;
+}
+
+InstrumentedBuf::pos_type InstrumentedBuf::seekpos(pos_type pos, std::ios_base::openmode which) {
+	Measure measure(*this, IoOperation::Seek, which);
+	const auto result = inner_->pubseekpos(pos, which);
+	measure.done(0);
+	sought(which, result);
+	return result;
+}
+
+int InstrumentedBuf::sync() {
+	Measure measure(*this, IoOperation::Flush, std::ios_base::out);
+	const auto result = inner_->pubsync();
+	measure.done(0);
+	return result;
+}
+
+InstrumentedBuf& instrumentation(std::ios& stream, std::shared_ptr<InstrumentedBuf>& instrumented) {
+	if (instrumented == nullptr) {
+		// Changing the buffer of a stream resets its state
+		const auto state = stream.rdstate();
+
+		instrumented = std::make_shared<InstrumentedBuf>(stream.rdbuf());
+		stream.rdbuf(instrumented.get());
+
+		stream.clear(state);
+	}
+
+	return *instrumented;
+}
+
+void uninstrument(std::ios& stream, std::shared_ptr<InstrumentedBuf>& instrumented) {
+	if (instrumented == nullptr) {
+		return;
+	}
+
+	const auto state = stream.rdstate();
+
+	stream.rdbuf(instrumented->inner());
+	instrumented.reset();
+
+	stream.clear(state);
+}
+
+void instrument(std::ios& stream, std::shared_ptr<InstrumentedBuf>& instrumented, std::shared_ptr<IoStats> stats) {
+	if (stats != nullptr) {
+		instrumentation(stream, instrumented).set_stats(std::move(stats));
+	} else if (instrumented != nullptr) {
+		instrumented->set_stats(nullptr);
+
+		if (!instrumented->active()) {
+			uninstrument(stream, instrumented);
+		}
+	}
+}
+
+void trace(std::ios& stream, std::shared_ptr<InstrumentedBuf>& instrumented, std::shared_ptr<Tracer> tracer,
+           const char* path) {
+	if (tracer != nullptr) {
+		instrumentation(stream, instrumented).set_tracer(std::move(tracer), path);
+	}
+}
+
+}}} // namespace reven::binresource::detail
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <chrono>
+#include <ios>
+#include <memory>
+#include <streambuf>
+#include <string>
+
+#include "io_stats.h"
+#include "tracing.h"
+
+namespace reven {
+namespace binresource {
+namespace detail {
+
+//! Current time in nanoseconds on the steady clock
+inline std::uint64_t now_ns() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()
+	).count();
+}
+
+///
+/// Report an event to a tracer for the lifetime of the scope. Does nothing if the tracer is nullptr.
+///
+class TraceScope {
+public:
+	TraceScope(std::shared_ptr<Tracer> tracer, TraceEventType type, const char* path, std::uint64_t offset = 0)
+		: tracer_(std::move(tracer)), event_{type, path, offset, 0, 0, 0} {
+		if (tracer_ != nullptr) {
+			event_.timestamp_ns = now_ns();
+			tracer_->begin(event_);
+		}
+	}
+
+	~TraceScope() {
+		if (tracer_ != nullptr) {
+			event_.duration_ns = now_ns() - event_.timestamp_ns;
+			tracer_->end(event_);
+		}
+	}
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+	void set_size(std::uint64_t size) { event_.size = size; }
+
+private:
+	std::shared_ptr<Tracer> tracer_;
+	TraceEvent event_;
+};
+
+///
+/// Unbuffered streambuf forwarding all the operations to another streambuf, recording them in an IoStats and
+/// reporting them to a Tracer when set.
+///
+class InstrumentedBuf : public std::streambuf {
+public:
+	//! `inner` isn't owned and must outlive this buffer
+	explicit InstrumentedBuf(std::streambuf* inner);
+
+	std::streambuf* inner() const { return inner_; }
+
+	const std::shared_ptr<IoStats>& stats() const { return stats_; }
+	void set_stats(std::shared_ptr<IoStats> stats) { stats_ = std::move(stats); }
+
+	const std::shared_ptr<Tracer>& tracer() const { return tracer_; }
+	void set_tracer(std::shared_ptr<Tracer> tracer, std::string path) {
+		tracer_ = std::move(tracer);
+		path_ = std::move(path);
+	}
+
+	//! Whether there is still something to record
+	bool active() const { return stats_ != nullptr || tracer_ != nullptr; }
+
+	//! Record an operation done on the file without going through the buffer. `timestamp_ns` is its start.
+	void record(IoOperation op, std::uint64_t offset, std::uint64_t bytes, std::uint64_t timestamp_ns);
+
+	//! Update the tracked positions after `bytes` were read or written, through this buffer or directly on the file
+	void moved(std::ios_base::openmode which, std::uint64_t bytes);
+
+protected:
+	int_type underflow() override;
+	int_type uflow() override;
+	std::streamsize xsgetn(char* s, std::streamsize n) override;
+	std::streamsize showmanyc() override;
+	int_type pbackfail(int_type c) override;
+	int_type overflow(int_type c) override;
+	std::streamsize xsputn(const char* s, std::streamsize n) override;
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+	int sync() override;
+
+private:
+	class Measure;
+
+	//! Value of the positions before they are queried, or after an operation moving them unpredictably
+	static constexpr std::uint64_t unknown_position = UINT64_MAX;
+
+	//! Position of the inner buffer, only queried if unknown
+	std::uint64_t position(std::ios_base::openmode which);
+	//! Update the positions after a seek returning `result`
+	void sought(std::ios_base::openmode which, pos_type result);
+
+	std::streambuf* inner_;
+	//! Positions tracked by the buffer itself, so that tracing doesn't seek the inner buffer for every operation.
+	//! Some buffers share a single position for reading and writing, so moving one invalidates the other.
+	std::uint64_t get_position_ = unknown_position;
+	std::uint64_t put_position_ = unknown_position;
+	std::shared_ptr<IoStats> stats_;
+	std::shared_ptr<Tracer> tracer_;
+	std::string path_;
+};
+
+//! Return the instrumentation buffer of the stream, installing it if needed.
+//! `instrumented` is the buffer currently installed, if any.
+InstrumentedBuf& instrumentation(std::ios& stream, std::shared_ptr<InstrumentedBuf>& instrumented);
+
+//! Give the stream its original buffer back
+void uninstrument(std::ios& stream, std::shared_ptr<InstrumentedBuf>& instrumented);
+
+//! Set the statistics of the instrumentation of the stream, installing or removing the instrumentation as needed
+void instrument(std::ios& stream, std::shared_ptr<InstrumentedBuf>& instrumented, std::shared_ptr<IoStats> stats);
+
+//! Report the I/O on the stream to the tracer, if not nullptr
+void trace(std::ios& stream, std::shared_ptr<InstrumentedBuf>& instrumented, std::shared_ptr<Tracer> tracer,
+           const char* path);
+
+}}} // namespace reven::binresource::detail
@@ -0,0 +1,120 @@
+#include "io_stats.h"
+
+#include <iomanip>
+
+namespace reven {
+namespace binresource {
+
+const char* io_operation_name(IoOperation op) {
+	switch (op) {
+		case IoOperation::Read:
+			return "read";
+		case IoOperation::Write:
+			return "write";
+		case IoOperation::Seek:
+			return "seek";
+		case IoOperation::Flush:
+			return "flush";
+	}
+
+	return "unknown";
+}
+
+void LatencyHistogram::record(std::uint64_t ns) {
+	std::size_t i = 0;
+	while (ns > 1) {
+		ns >>= 1;
+		++i;
+	}
+
+	buckets_[i].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::reset() {
+	for (auto& bucket : buckets_) {
+		bucket.store(0, std::memory_order_relaxed);
+	}
+}
+
+std::uint64_t LatencyHistogram::count() const {
+	std::uint64_t total = 0;
+	for (const auto& bucket : buckets_) {
+		total += bucket.load(std::memory_order_relaxed);
+	}
+	return total;
+}
+
+std::uint64_t LatencyHistogram::percentile(double p) const {
+	const std::uint64_t total = count();
+	if (total == 0) {
+		return 0;
+	}
+
+	const auto rank = static_cast<std::uint64_t>(total * p / 100.);
+
+	std::uint64_t seen = 0;
+	for (std::size_t i = 0; i < bucket_count; ++i) {
+		seen += bucket(i);
+		if (seen > rank || seen == total) {
+			return i + 1 < bucket_count ? (std::uint64_t(1) << (i + 1)) : UINT64_MAX;
+		}
+	}
+
+	return UINT64_MAX;
+}
+
+void IoStats::record(IoOperation op, std::uint64_t bytes, std::uint64_t ns) {
+	auto& c = counters_[static_cast<std::size_t>(op)];
+
+	c.calls.fetch_add(1, std::memory_order_relaxed);
+	c.bytes.fetch_add(bytes, std::memory_order_relaxed);
+	c.time_ns.fetch_add(ns, std::memory_order_relaxed);
+	c.latency.record(ns);
+}
+
+void IoStats::reset() {
+	for (auto& c : counters_) {
+		c.calls.store(0, std::memory_order_relaxed);
+		c.bytes.store(0, std::memory_order_relaxed);
+		c.time_ns.store(0, std::memory_order_relaxed);
+		c.latency.reset();
+	}
+}
+
+void IoStats::dump(std::ostream& out) const {
+	for (std::size_t i = 0; i < io_operation_count; ++i) {
+		const auto op = static_cast<IoOperation>(i);
+		const auto& c = counters(op);
+		const auto op_calls = calls(op);
+
+		out << std::left << std::setw(6) << io_operation_name(op) << std::right
+		    << " calls: " << op_calls
+		    << " bytes: " << bytes(op)
+		    << " time: " << time_ns(op) << "ns";
+
+		if (op_calls > 0) {
+			out << " mean: " << time_ns(op) / op_calls << "ns"
+			    << " p50: <" << c.latency.percentile(50) << "ns"
+			    << " p99: <" << c.latency.percentile(99) << "ns";
+		}
+
+		out << "\n";
+
+		for (std::size_t b = 0; b < LatencyHistogram::bucket_count; ++b) {
+			const auto count = c.latency.bucket(b);
+			if (count > 0) {
+				out << "    [" << (b == 0 ? 0 : std::uint64_t(1) << b) << "ns, ";
+
+				if (b + 1 < LatencyHistogram::bucket_count) {
+					out << (std::uint64_t(1) << (b + 1)) << "ns): ";
+				} else {
+					out << "inf): ";
+				}
+
+				out << count << "\n";
+			}
+		}
+	}
+}
+
+}} // namespace reven::binresource
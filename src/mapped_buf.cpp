@@ -0,0 +1,202 @@
+#include "mapped_buf.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace reven {
+namespace binresource {
+namespace detail {
+
+MappedBuf::MappedBuf(int fd, std::size_t growth) : fd_(fd), growth_(std::max<std::size_t>(growth, 1)) {
+	setp(nullptr, nullptr);
+}
+
+MappedBuf::~MappedBuf() {
+	if (fd_ < 0) {
+		return;
+	}
+
+	trim();
+
+	if (map_ != nullptr) {
+		::munmap(map_, map_size_);
+	}
+
+	::close(fd_);
+}
+
+char* MappedBuf::map(std::size_t size) {
+	const auto pos = position();
+
+	if (!reserve(pos + size)) {
+		return nullptr;
+	}
+
+	char* data = pptr();
+	set_position(pos + size, file_size_);
+	return data;
+}
+
+MappedBuf::int_type MappedBuf::overflow(int_type c) {
+	if (traits_type::eq_int_type(c, traits_type::eof())) {
+		return traits_type::not_eof(c);
+	}
+
+	if (!reserve(position() + 1)) {
+		return traits_type::eof();
+	}
+
+	*pptr() = traits_type::to_char_type(c);
+	pbump(1);
+
+	return c;
+}
+
+std::streamsize MappedBuf::xsputn(const char* s, std::streamsize n) {
+	if (n <= 0) {
+		return 0;
+	}
+
+	const auto pos = position();
+
+	if (!reserve(pos + n)) {
+		return 0;
+	}
+
+	std::memcpy(pptr(), s, n);
+	set_position(pos + n, file_size_);
+
+	return n;
+}
+
+MappedBuf::pos_type MappedBuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) {
+	if (fd_ < 0 || !(which & std::ios_base::out)) {
+		return pos_type(off_type(-1));
+	}
+
+	const auto pos = position();
+	high_ = std::max(high_, pos);
+
+	off_type base = 0;
+	if (dir == std::ios_base::cur) {
+		base = pos;
+	} else if (dir == std::ios_base::end) {
+		base = high_;
+	}
+
+	if (base + off < 0) {
+		return pos_type(off_type(-1));
+	}
+
+	const std::uint64_t new_pos = base + off;
+
+	if (new_pos > file_size_ && !reserve(new_pos)) {
+		return pos_type(off_type(-1));
+	}
+
+	set_position(new_pos, file_size_);
+
+	return pos_type(off_type(new_pos));
+}
+
+MappedBuf::pos_type MappedBuf::seekpos(pos_type pos, std::ios_base::openmode which) {
+	return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+int MappedBuf::sync() {
+	return trim() ? 0 : -1;
+}
+
+std::uint64_t MappedBuf::position() const {
+	return pptr() - pbase();
+}
+
+void MappedBuf::set_position(std::uint64_t pos, std::uint64_t end) {
+	setp(map_, map_ + end);
+
+	// pbump only takes an int
+	while (pos > 0) {
+		const auto step = std::min<std::uint64_t>(pos, INT_MAX);
+		pbump(static_cast<int>(step));
+		pos -= step;
+	}
+}
+
+bool MappedBuf::reserve(std::uint64_t size) {
+	if (size <= file_size_) {
+		return true;
+	}
+
+	if (fd_ < 0) {
+		return false;
+	}
+
+	const auto pos = position();
+	high_ = std::max(high_, pos);
+
+	std::uint64_t new_size = std::max<std::uint64_t>(size, file_size_ + growth_);
+	new_size = (new_size + growth_ - 1) / growth_ * growth_;
+
+	if (::fallocate(fd_, 0, 0, new_size) != 0) {
+		if ((errno != EOPNOTSUPP && errno != ENOSYS) || ::ftruncate(fd_, new_size) != 0) {
+			return false;
+		}
+	}
+
+	if (new_size > map_size_) {
+		void* map = nullptr;
+		if (map_ == nullptr) {
+			map = ::mmap(nullptr, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+		} else {
+			map = ::mremap(map_, map_size_, new_size, MREMAP_MAYMOVE);
+		}
+
+		if (map == MAP_FAILED) {
+			return false;
+		}
+
+		map_ = static_cast<char*>(map);
+		map_size_ = new_size;
+	}
+
+	file_size_ = new_size;
+	set_position(pos, file_size_);
+
+	return true;
+}
+
+bool MappedBuf::trim() {
+	if (fd_ < 0) {
+		return false;
+	}
+
+	const auto pos = position();
+	high_ = std::max(high_, pos);
+
+	if (file_size_ != high_) {
+		if (::ftruncate(fd_, high_) != 0) {
+			return false;
+		}
+
+		// Keep the put area inside the file so that writing in the mapping can't fault
+		file_size_ = high_;
+		set_position(pos, file_size_);
+	}
+
+	return true;
+}
+
+MappedStream::MappedStream(const char* filename, std::size_t growth)
+	: std::ostream(nullptr), buf_(::open(filename, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666), growth) {
+	if (buf_.is_open()) {
+		rdbuf(&buf_);
+	}
+}
+
+}}} // namespace reven::binresource::detail
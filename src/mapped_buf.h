@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <streambuf>
+
+namespace reven {
+namespace binresource {
+namespace detail {
+
+///
+/// Output streambuf writing directly in a memory mapping of a file.
+/// The file is preallocated and the mapping is grown by large increments when needed. The file is truncated to the
+/// highest written position when the buffer is synchronized and when it is destroyed.
+///
+class MappedBuf : public std::streambuf {
+public:
+	//! Take the ownership of the file descriptor
+	MappedBuf(int fd, std::size_t growth);
+	~MappedBuf() override;
+
+	MappedBuf(const MappedBuf&) = delete;
+	MappedBuf& operator=(const MappedBuf&) = delete;
+
+	bool is_open() const { return fd_ >= 0; }
+	int fd() const { return fd_; }
+
+	//! Return a pointer to the next `size` bytes at the current position and move the position after them.
+	//! The pointer is valid until the mapping is grown again. Return nullptr on error.
+	char* map(std::size_t size);
+
+protected:
+	int_type overflow(int_type c) override;
+	std::streamsize xsputn(const char* s, std::streamsize n) override;
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+	int sync() override;
+
+private:
+	std::uint64_t position() const;
+	void set_position(std::uint64_t pos, std::uint64_t end);
+	bool reserve(std::uint64_t size);
+	bool trim();
+
+private:
+	int fd_;
+	std::size_t growth_;
+
+	char* map_ = nullptr;
+	std::uint64_t map_size_ = 0;
+	//! Size of the file, the put area never goes beyond it
+	std::uint64_t file_size_ = 0;
+	//! Highest position written, excluding the current put area
+	std::uint64_t high_ = 0;
+};
+
+///
+/// Output stream using a MappedBuf
+///
+class MappedStream : public std::ostream {
+public:
+	MappedStream(const char* filename, std::size_t growth);
+
+	MappedBuf& buf() { return buf_; }
+
+private:
+	MappedBuf buf_;
+};
+
+}}} // namespace reven::binresource::detail
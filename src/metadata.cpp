@@ -1,57 +1,70 @@
 #include "metadata.h"
+#include "common.h"
 
+#include <cstring>
 #include <istream>
 #include <ostream>
 
 namespace reven {
 namespace binresource {
 
-void Metadata::serialize(std::ostream& out) const {
-	const char padding[std::max(std::max(std::max(format_version_max_size, tool_name_max_size), tool_version_max_size), tool_info_max_size)] = {'\0'};
-
-	try {
-		out.write(reinterpret_cast<const char*>(&type_), sizeof(type_));
+constexpr std::size_t Metadata::serialized_size;
 
-		const std::size_t format_version_size = format_version_.size();
-		out.write(reinterpret_cast<const char*>(&format_version_size), sizeof(format_version_size));
+namespace {
 
-		out.write(format_version_.c_str(), format_version_size);
+char* serialize_value(char* buffer, const void* value, std::size_t size) {
+	std::memcpy(buffer, value, size);
+	return buffer + size;
+}
 
-		if (format_version_size < format_version_max_size) {
-			out.write(padding, format_version_max_size - format_version_size);
-		}
+char* serialize_string(char* buffer, const std::string& str, std::size_t max_size) {
+	const std::size_t size = str.size();
+	buffer = serialize_value(buffer, &size, sizeof(size));
 
-		const std::size_t tool_name_size = tool_name().size();
-		out.write(reinterpret_cast<const char*>(&tool_name_size), sizeof(tool_name_size));
+	std::memcpy(buffer, str.data(), size);
+	std::memset(buffer + size, '\0', max_size - size);
 
-		out.write(tool_name_.c_str(), tool_name_size);
+	return buffer + max_size;
+}
 
-		if (tool_name_size < tool_name_max_size) {
-			out.write(padding, tool_name_max_size - tool_name_size);
-		}
+} // anonymous namespace
 
-		const std::size_t tool_version_size = tool_version_.size();
-		out.write(reinterpret_cast<const char*>(&tool_version_size), sizeof(tool_version_size));
+void Metadata::serialize(char* buffer) const {
+	buffer = serialize_value(buffer, &type_, sizeof(type_));
+	buffer = serialize_string(buffer, format_version_, format_version_max_size);
+	buffer = serialize_string(buffer, tool_name_, tool_name_max_size);
+	buffer = serialize_string(buffer, tool_version_, tool_version_max_size);
+	buffer = serialize_string(buffer, tool_info_, tool_info_max_size);
+	buffer = serialize_value(buffer, &generation_date_, sizeof(generation_date_));
 
-		out.write(tool_version_.c_str(), tool_version_size);
+	// The extension holds the state of the resource the metadata was read from, which is rewritten by the library
+	std::memset(buffer, '\0', metadata_extension_size);
+}
 
-		if (tool_version_size < tool_version_max_size) {
-			out.write(padding, tool_version_max_size - tool_version_size);
-		}
+void Metadata::serialize(std::ostream& out) const {
+	serialize(metadata_version, out);
+}
 
-		const std::size_t tool_info_size = tool_info_.size();
-		out.write(reinterpret_cast<const char*>(&tool_info_size), sizeof(tool_info_size));
+void Metadata::serialize(std::uint32_t metadata_version, std::ostream& out) const {
+	if (metadata_version < 1 || metadata_version > binresource::metadata_version) {
+		throw WriteMetadataError("Unsupported metadata version");
+	}
 
-		out.write(tool_info_.c_str(), tool_info_size);
+	char buffer[serialized_size];
+	serialize(buffer);
 
-		if (tool_info_size < tool_info_max_size) {
-			out.write(padding, tool_info_max_size - tool_info_size);
-		}
+	// The extension only exists since the version 2
+	const std::size_t size = metadata_version >= 2 ? serialized_size : serialized_size - metadata_extension_size;
 
-		out.write(reinterpret_cast<const char*>(&generation_date_), sizeof(generation_date_));
+	try {
+		out.write(buffer, size);
 	} catch(const std::ios_base::failure& e) {
 		throw WriteMetadataError((std::string("IO error: ") + e.what()).c_str());
 	}
+
+	if (!out) {
+		throw WriteMetadataError("Can't write the metadata");
+	}
 }
 
 Metadata Metadata::deserialize(std::uint32_t metadata_version, std::istream& in) {
@@ -183,6 +196,14 @@ Metadata Metadata::deserialize(std::uint32_t metadata_version, std::istream& in)
 		if (in.gcount() != sizeof(md.generation_date_)) {
 			throw ReadMetadataError("Can't read enough data for the generation date");
 		}
+
+		if (metadata_version >= 2) {
+			in.read(md.extension_.data(), md.extension_.size());
+
+			if (in.gcount() != static_cast<std::streamsize>(md.extension_.size())) {
+				throw ReadMetadataError("Can't read enough data for the extension");
+			}
+		}
 	} catch(const std::ios_base::failure& e) {
 		throw ReadMetadataError((std::string("IO error: ") + e.what()).c_str());
 	}
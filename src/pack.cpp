@@ -0,0 +1,625 @@
+#include "pack.h"
+#include "common.h"
+#include "file_buf.h"
+#include "pack_format.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <set>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace reven {
+namespace binresource {
+
+namespace {
+
+//! Size of the file, or -1 on failure
+std::int64_t file_size(int fd) {
+	struct stat st;
+	if (::fstat(fd, &st) != 0) {
+		return -1;
+	}
+
+	return st.st_size;
+}
+
+//! Compare two names like std::string does
+int compare(const char* a, std::size_t a_size, const char* b, std::size_t b_size) {
+	const int result = std::memcmp(a, b, std::min(a_size, b_size));
+
+	if (result != 0) {
+		return result;
+	}
+
+	return a_size < b_size ? -1 : (a_size > b_size ? 1 : 0);
+}
+
+//! Lock the pack like a resource written from a filename, so that the concurrent updates of the pack fail instead of
+//! interleaving their members and directories
+void lock_pack(int fd) {
+	if (!detail::lock_file(fd)) {
+		throw WriterError(errno == EWOULDBLOCK ? "The pack is already being written" : "Can't lock the pack");
+	}
+}
+
+} // anonymous namespace
+
+struct PackReader::State {
+	int fd = -1;
+	std::size_t buffer_size;
+
+	void* mapping = MAP_FAILED;
+	std::size_t mapping_size = 0;
+
+	//! Beginning of the directory, in the mapping
+	const char* directory = nullptr;
+	const detail::PackEntry* entries = nullptr;
+	std::size_t count = 0;
+
+	std::uint64_t dead_size = 0;
+
+	~State() {
+		unmap();
+
+		if (fd >= 0) {
+			::close(fd);
+		}
+	}
+
+	void unmap() {
+		if (mapping != MAP_FAILED) {
+			::munmap(mapping, mapping_size);
+			mapping = MAP_FAILED;
+		}
+	}
+
+	//! Load the directory whose trailer ends at `end`. Return false if there is no valid directory there.
+	bool load_directory(std::uint64_t end) {
+		detail::PackTrailer trailer;
+
+		if (end < detail::pack_header_size + sizeof(trailer) ||
+		    ::pread(fd, &trailer, sizeof(trailer), end - sizeof(trailer)) != sizeof(trailer)) {
+			return false;
+		}
+
+		// A pack that wasn't finalized has no trailer
+		const std::uint64_t directory_end = end - sizeof(trailer);
+		if (trailer.magic != pack_magic || trailer.directory_offset % 8 != 0 ||
+		    trailer.directory_offset < detail::pack_header_size || trailer.directory_offset > directory_end ||
+		    trailer.entry_count > (directory_end - trailer.directory_offset) / sizeof(detail::PackEntry)) {
+			return false;
+		}
+
+		const auto page = static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+		const auto mapping_offset = trailer.directory_offset / page * page;
+
+		mapping_size = end - mapping_offset;
+		mapping = ::mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, mapping_offset);
+
+		if (mapping == MAP_FAILED) {
+			throw ReaderError("Can't map the directory of the pack");
+		}
+
+		directory = static_cast<const char*>(mapping) + (trailer.directory_offset - mapping_offset);
+		entries = reinterpret_cast<const detail::PackEntry*>(directory);
+		count = trailer.entry_count;
+
+		// Check the bounds once, so that the accesses don't have to. The names follow the entries up to the trailer,
+		// which rules out the bytes of a member that happen to look like a trailer.
+		const auto directory_size = directory_end - trailer.directory_offset;
+		std::uint64_t names_size = 0;
+		std::uint64_t members_size = 0;
+
+		for (std::size_t i = 0; i < count; ++i) {
+			const auto& entry = entries[i];
+
+			if (entry.name_offset != count * sizeof(detail::PackEntry) + names_size ||
+			    entry.name_size > directory_size - entry.name_offset || entry.offset > trailer.directory_offset ||
+			    entry.size > trailer.directory_offset - entry.offset) {
+				unmap();
+				return false;
+			}
+
+			names_size += entry.name_size;
+			members_size += entry.size;
+		}
+
+		if (count * sizeof(detail::PackEntry) + names_size != directory_size) {
+			unmap();
+			return false;
+		}
+
+		dead_size = trailer.directory_offset - detail::pack_header_size - std::min(members_size,
+		            trailer.directory_offset - detail::pack_header_size);
+
+		return true;
+	}
+
+	//! Load the last valid directory whose trailer ends before `end`, the end of the file. Return false if there is
+	//! none.
+	bool load_previous_directory(std::uint64_t end) {
+		constexpr std::size_t chunk_size = 64 * 1024;
+		constexpr std::size_t magic_offset = offsetof(detail::PackTrailer, magic);
+		std::vector<char> chunk(chunk_size);
+		const auto file_end = end;
+
+		// The chunks are read backward, overlapping by the size of the magic so that none is split
+		while (end >= detail::pack_header_size + sizeof(detail::PackTrailer)) {
+			const auto begin = std::max<std::uint64_t>(end > chunk_size ? end - chunk_size : 0, detail::pack_header_size);
+			const auto size = static_cast<std::size_t>(end - begin);
+
+			if (::pread(fd, chunk.data(), size, begin) != static_cast<ssize_t>(size)) {
+				return false;
+			}
+
+			for (std::size_t i = size - std::min(size, sizeof(pack_magic)) + 1; i-- > 0;) {
+				const auto trailer_end = begin + i - magic_offset + sizeof(detail::PackTrailer);
+
+				// The trailer at the end was already tried
+				if (trailer_end != file_end && std::memcmp(chunk.data() + i, &pack_magic, sizeof(pack_magic)) == 0 &&
+				    load_directory(trailer_end)) {
+					return true;
+				}
+			}
+
+			end = begin + sizeof(pack_magic) - 1;
+		}
+
+		return false;
+	}
+};
+
+struct PackWriter::State {
+	int fd = -1;
+	std::size_t buffer_size;
+	Durability durability;
+
+	struct Member {
+		std::string name;
+		std::uint64_t offset;
+		std::uint64_t size;
+	};
+
+	std::vector<Member> members;
+	std::set<std::string> names;
+	//! True while the last member is written by a Writer
+	bool member_open = false;
+	//! Expires once the Writer of the last member is finalized or destroyed
+	std::weak_ptr<void> member_writer;
+
+	~State() {
+		if (fd >= 0) {
+			::close(fd);
+		}
+	}
+};
+
+PackWriter::PackWriter(std::unique_ptr<State>&& state) : state_(std::move(state)) {}
+
+PackWriter::PackWriter(PackWriter&&) = default;
+PackWriter& PackWriter::operator=(PackWriter&&) = default;
+PackWriter::~PackWriter() = default;
+
+PackWriter PackWriter::create(const char* filename, const WriterOptions& options) {
+	auto state = std::make_unique<State>();
+	state->buffer_size = options.buffer_size;
+	state->durability = options.durability;
+
+	state->fd = ::open(filename, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+	if (state->fd < 0) {
+		throw WriterError("Bad stream");
+	}
+
+	// Truncated once locked, so that a pack being updated is left untouched
+	lock_pack(state->fd);
+
+	if (::ftruncate(state->fd, 0) != 0) {
+		throw WriterError("Can't truncate the pack");
+	}
+
+	char header[detail::pack_header_size] = {};
+	std::memcpy(header, &pack_magic, sizeof(pack_magic));
+	std::memcpy(header + sizeof(pack_magic), &pack_version, sizeof(pack_version));
+
+	if (!detail::write_all(state->fd, header, sizeof(header), 0)) {
+		throw WriterError("Can't write the header of the pack");
+	}
+
+	return PackWriter(std::move(state));
+}
+
+PackWriter PackWriter::open(const char* filename, const WriterOptions& options) {
+	auto state = std::make_unique<State>();
+	state->buffer_size = options.buffer_size;
+	state->durability = options.durability;
+
+	// The new members are appended after the current directory, which stays valid until the new one is written
+	state->fd = ::open(filename, O_RDWR | O_CLOEXEC);
+	if (state->fd < 0) {
+		throw WriterError("Bad stream");
+	}
+
+	// Before reading the directory, so that it can't be replaced by another update meanwhile
+	lock_pack(state->fd);
+
+	std::unique_ptr<PackReader> reader;
+
+	try {
+		reader = std::make_unique<PackReader>(PackReader::open(filename));
+	} catch (const ReaderError& e) {
+		throw WriterError((std::string("While reading the pack: ") + e.what()).c_str());
+	}
+
+	for (std::size_t i = 0; i < reader->member_count(); ++i) {
+		state->members.push_back(State::Member{reader->name(i), reader->state_->entries[i].offset,
+		                                       reader->state_->entries[i].size});
+		state->names.insert(state->members.back().name);
+	}
+
+	return PackWriter(std::move(state));
+}
+
+void PackWriter::compact(const char* filename) {
+	// Locked like for any update of the pack, until the new pack replaces it
+	const auto previous = PackWriter::open(filename);
+
+	// Copy the members in the order of the previous pack, so that the previous pack is read sequentially
+	auto members = previous.state_->members;
+	std::sort(members.begin(), members.end(),
+	          [](const State::Member& a, const State::Member& b) { return a.offset < b.offset; });
+
+	const auto path = std::string(filename) + ".compact." + std::to_string(::getpid());
+
+	WriterOptions options;
+	options.durability = Durability::AtEnd;
+	auto pack = PackWriter::create(path.c_str(), options);
+
+	try {
+		for (const auto& member : members) {
+			const auto offset = pack.open_member(member.name.c_str(), false);
+
+			if (!detail::copy_range(previous.state_->fd, member.offset, pack.state_->fd, offset, member.size)) {
+				throw WriterError("Can't copy the member");
+			}
+
+			pack.close_member();
+			pack.keep_member();
+		}
+
+		std::move(pack).finalize();
+	} catch (const WriterError&) {
+		::unlink(path.c_str());
+		throw;
+	}
+
+	if (::rename(path.c_str(), filename) != 0) {
+		::unlink(path.c_str());
+		throw WriterError("Can't replace the pack");
+	}
+
+	// Like the publication of a resource written atomically, the rename is only durable once the directory is synced
+	if (!detail::sync_parent_directory(filename)) {
+		throw WriterError("Can't sync the directory of the pack");
+	}
+}
+
+std::size_t PackWriter::member_count() const {
+	return state_->members.size();
+}
+
+void PackWriter::close_member() {
+	if (!state_->member_open) {
+		return;
+	}
+
+	// Its size isn't known yet, and the next member would be written in the middle of it
+	if (!state_->member_writer.expired()) {
+		throw WriterError("The previous member is still being written");
+	}
+
+	state_->member_open = false;
+
+	const auto size = file_size(state_->fd);
+	if (size < 0) {
+		throw WriterError("Can't get the size of the member");
+	}
+
+	auto& member = state_->members.back();
+	member.size = size - member.offset;
+}
+
+void PackWriter::check_name(const char* name, bool replace) const {
+	if (!replace && state_->names.count(name) != 0) {
+		throw WriterError("A member with the same name is already in the pack");
+	}
+}
+
+std::uint64_t PackWriter::open_member(const char* name, bool replace) {
+	close_member();
+	check_name(name, replace);
+
+	const auto offset = file_size(state_->fd);
+	if (offset < 0) {
+		throw WriterError("Can't get the size of the pack");
+	}
+
+	state_->members.push_back(State::Member{name, static_cast<std::uint64_t>(offset), 0});
+	state_->member_open = true;
+
+	return offset;
+}
+
+void PackWriter::keep_member() {
+	auto& members = state_->members;
+	const auto name = members.back().name;
+
+	if (!state_->names.insert(name).second) {
+		const auto previous = std::find_if(members.begin(), members.end() - 1,
+		                                   [&name](const State::Member& member) { return member.name == name; });
+		members.erase(previous);
+	}
+}
+
+void PackWriter::abandon_member() {
+	const auto offset = state_->members.back().offset;
+
+	state_->members.pop_back();
+	state_->member_open = false;
+
+	if (::ftruncate(state_->fd, offset) != 0) {
+		throw WriterError("Can't remove the failed member");
+	}
+}
+
+Writer PackWriter::add(const char* name, const Metadata& md) {
+	return add_writer(name, md, false);
+}
+
+void PackWriter::add(const char* name, const char* filename) {
+	add_file(name, filename, false);
+}
+
+Writer PackWriter::replace(const char* name, const Metadata& md) {
+	return add_writer(name, md, true);
+}
+
+void PackWriter::replace(const char* name, const char* filename) {
+	add_file(name, filename, true);
+}
+
+void PackWriter::remove(const char* name) {
+	close_member();
+
+	if (state_->names.erase(name) == 0) {
+		throw WriterError("No such member in the pack");
+	}
+
+	auto& members = state_->members;
+	members.erase(std::find_if(members.begin(), members.end(),
+	                           [name](const State::Member& member) { return member.name == name; }));
+}
+
+Writer PackWriter::add_writer(const char* name, const Metadata& md, bool replace) {
+	const auto offset = open_member(name, replace);
+
+	// The member is written through its own descriptor, in the range of the pack starting at its offset
+	auto stream = std::make_unique<detail::FileStream>(::fcntl(state_->fd, F_DUPFD_CLOEXEC, 0), state_->buffer_size);
+	stream->buf().slice(offset, UINT64_MAX);
+
+	try {
+		auto writer = Writer::create(std::move(stream), md);
+		keep_member();
+
+		writer.pack_member_ = std::make_shared<bool>(true);
+		state_->member_writer = writer.pack_member_;
+
+		return writer;
+	} catch (const WriterError&) {
+		abandon_member();
+		throw;
+	}
+}
+
+void PackWriter::add_file(const char* name, const char* filename, bool replace) {
+	try {
+		Reader::open(filename);
+	} catch (const ReaderError& e) {
+		throw WriterError((std::string("While reading the resource: ") + e.what()).c_str());
+	}
+
+	// Before opening the resource, so that its descriptor isn't leaked when the name is refused
+	check_name(name, replace);
+
+	const int fd = ::open(filename, O_RDONLY | O_CLOEXEC);
+	const auto size = fd >= 0 ? file_size(fd) : -1;
+
+	if (size < 0) {
+		if (fd >= 0) {
+			::close(fd);
+		}
+		throw WriterError("Can't copy the resource");
+	}
+
+	const auto offset = open_member(name, replace);
+	const bool ok = detail::copy_range(fd, 0, state_->fd, offset, size);
+	::close(fd);
+
+	if (!ok) {
+		abandon_member();
+		throw WriterError("Can't copy the resource");
+	}
+
+	close_member();
+	keep_member();
+}
+
+void PackWriter::finalize() && {
+	close_member();
+
+	auto& members = state_->members;
+	std::sort(members.begin(), members.end(),
+	          [](const State::Member& a, const State::Member& b) { return a.name < b.name; });
+
+	const auto size = file_size(state_->fd);
+	if (size < 0) {
+		throw WriterError("Can't get the size of the pack");
+	}
+
+	// The entries are read in place, so the directory is aligned
+	const auto directory_offset = (static_cast<std::uint64_t>(size) + 7) / 8 * 8;
+	const auto padding = directory_offset - size;
+
+	std::uint64_t names_size = 0;
+	for (const auto& member : members) {
+		names_size += member.name.size();
+	}
+
+	const auto entries_size = members.size() * sizeof(detail::PackEntry);
+	std::vector<char> directory(padding + entries_size + names_size + sizeof(detail::PackTrailer), 0);
+
+	char* entries = directory.data() + padding;
+	std::uint64_t name_offset = entries_size;
+
+	for (std::size_t i = 0; i < members.size(); ++i) {
+		const detail::PackEntry entry{members[i].offset, members[i].size, name_offset, members[i].name.size()};
+		std::memcpy(entries + i * sizeof(entry), &entry, sizeof(entry));
+		std::memcpy(entries + name_offset, members[i].name.data(), members[i].name.size());
+		name_offset += members[i].name.size();
+	}
+
+	const detail::PackTrailer trailer{directory_offset, members.size(), pack_magic};
+	std::memcpy(entries + entries_size + names_size, &trailer, sizeof(trailer));
+
+	bool ok = detail::write_all(state_->fd, directory.data(), directory.size(), size);
+
+	if (ok && state_->durability != Durability::None) {
+		ok = ::fdatasync(state_->fd) == 0;
+	}
+
+	state_.reset();
+
+	if (!ok) {
+		throw WriterError("Can't write the directory of the pack");
+	}
+}
+
+constexpr std::size_t PackReader::npos;
+
+PackReader::PackReader(std::unique_ptr<State>&& state) : state_(std::move(state)) {}
+
+PackReader::PackReader(PackReader&&) = default;
+PackReader& PackReader::operator=(PackReader&&) = default;
+PackReader::~PackReader() = default;
+
+PackReader PackReader::open(const char* filename, const ReaderOptions& options) {
+	auto state = std::make_unique<State>();
+	state->buffer_size = options.buffer_size;
+
+	state->fd = ::open(filename, O_RDONLY | O_CLOEXEC);
+	if (state->fd < 0) {
+		throw ReaderError("Bad stream");
+	}
+
+	const auto size = file_size(state->fd);
+	if (size < static_cast<std::int64_t>(detail::pack_header_size + sizeof(detail::PackTrailer))) {
+		throw ReaderError("Can't read enough data for the pack");
+	}
+
+	std::uint64_t magic = 0;
+	std::uint32_t version = 0;
+
+	if (::pread(state->fd, &magic, sizeof(magic), 0) != sizeof(magic) ||
+	    ::pread(state->fd, &version, sizeof(version), sizeof(magic)) != sizeof(version)) {
+		throw ReaderError("Can't read enough data for the pack");
+	}
+
+	if (magic != pack_magic) {
+		throw ReaderError("Wrong magic");
+	}
+
+	if (version != pack_version) {
+		throw ReaderError("Unsupported pack version");
+	}
+
+	// An update of the pack may have been abandoned after appending members: its previous directory is still in place
+	if (!state->load_directory(size) && !state->load_previous_directory(size)) {
+		throw ReaderError("The directory of the pack is missing or corrupted");
+	}
+
+	return PackReader(std::move(state));
+}
+
+std::size_t PackReader::member_count() const {
+	return state_->count;
+}
+
+std::string PackReader::name(std::size_t index) const {
+	const auto& entry = state_->entries[index];
+	return std::string(state_->directory + entry.name_offset, entry.name_size);
+}
+
+std::uint64_t PackReader::member_size(std::size_t index) const {
+	return state_->entries[index].size;
+}
+
+std::uint64_t PackReader::dead_size() const {
+	return state_->dead_size;
+}
+
+std::size_t PackReader::find(const char* name) const {
+	const auto size = std::strlen(name);
+
+	std::size_t begin = 0;
+	std::size_t end = state_->count;
+
+	while (begin < end) {
+		const auto middle = begin + (end - begin) / 2;
+		const auto& entry = state_->entries[middle];
+		const int result = compare(state_->directory + entry.name_offset, entry.name_size, name, size);
+
+		if (result == 0) {
+			return middle;
+		}
+
+		if (result < 0) {
+			begin = middle + 1;
+		} else {
+			end = middle;
+		}
+	}
+
+	return npos;
+}
+
+Reader PackReader::open_member(std::size_t index) const {
+	if (index >= state_->count) {
+		throw ReaderError("No such member in the pack");
+	}
+
+	const auto& entry = state_->entries[index];
+
+	// Each member has its own descriptor, limited to its range of the pack
+	auto stream = std::make_unique<detail::FileStream>(::fcntl(state_->fd, F_DUPFD_CLOEXEC, 0), state_->buffer_size);
+	stream->buf().slice(entry.offset, entry.offset + entry.size);
+
+	return Reader::open(std::move(stream));
+}
+
+Reader PackReader::open_member(const char* name) const {
+	const auto index = find(name);
+
+	if (index == npos) {
+		throw ReaderError("No such member in the pack");
+	}
+
+	return open_member(index);
+}
+
+}} // namespace reven::binresource
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+namespace reven {
+namespace binresource {
+namespace detail {
+
+///
+/// Layout of a pack:
+///
+/// - The header: the pack magic, the pack version, and 4 reserved bytes
+/// - The members, each one a complete resource (header and payload) stored contiguously
+/// - The directory: a PackEntry per member sorted by name, followed by the names
+/// - The PackTrailer, at the very end of the file
+///
+/// An update appends new members, a new directory and a new trailer after the previous trailer. If it is abandoned
+/// before writing its trailer, the last trailer ending its directory exactly is the one in effect.
+///
+/// All the integers are little-endian, like the rest of the format.
+///
+
+constexpr std::size_t pack_header_size = 16;
+
+struct PackEntry {
+	//! Offset of the member in the pack
+	std::uint64_t offset;
+	std::uint64_t size;
+	//! Offset of the name from the beginning of the directory
+	std::uint64_t name_offset;
+	std::uint64_t name_size;
+};
+
+static_assert(sizeof(PackEntry) == 32, "The entries are read in place");
+
+struct PackTrailer {
+	//! Offset of the directory in the pack
+	std::uint64_t directory_offset;
+	std::uint64_t entry_count;
+	std::uint64_t magic;
+};
+
+static_assert(sizeof(PackTrailer) == 24, "The trailer is read in place");
+
+}}} // namespace reven::binresource::detail
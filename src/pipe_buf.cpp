@@ -0,0 +1,300 @@
+#include "pipe_buf.h"
+#include "common.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace reven {
+namespace binresource {
+namespace detail {
+
+PipeBuf::PipeBuf(int fd, std::size_t buffer_size)
+	: fd_(fd), buffer_size_(std::max<std::size_t>(buffer_size, 2 * sizeof(StreamTrailer))),
+	  buffer_(new char[buffer_size_]) {
+	setp(nullptr, nullptr);
+	setg(nullptr, nullptr, nullptr);
+}
+
+PipeBuf::~PipeBuf() {
+	if (fd_ < 0) {
+		return;
+	}
+
+	end_stream();
+	::close(fd_);
+}
+
+void PipeBuf::end_with_trailer() {
+	trailer_ = true;
+	payload_begin_ = position();
+}
+
+bool PipeBuf::end_stream() {
+	if (fd_ < 0 || !flush_buffer()) {
+		return false;
+	}
+
+	if (!trailer_ || ended_) {
+		return true;
+	}
+
+	ended_ = true;
+
+	const StreamTrailer trailer{transferred_ - payload_begin_, magic};
+	return write_all(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+}
+
+void PipeBuf::expect_trailer() {
+	trailer_expected_ = true;
+	payload_begin_ = position();
+
+	// The end of the data already read may be the trailer
+	tail_size_ = std::min<std::size_t>(egptr() - gptr(), sizeof(tail_));
+
+	if (tail_size_ > 0) {
+		std::memcpy(tail_, egptr() - tail_size_, tail_size_);
+		setg(eback(), gptr(), egptr() - tail_size_);
+	}
+}
+
+PipeBuf::int_type PipeBuf::overflow(int_type c) {
+	if (fd_ < 0 || ended_ || !flush_buffer()) {
+		return traits_type::eof();
+	}
+
+	setp(buffer_.get(), buffer_.get() + buffer_size_);
+
+	if (!traits_type::eq_int_type(c, traits_type::eof())) {
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+	}
+
+	return traits_type::not_eof(c);
+}
+
+std::streamsize PipeBuf::xsputn(const char* s, std::streamsize n) {
+	if (fd_ < 0 || ended_) {
+		return 0;
+	}
+
+	// Large writes bypass the buffer
+	if (static_cast<std::size_t>(n) >= buffer_size_) {
+		if (!flush_buffer() || !write_all(s, n)) {
+			return 0;
+		}
+
+		return n;
+	}
+
+	return std::streambuf::xsputn(s, n);
+}
+
+PipeBuf::int_type PipeBuf::underflow() {
+	if (gptr() != nullptr && gptr() < egptr()) {
+		return traits_type::to_int_type(*gptr());
+	}
+
+	if (fd_ < 0) {
+		return traits_type::eof();
+	}
+
+	const auto size = read_payload(buffer_.get(), buffer_size_);
+
+	if (size == 0) {
+		return traits_type::eof();
+	}
+
+	setg(buffer_.get(), buffer_.get(), buffer_.get() + size);
+
+	return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize PipeBuf::xsgetn(char* s, std::streamsize n) {
+	std::streamsize read = 0;
+
+	while (read < n) {
+		if (gptr() != nullptr && gptr() < egptr()) {
+			const auto size = std::min<std::streamsize>(n - read, egptr() - gptr());
+			std::memcpy(s + read, gptr(), size);
+			gbump(static_cast<int>(size));
+			read += size;
+			continue;
+		}
+
+		// Large reads bypass the buffer
+		if (static_cast<std::size_t>(n - read) >= buffer_size_) {
+			if (fd_ < 0) {
+				break;
+			}
+
+			const auto size = read_payload(s + read, n - read);
+
+			if (size == 0) {
+				break;
+			}
+
+			read += size;
+			continue;
+		}
+
+		if (traits_type::eq_int_type(underflow(), traits_type::eof())) {
+			break;
+		}
+	}
+
+	return read;
+}
+
+std::streamsize PipeBuf::showmanyc() {
+	if (fd_ < 0) {
+		return -1;
+	}
+
+	int available = 0;
+	if (::ioctl(fd_, FIONREAD, &available) != 0) {
+		return 0;
+	}
+
+	// The trailer is never available
+	if (trailer_expected_) {
+		const auto held = static_cast<std::streamsize>(available + tail_size_);
+		return std::max<std::streamsize>(held - static_cast<std::streamsize>(sizeof(StreamTrailer)), 0);
+	}
+
+	return available;
+}
+
+PipeBuf::pos_type PipeBuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode) {
+	// Only the position queries (tellg/tellp) are supported
+	if (fd_ < 0 || off != 0 || dir != std::ios_base::cur) {
+		return pos_type(off_type(-1));
+	}
+
+	return pos_type(off_type(position()));
+}
+
+int PipeBuf::sync() {
+	return flush_buffer() ? 0 : -1;
+}
+
+std::uint64_t PipeBuf::position() const {
+	if (pbase() != nullptr) {
+		return transferred_ + (pptr() - pbase());
+	}
+
+	return transferred_ - (egptr() - gptr()) - tail_size_;
+}
+
+bool PipeBuf::flush_buffer() {
+	if (pbase() == nullptr || pptr() == pbase()) {
+		return true;
+	}
+
+	if (!write_all(pbase(), pptr() - pbase())) {
+		return false;
+	}
+
+	setp(buffer_.get(), buffer_.get() + buffer_size_);
+
+	return true;
+}
+
+bool PipeBuf::write_all(const char* data, std::size_t size) {
+	while (size > 0) {
+		const auto result = ::write(fd_, data, size);
+
+		if (result < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+
+		data += result;
+		size -= result;
+		transferred_ += result;
+	}
+
+	return true;
+}
+
+ssize_t PipeBuf::read_some(char* data, std::size_t size) {
+	while (true) {
+		const auto result = ::read(fd_, data, size);
+
+		if (result < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (result > 0) {
+			transferred_ += result;
+		}
+
+		return result;
+	}
+}
+
+std::size_t PipeBuf::read_payload(char* data, std::size_t size) {
+	if (!trailer_expected_) {
+		const auto result = read_some(data, size);
+
+		if (result < 0) {
+			throw std::ios_base::failure("Can't read the stream");
+		}
+
+		return result;
+	}
+
+	// The last bytes read are held back, as they may be the trailer
+	std::size_t total = tail_size_;
+	std::memcpy(data, tail_, tail_size_);
+
+	while (true) {
+		const auto result = read_some(data + total, size - total);
+
+		if (result < 0) {
+			throw std::ios_base::failure("Can't read the stream");
+		}
+
+		if (result == 0) {
+			break;
+		}
+
+		total += result;
+
+		if (total > sizeof(StreamTrailer)) {
+			std::memcpy(tail_, data + total - sizeof(StreamTrailer), sizeof(StreamTrailer));
+			tail_size_ = sizeof(StreamTrailer);
+
+			return total - sizeof(StreamTrailer);
+		}
+
+		std::memcpy(tail_ + tail_size_, data + tail_size_, total - tail_size_);
+		tail_size_ = total;
+	}
+
+	// At the end of the stream, the bytes held back must be the trailer of the payload read
+	StreamTrailer trailer;
+	if (tail_size_ != sizeof(trailer)) {
+		throw std::ios_base::failure("The stream is truncated");
+	}
+
+	std::memcpy(&trailer, tail_, sizeof(trailer));
+	if (trailer.magic != magic || trailer.payload_size != transferred_ - sizeof(trailer) - payload_begin_) {
+		throw std::ios_base::failure("The stream is truncated");
+	}
+
+	return 0;
+}
+
+PipeStream::PipeStream(int fd, std::size_t buffer_size) : std::iostream(nullptr), buf_(fd, buffer_size) {
+	if (buf_.is_open()) {
+		rdbuf(&buf_);
+	}
+}
+
+}}} // namespace reven::binresource::detail
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <streambuf>
+
+namespace reven {
+namespace binresource {
+namespace detail {
+
+///
+/// End of the payload of a resource sent through a PipeBuf, so that the reader can tell a complete stream from a
+/// truncated one
+///
+struct StreamTrailer {
+	std::uint64_t payload_size;
+	std::uint64_t magic;
+};
+
+///
+/// Buffered streambuf over a file descriptor that can't be sought, like a pipe or a socket.
+/// The same buffer is used either for reading or for writing, and the file descriptor is only read or written
+/// sequentially. The bytes going through it are counted, so the position of the stream can still be queried
+/// (tellg/tellp), but any actual seek fails.
+/// Failing to read the file descriptor throws std::ios_base::failure, which sets the badbit of the stream.
+///
+class PipeBuf : public std::streambuf {
+public:
+	//! Take the ownership of the file descriptor
+	PipeBuf(int fd, std::size_t buffer_size);
+	~PipeBuf() override;
+
+	PipeBuf(const PipeBuf&) = delete;
+	PipeBuf& operator=(const PipeBuf&) = delete;
+
+	bool is_open() const { return fd_ >= 0; }
+	int fd() const { return fd_; }
+
+	//! The data written from now on is a payload, ended with a StreamTrailer by `end_stream` or at the destruction of
+	//! the buffer
+	void end_with_trailer();
+
+	//! Write the pending data and the trailer, if any. Nothing can be written afterwards. Return false on failure.
+	bool end_stream();
+
+	//! The data read from now on is a payload ended with a StreamTrailer. The trailer isn't part of the data read, and
+	//! the end of the stream fails if it is missing or doesn't match the payload.
+	void expect_trailer();
+
+protected:
+	int_type overflow(int_type c) override;
+	std::streamsize xsputn(const char* s, std::streamsize n) override;
+	int_type underflow() override;
+	std::streamsize xsgetn(char* s, std::streamsize n) override;
+	std::streamsize showmanyc() override;
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+	int sync() override;
+
+private:
+	//! Current position in the stream, taking the buffer into account
+	std::uint64_t position() const;
+
+	//! Write the pending data. Return false on failure.
+	bool flush_buffer();
+	bool write_all(const char* data, std::size_t size);
+	//! Read at most `size` bytes. Return the result of read.
+	ssize_t read_some(char* data, std::size_t size);
+	//! Read at most `size` bytes of the payload, which must be more than the size of the trailer, holding back the
+	//! trailer if expected. Return 0 at the end of the stream.
+	//! \throws std::ios_base::failure if the reading fails or if the trailer is missing or doesn't match
+	std::size_t read_payload(char* data, std::size_t size);
+
+private:
+	int fd_;
+	std::size_t buffer_size_;
+	std::unique_ptr<char[]> buffer_;
+
+	//! Number of bytes read from or written to the file descriptor so far
+	std::uint64_t transferred_ = 0;
+
+	//! Whether the payload written is ended with a trailer, or the payload read is expected to be
+	bool trailer_ = false;
+	bool trailer_expected_ = false;
+	//! Position of the beginning of the payload
+	std::uint64_t payload_begin_ = 0;
+	//! Whether the trailer was written
+	bool ended_ = false;
+	//! The last bytes read, held back until the end of the stream because they may be the trailer
+	char tail_[sizeof(StreamTrailer)];
+	std::size_t tail_size_ = 0;
+};
+
+///
+/// Stream using a PipeBuf
+///
+class PipeStream : public std::iostream {
+public:
+	//! Take the ownership of the file descriptor, the stream is bad if it is negative
+	PipeStream(int fd, std::size_t buffer_size);
+
+	PipeBuf& buf() { return buf_; }
+
+private:
+	PipeBuf buf_;
+};
+
+}}} // namespace reven::binresource::detail
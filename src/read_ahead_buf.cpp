@@ -0,0 +1,204 @@
+#include "read_ahead_buf.h"
+
+#include <algorithm>
+#include <cerrno>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace reven {
+namespace binresource {
+namespace detail {
+
+ReadAheadBuf::ReadAheadBuf(int fd, std::size_t chunk_size, std::size_t chunk_count)
+	: fd_(fd), chunk_size_(std::max<std::size_t>(chunk_size, 1)) {
+	setg(nullptr, nullptr, nullptr);
+
+	if (fd_ < 0) {
+		return;
+	}
+
+	// At least two chunks so that a chunk can be read while another is consumed
+	chunks_.resize(std::max<std::size_t>(chunk_count, 2));
+	for (auto& chunk : chunks_) {
+		chunk.data.reset(new char[chunk_size_]);
+		chunk.offset = 0;
+		chunk.size = 0;
+		chunk.failed = false;
+	}
+
+	thread_ = std::thread(&ReadAheadBuf::run, this);
+}
+
+ReadAheadBuf::~ReadAheadBuf() {
+	if (fd_ < 0) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	cv_.notify_all();
+
+	thread_.join();
+	::close(fd_);
+}
+
+ReadAheadBuf::int_type ReadAheadBuf::underflow() {
+	if (gptr() < egptr()) {
+		return traits_type::to_int_type(*gptr());
+	}
+
+	if (fd_ < 0) {
+		return traits_type::eof();
+	}
+
+	std::unique_lock<std::mutex> lock(mutex_);
+
+	if (holding_) {
+		if (chunks_[head_].size == 0) {
+			return end_of_chunks(chunks_[head_]);
+		}
+
+		// Give the current chunk back to the background thread
+		offset_ += chunks_[head_].size;
+		head_ = (head_ + 1) % chunks_.size();
+		--ready_;
+		holding_ = false;
+		setg(nullptr, nullptr, nullptr);
+		cv_.notify_all();
+	}
+
+	cv_.wait(lock, [this]() { return ready_ > 0; });
+
+	holding_ = true;
+	const auto& chunk = chunks_[head_];
+	offset_ = chunk.offset;
+
+	if (chunk.size == 0) {
+		return end_of_chunks(chunk);
+	}
+
+	setg(chunk.data.get(), chunk.data.get(), chunk.data.get() + chunk.size);
+
+	return traits_type::to_int_type(*gptr());
+}
+
+ReadAheadBuf::pos_type ReadAheadBuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) {
+	if (fd_ < 0 || !(which & std::ios_base::in)) {
+		return pos_type(off_type(-1));
+	}
+
+	const std::uint64_t pos = offset_ + (gptr() - eback());
+
+	off_type target = off;
+	if (dir == std::ios_base::cur) {
+		target += pos;
+	} else if (dir == std::ios_base::end) {
+		struct stat st;
+		if (::fstat(fd_, &st) != 0) {
+			return pos_type(off_type(-1));
+		}
+
+		target += st.st_size;
+	}
+
+	if (target < 0) {
+		return pos_type(off_type(-1));
+	}
+
+	// Stay in the current chunk if possible
+	if (eback() != nullptr && static_cast<std::uint64_t>(target) >= offset_ &&
+	    static_cast<std::uint64_t>(target) <= offset_ + (egptr() - eback())) {
+		setg(eback(), eback() + (target - offset_), egptr());
+		return pos_type(target);
+	}
+
+	if (static_cast<std::uint64_t>(target) != pos) {
+		restart(target);
+	}
+
+	return pos_type(target);
+}
+
+ReadAheadBuf::pos_type ReadAheadBuf::seekpos(pos_type pos, std::ios_base::openmode which) {
+	return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+ReadAheadBuf::int_type ReadAheadBuf::end_of_chunks(const Chunk& chunk) {
+	// The stream catches the exception and becomes bad, rethrowing it only if asked to
+	if (chunk.failed) {
+		throw std::ios_base::failure("Can't read the file");
+	}
+
+	return traits_type::eof();
+}
+
+void ReadAheadBuf::run() {
+	std::unique_lock<std::mutex> lock(mutex_);
+
+	while (true) {
+		cv_.wait(lock, [this]() { return stop_ || (ready_ < chunks_.size() && !end_reached_); });
+
+		if (stop_) {
+			return;
+		}
+
+		// The slot isn't used by the consumer, read it without holding the lock
+		auto& chunk = chunks_[(head_ + ready_) % chunks_.size()];
+		const auto generation = generation_;
+		const auto offset = next_offset_;
+
+		lock.unlock();
+
+		ssize_t size = 0;
+		do {
+			size = ::pread(fd_, chunk.data.get(), chunk_size_, offset);
+		} while (size < 0 && errno == EINTR);
+
+		lock.lock();
+
+		if (generation != generation_) {
+			// The consumer seeked elsewhere in the meantime
+			continue;
+		}
+
+		chunk.offset = offset;
+		chunk.size = size > 0 ? size : 0;
+		chunk.failed = size < 0;
+
+		if (chunk.size == 0) {
+			end_reached_ = true;
+		}
+
+		next_offset_ += chunk.size;
+		++ready_;
+		cv_.notify_all();
+	}
+}
+
+void ReadAheadBuf::restart(std::uint64_t offset) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		++generation_;
+		ready_ = 0;
+		holding_ = false;
+		end_reached_ = false;
+		offset_ = offset;
+		next_offset_ = offset;
+	}
+	cv_.notify_all();
+
+	setg(nullptr, nullptr, nullptr);
+}
+
+ReadAheadStream::ReadAheadStream(int fd, std::size_t chunk_size, std::size_t chunk_count)
+	: std::istream(nullptr), buf_(fd, chunk_size, chunk_count) {
+	if (buf_.is_open()) {
+		rdbuf(&buf_);
+	}
+}
+
+}}} // namespace reven::binresource::detail
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+namespace reven {
+namespace binresource {
+namespace detail {
+
+///
+/// Input streambuf over a file descriptor, where a background thread reads the next chunks of the file into a ring
+/// of buffers while the current chunk is consumed.
+/// Seeking outside of the current chunk discards the chunks already read and restarts the reading at the new position.
+/// A read error of the background thread is reported by the consumer as an error of the stream, not as its end.
+///
+class ReadAheadBuf : public std::streambuf {
+public:
+	//! Take the ownership of the file descriptor
+	ReadAheadBuf(int fd, std::size_t chunk_size, std::size_t chunk_count);
+	~ReadAheadBuf() override;
+
+	ReadAheadBuf(const ReadAheadBuf&) = delete;
+	ReadAheadBuf& operator=(const ReadAheadBuf&) = delete;
+
+	bool is_open() const { return fd_ >= 0; }
+	int fd() const { return fd_; }
+
+protected:
+	int_type underflow() override;
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+private:
+	struct Chunk {
+		std::unique_ptr<char[]> data;
+		//! Offset in the file of the data
+		std::uint64_t offset;
+		//! 0 at the end of the file or on error
+		std::size_t size;
+		//! Whether the reading failed, which the consumer reports instead of the end of the file
+		bool failed;
+	};
+
+	//! Result of `underflow` on the empty chunk ending the reading: the end of the file, or an error
+	int_type end_of_chunks(const Chunk& chunk);
+
+	//! Body of the background thread
+	void run();
+	//! Discard the chunks already read and restart the reading at `offset`
+	void restart(std::uint64_t offset);
+
+private:
+	int fd_;
+	std::size_t chunk_size_;
+
+	std::mutex mutex_;
+	std::condition_variable cv_;
+
+	std::vector<Chunk> chunks_;
+	//! Index of the first ready chunk, which is the current chunk when `holding_` is true
+	std::size_t head_ = 0;
+	//! Number of ready chunks, including the current one
+	std::size_t ready_ = 0;
+	bool holding_ = false;
+
+	//! Offset of the current chunk, or of the next data to consume when not holding a chunk
+	std::uint64_t offset_ = 0;
+	//! Offset of the next data to read by the background thread
+	std::uint64_t next_offset_ = 0;
+	bool end_reached_ = false;
+	//! Incremented on each restart so that the background thread can discard its read in progress
+	std::uint64_t generation_ = 0;
+	bool stop_ = false;
+
+	std::thread thread_;
+};
+
+///
+/// Input stream using a ReadAheadBuf
+///
+class ReadAheadStream : public std::istream {
+public:
+	//! Take the ownership of the file descriptor, the stream is bad if it is negative
+	ReadAheadStream(int fd, std::size_t chunk_size, std::size_t chunk_count);
+
+	ReadAheadBuf& buf() { return buf_; }
+
+private:
+	ReadAheadBuf buf_;
+};
+
+}}} // namespace reven::binresource::detail
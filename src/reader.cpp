@@ -1,18 +1,75 @@
 #include "reader.h"
 #include "common.h"
+#include "file_buf.h"
+#include "follower.h"
+#include "header_extension.h"
+#include "instrumented_buf.h"
+#include "pipe_buf.h"
+#include "read_ahead_buf.h"
 
+#include <algorithm>
 #include <cassert>
-#include <fstream>
+#include <cerrno>
+#include <climits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/uio.h>
 
 namespace reven {
 namespace binresource {
 
-Reader Reader::open(const char* filename) {
-	return Reader::open(std::make_unique<std::ifstream>(filename, std::ios::binary | std::ios::in));
+Reader Reader::open(const char* filename, const ReaderOptions& options) {
+	const int fd = ::open(filename, O_RDONLY | O_CLOEXEC);
+
+	std::unique_ptr<std::istream> stream;
+	if (options.follow) {
+		auto file_stream = std::make_unique<detail::FileStream>(fd, options.buffer_size);
+
+		if (fd >= 0) {
+			file_stream->buf().follow(std::make_unique<detail::Follower>(fd, filename, options.follow_poll_interval));
+		}
+
+		stream = std::move(file_stream);
+	} else if (options.read_ahead_chunks > 0) {
+		stream = std::make_unique<detail::ReadAheadStream>(fd, options.read_ahead_chunk_size, options.read_ahead_chunks);
+	} else {
+		stream = std::make_unique<detail::FileStream>(fd, options.buffer_size);
+	}
+
+	Reader reader = Reader::do_open(std::move(stream), filename);
+	reader.fd_ = fd;
+
+	if (options.access_pattern != AccessPattern::Normal) {
+		reader.advise(options.access_pattern);
+	}
+
+	return reader;
 }
 
 Reader Reader::open(std::unique_ptr<std::istream>&& stream) {
-	Reader reader(std::move(stream));
+	return Reader::do_open(std::move(stream), "");
+}
+
+Reader Reader::open_streaming(int fd, std::size_t buffer_size) {
+	auto stream = std::make_unique<detail::PipeStream>(fd, buffer_size);
+	auto& buf = stream->buf();
+
+	Reader reader = Reader::do_open(std::move(stream), "", true);
+
+	// Sent by a streaming writer rather than copied from a file
+	if (detail::HeaderExtension::of(reader.md_).stream_trailer) {
+		buf.expect_trailer();
+	}
+
+	return reader;
+}
+
+Reader Reader::do_open(std::unique_ptr<std::istream>&& stream, const char* path, bool streaming) {
+	const auto tracer = binresource::tracer();
+	detail::TraceScope scope(tracer, TraceEventType::ReaderOpen, path);
+
+	Reader reader(std::move(stream), streaming);
 
 	if (!*reader.stream_) {
 		throw ReaderError("Bad stream");
@@ -44,9 +101,143 @@ Reader Reader::open(std::unique_ptr<std::istream>&& stream) {
 	reader.md_ = reader.read_metadata(metadata_version);
 	reader.md_size_ = reader.stream_->tellg();
 
+	// The trailer following the payload would be read as part of it
+	if (!streaming && detail::HeaderExtension::of(reader.md_).stream_trailer) {
+		throw ReaderError("The resource was sent by a streaming writer and can only be read from its stream");
+	}
+
+	scope.set_size(reader.md_size_);
+	detail::trace(*reader.stream_, reader.instrumented_, tracer, path);
+
 	return reader;
 }
 
+void Reader::advise(AccessPattern pattern) {
+	if (fd_ < 0) {
+		return;
+	}
+
+	int advice = POSIX_FADV_NORMAL;
+	switch (pattern) {
+		case AccessPattern::Normal:
+			advice = POSIX_FADV_NORMAL;
+			break;
+		case AccessPattern::Sequential:
+			advice = POSIX_FADV_SEQUENTIAL;
+			break;
+		case AccessPattern::Random:
+			advice = POSIX_FADV_RANDOM;
+			break;
+		case AccessPattern::WillNeed:
+			advice = POSIX_FADV_WILLNEED;
+			break;
+	}
+
+	// A length of 0 means until the end of the file
+	::posix_fadvise(fd_, md_size_, 0, advice);
+}
+
+void Reader::prefetch(std::uint64_t offset, std::uint64_t size) {
+	if (fd_ < 0 || size == 0) {
+		return;
+	}
+
+	::readahead(fd_, md_size_ + offset, size);
+}
+
+bool Reader::has_content_hash() const {
+	return detail::HeaderExtension::of(md_).has_content_hash;
+}
+
+std::uint64_t Reader::content_hash() const {
+	const auto extension = detail::HeaderExtension::of(md_);
+	return extension.has_content_hash ? extension.content_hash : 0;
+}
+
+std::size_t Reader::read_vec(std::uint64_t offset, const MutableBuffer* buffers, std::size_t count) {
+	if (streaming_) {
+		throw ReaderError("Can't read at an offset of a streaming resource");
+	}
+
+	if (fd_ < 0) {
+		// A previous read may have reached the end of the file
+		stream_->clear();
+		const auto previous_pos = stream_->tellg();
+
+		stream_->seekg(md_size_ + offset);
+
+		std::size_t read = 0;
+		for (std::size_t i = 0; i < count && *stream_; ++i) {
+			stream_->read(static_cast<char*>(buffers[i].data), buffers[i].size);
+			read += stream_->gcount();
+		}
+
+		if (stream_->bad()) {
+			throw ReaderError("Can't read the buffers");
+		}
+
+		// Reaching the end of the file isn't an error
+		stream_->clear();
+		stream_->seekg(previous_pos);
+
+		return read;
+	}
+
+	std::vector<struct iovec> iov(count);
+	for (std::size_t i = 0; i < count; ++i) {
+		iov[i].iov_base = buffers[i].data;
+		iov[i].iov_len = buffers[i].size;
+	}
+
+	const auto timestamp = detail::now_ns();
+
+	std::size_t read = 0;
+	std::size_t first = 0;
+	while (first < count) {
+		const auto iov_count = static_cast<int>(std::min<std::size_t>(count - first, IOV_MAX));
+		const auto result = ::preadv(fd_, iov.data() + first, iov_count, md_size_ + offset + read);
+
+		if (result < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			throw ReaderError("Can't read the buffers");
+		}
+
+		if (result == 0) {
+			break;
+		}
+
+		read += result;
+
+		// Skip what was read
+		std::size_t remaining = result;
+		while (first < count && remaining >= iov[first].iov_len) {
+			remaining -= iov[first].iov_len;
+			++first;
+		}
+
+		if (first < count) {
+			iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + remaining;
+			iov[first].iov_len -= remaining;
+		}
+	}
+
+	if (instrumented_ != nullptr) {
+		instrumented_->record(IoOperation::Read, md_size_ + offset, read, timestamp);
+	}
+
+	return read;
+}
+
+void Reader::instrument(std::shared_ptr<IoStats> stats) {
+	detail::instrument(*stream_, instrumented_, std::move(stats));
+}
+
+std::shared_ptr<IoStats> Reader::stats() const {
+	return instrumented_ != nullptr ? instrumented_->stats() : nullptr;
+}
+
 Metadata Reader::read_metadata(std::uint32_t metadata_version) {
 	try {
 		return Metadata::deserialize(metadata_version, *stream_);
@@ -0,0 +1,150 @@
+#include "resource_cache.h"
+
+#include <iterator>
+
+#include <sys/stat.h>
+
+namespace reven {
+namespace binresource {
+
+namespace {
+
+std::size_t entry_cost(const Reader& reader, const ReaderOptions& options) {
+	// The buffers of the stream dominate
+	const bool read_ahead = options.read_ahead_chunks > 0 && !options.follow;
+	const auto buffer_size = read_ahead ? options.read_ahead_chunks * options.read_ahead_chunk_size : options.buffer_size;
+
+	return sizeof(Reader) + reader.md_size() + buffer_size;
+}
+
+} // anonymous namespace
+
+bool ResourceCache::FileId::operator==(const FileId& other) const {
+	return device == other.device && inode == other.inode && size == other.size &&
+	       mtime_sec == other.mtime_sec && mtime_nsec == other.mtime_nsec;
+}
+
+ReaderOptions ResourceCache::default_reader_options() {
+	ReaderOptions options;
+	options.buffer_size = default_cached_stream_buffer_size;
+	return options;
+}
+
+ResourceCache& ResourceCache::global() {
+	static ResourceCache cache;
+	return cache;
+}
+
+std::shared_ptr<Reader> ResourceCache::open(const char* filename) {
+	struct stat st;
+	if (::stat(filename, &st) != 0) {
+		erase(filename);
+		throw ReaderError("Bad stream");
+	}
+
+	const FileId id{
+		static_cast<std::uint64_t>(st.st_dev), static_cast<std::uint64_t>(st.st_ino), static_cast<std::uint64_t>(st.st_size),
+		static_cast<std::int64_t>(st.st_mtim.tv_sec), static_cast<std::int64_t>(st.st_mtim.tv_nsec)
+	};
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		auto it = index_.find(filename);
+		if (it != index_.end()) {
+			if (it->second->id == id) {
+				++stats_.hits;
+				entries_.splice(entries_.begin(), entries_, it->second);
+				return it->second->reader;
+			}
+
+			// The file changed on disk since we opened it
+			remove(it->second);
+			++stats_.evictions;
+		}
+
+		++stats_.misses;
+	}
+
+	// Open outside of the lock so that a slow opening doesn't block the users of the other resources
+	auto reader = std::make_shared<Reader>(Reader::open(filename, options_));
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	if (limits_.max_open == 0) {
+		return reader;
+	}
+
+	// Another user may have opened the same resource concurrently: share its reader
+	auto it = index_.find(filename);
+	if (it != index_.end()) {
+		if (it->second->id == id) {
+			entries_.splice(entries_.begin(), entries_, it->second);
+			return it->second->reader;
+		}
+
+		remove(it->second);
+		++stats_.evictions;
+	}
+
+	entries_.push_front(Entry{filename, id, reader, entry_cost(*reader, options_)});
+	index_.emplace(entries_.front().filename, entries_.begin());
+	++stats_.open;
+	stats_.memory += entries_.front().cost;
+
+	evict();
+
+	return reader;
+}
+
+void ResourceCache::erase(const char* filename) {
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	auto it = index_.find(filename);
+	if (it != index_.end()) {
+		remove(it->second);
+	}
+}
+
+void ResourceCache::clear() {
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	index_.clear();
+	entries_.clear();
+	stats_.open = 0;
+	stats_.memory = 0;
+}
+
+void ResourceCache::set_limits(const CacheLimits& limits) {
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	limits_ = limits;
+	evict();
+}
+
+CacheLimits ResourceCache::limits() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return limits_;
+}
+
+CacheStats ResourceCache::stats() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stats_;
+}
+
+void ResourceCache::remove(EntryList::iterator it) {
+	--stats_.open;
+	stats_.memory -= it->cost;
+
+	index_.erase(it->filename);
+	entries_.erase(it);
+}
+
+void ResourceCache::evict() {
+	while (!entries_.empty() && (stats_.open > limits_.max_open || stats_.memory > limits_.max_memory)) {
+		remove(std::prev(entries_.end()));
+		++stats_.evictions;
+	}
+}
+
+}} // namespace reven::binresource
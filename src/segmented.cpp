@@ -0,0 +1,274 @@
+#include "segmented.h"
+#include "header_extension.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <future>
+#include <random>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace reven {
+namespace binresource {
+
+namespace {
+
+//! Identifier of a new segmented resource, never 0
+std::uint64_t new_group() {
+	std::random_device device;
+	std::uint64_t group = 0;
+
+	while (group == 0) {
+		group = (std::uint64_t(device()) << 32) | device();
+	}
+
+	return group;
+}
+
+} // anonymous namespace
+
+std::string segment_filename(const char* filename, std::size_t index) {
+	char suffix[32];
+	std::snprintf(suffix, sizeof(suffix), ".%06zu", index);
+
+	return filename + std::string(suffix);
+}
+
+SegmentedWriter::SegmentedWriter(std::string filename, const Metadata& md, std::uint64_t segment_size,
+                                 const WriterOptions& options)
+	: filename_(std::move(filename)), md_(md), segment_size_(segment_size), options_(options), group_(new_group()) {}
+
+SegmentedWriter SegmentedWriter::create(const char* filename, const Metadata& md, std::uint64_t segment_size,
+                                        const WriterOptions& options) {
+	if (segment_size == 0) {
+		throw WriterError("The size of the segments can't be 0");
+	}
+
+	SegmentedWriter writer(filename, md, segment_size, options);
+
+	// The size hint is the expected size of the whole payload
+	writer.options_.size_hint = std::min(options.size_hint, segment_size);
+
+	writer.create_segment();
+
+	return writer;
+}
+
+void SegmentedWriter::write(const void* data, std::size_t size) {
+	const char* bytes = static_cast<const char*>(data);
+
+	while (size > 0) {
+		if (segment_written_ == segment_size_) {
+			next_segment();
+		}
+
+		const auto count = static_cast<std::size_t>(std::min<std::uint64_t>(size, segment_size_ - segment_written_));
+
+		current_->stream().write(bytes, count);
+
+		if (!current_->stream()) {
+			throw WriterError("Can't write the data");
+		}
+
+		bytes += count;
+		size -= count;
+		segment_written_ += count;
+		size_ += count;
+	}
+}
+
+void SegmentedWriter::next_segment() {
+	auto stream = std::move(*current_).finalize();
+	current_.reset();
+
+	if (!*stream) {
+		throw WriterError("Can't write the segment");
+	}
+
+	stream.reset();
+
+	create_segment();
+}
+
+void SegmentedWriter::create_segment() {
+	current_ = std::make_unique<Writer>(
+		Writer::create(segment_filename(filename_.c_str(), segment_count_).c_str(), md_, options_)
+	);
+
+	if (!detail::write_segment(current_->file_->fd(), group_, static_cast<std::uint32_t>(segment_count_), 0)) {
+		throw WriterError("Can't write the header of the segment");
+	}
+
+	++segment_count_;
+	segment_written_ = 0;
+}
+
+void SegmentedWriter::set_metadata(const Metadata& md) {
+	md_ = md;
+
+	// Only the durability applies to the finished segments
+	WriterOptions options;
+	options.buffer_size = options_.buffer_size;
+	options.durability = options_.durability;
+
+	for (std::size_t i = 0; i + 1 < segment_count_; ++i) {
+		auto segment = Writer::open(segment_filename(filename_.c_str(), i).c_str(), options);
+		segment.set_metadata(md);
+
+		if (!*std::move(segment).finalize()) {
+			throw WriterError("Can't write the segment");
+		}
+	}
+
+	current_->set_metadata(md);
+}
+
+void SegmentedWriter::finalize() && {
+	const auto count = static_cast<std::uint32_t>(segment_count_);
+
+	const auto record_count = [this, count](std::size_t index) {
+		const int fd = ::open(segment_filename(filename_.c_str(), index).c_str(), O_WRONLY | O_CLOEXEC);
+		bool ok = fd >= 0 && detail::write_segment(fd, group_, static_cast<std::uint32_t>(index), count);
+
+		if (ok && options_.durability != Durability::None) {
+			ok = ::fdatasync(fd) == 0;
+		}
+
+		if (fd >= 0) {
+			::close(fd);
+		}
+
+		if (!ok) {
+			throw WriterError("Can't write the header of the segment");
+		}
+	};
+
+	// The first segment is updated last: the readers trust the number of segments it records
+	for (std::size_t i = 1; i + 1 < segment_count_; ++i) {
+		record_count(i);
+	}
+
+	if (!detail::write_segment(current_->file_->fd(), group_, count - 1, count)) {
+		throw WriterError("Can't write the header of the segment");
+	}
+
+	auto stream = std::move(*current_).finalize();
+	current_.reset();
+
+	if (!*stream) {
+		throw WriterError("Can't write the segment");
+	}
+
+	if (segment_count_ > 1) {
+		record_count(0);
+	}
+
+	// A previous resource with the same filename may have had more segments
+	for (std::size_t i = segment_count_;; ++i) {
+		if (::unlink(segment_filename(filename_.c_str(), i).c_str()) != 0) {
+			break;
+		}
+	}
+}
+
+SegmentedReader SegmentedReader::open(const char* filename, const ReaderOptions& options) {
+	SegmentedReader reader;
+	reader.offsets_.push_back(0);
+
+	detail::HeaderExtension first;
+
+	for (std::size_t i = 0; first.segment_count == 0 || i < first.segment_count; ++i) {
+		const auto path = segment_filename(filename, i);
+
+		struct stat st;
+		if (::stat(path.c_str(), &st) != 0) {
+			if (i == 0) {
+				throw ReaderError("Can't find the first segment");
+			}
+
+			if (first.segment_count != 0) {
+				throw ReaderError("A segment of the resource is missing");
+			}
+			break;
+		}
+
+		auto segment = Reader::open(path.c_str(), options);
+		const auto extension = detail::HeaderExtension::of(segment.metadata());
+
+		if (i == 0) {
+			if (extension.segment_group == 0) {
+				throw ReaderError("The first segment isn't a segment of a resource");
+			}
+			first = extension;
+		}
+
+		// A segment left by a previous resource with the same filename, if the writer didn't finalize this one
+		if (extension.segment_group != first.segment_group || extension.segment_index != i) {
+			if (first.segment_count != 0) {
+				throw ReaderError("The segments belong to different resources");
+			}
+			break;
+		}
+
+		const auto size = static_cast<std::uint64_t>(st.st_size);
+		if (size < segment.md_size()) {
+			throw ReaderError("Can't read enough data for the segment");
+		}
+
+		reader.segments_.push_back(std::move(segment));
+		reader.offsets_.push_back(reader.offsets_.back() + size - reader.segments_.back().md_size());
+	}
+
+	return reader;
+}
+
+std::size_t SegmentedReader::segment_at(std::uint64_t offset) const {
+	// The last segment containing the offset, as the segments before it may be empty
+	const auto it = std::upper_bound(offsets_.begin(), offsets_.end() - 1, offset);
+	return std::distance(offsets_.begin(), it) - 1;
+}
+
+std::size_t SegmentedReader::read_at(std::uint64_t offset, void* data, std::size_t size) {
+	if (offset >= this->size()) {
+		return 0;
+	}
+
+	size = static_cast<std::size_t>(std::min<std::uint64_t>(size, this->size() - offset));
+
+	const auto first = segment_at(offset);
+	const auto last = segment_at(offset + size - 1);
+
+	const auto read_segment = [this, offset, data, size](std::size_t index) -> std::size_t {
+		const auto begin = std::max(offset, offsets_[index]);
+		const auto end = std::min(offset + size, offsets_[index + 1]);
+
+		MutableBuffer buffer{static_cast<char*>(data) + (begin - offset), static_cast<std::size_t>(end - begin)};
+		return segments_[index].read_vec(begin - offsets_[index], &buffer, 1);
+	};
+
+	// The parts in the other segments are read in parallel with the first one
+	std::vector<std::future<std::size_t>> others;
+	for (std::size_t i = first + 1; i <= last; ++i) {
+		others.push_back(std::async(std::launch::async, read_segment, i));
+	}
+
+	std::size_t read = read_segment(first);
+	bool complete = read == std::min(offset + size, offsets_[first + 1]) - offset;
+
+	for (std::size_t i = 0; i < others.size(); ++i) {
+		const auto index = first + 1 + i;
+		const auto count = others[i].get();
+
+		// Only the data contiguous from the offset counts
+		if (complete) {
+			read += count;
+			complete = count == std::min(offset + size, offsets_[index + 1]) - offsets_[index];
+		}
+	}
+
+	return read;
+}
+
+}} // namespace reven::binresource
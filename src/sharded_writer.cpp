@@ -0,0 +1,170 @@
+#include "sharded_writer.h"
+#include "file_buf.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <tuple>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace reven {
+namespace binresource {
+
+namespace {
+
+std::string temporary_directory() {
+	const char* tmpdir = std::getenv("TMPDIR");
+	return tmpdir != nullptr && *tmpdir != '\0' ? tmpdir : "/tmp";
+}
+
+//! Open an anonymous temporary file in the directory, removed as soon as it is closed
+int open_temporary_file(const std::string& directory) {
+	int fd = ::open(directory.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+
+	if (fd < 0) {
+		// The file system doesn't support O_TMPFILE: unlink a named file right after its creation
+		std::string path = directory + "/.rvnbinresource-shard-XXXXXX";
+		fd = ::mkostemp(&path[0], O_CLOEXEC);
+
+		if (fd >= 0) {
+			::unlink(path.c_str());
+		}
+	}
+
+	return fd;
+}
+
+} // anonymous namespace
+
+ShardedWriter::Shard::Shard(const std::string& spill_directory, std::size_t max_memory)
+	: spill_directory_(spill_directory), max_memory_(max_memory) {}
+
+ShardedWriter::Shard::~Shard() = default;
+
+void ShardedWriter::Shard::write(std::uint64_t sequence, const void* data, std::size_t size) {
+	records_.push_back(Record{sequence, this->size(), size});
+
+	const char* bytes = static_cast<const char*>(data);
+	memory_.insert(memory_.end(), bytes, bytes + size);
+
+	if (memory_.size() > max_memory_) {
+		spill();
+	}
+}
+
+void ShardedWriter::Shard::spill() {
+	if (spill_ == nullptr) {
+		const int fd = open_temporary_file(spill_directory_);
+		if (fd < 0) {
+			throw WriterError("Can't create the temporary file of the shard");
+		}
+
+		spill_ = std::make_unique<detail::FileStream>(fd, default_stream_buffer_size);
+	}
+
+	spill_->seekp(spilled_);
+	spill_->write(memory_.data(), memory_.size());
+
+	if (!*spill_) {
+		throw WriterError("Can't write the temporary file of the shard");
+	}
+
+	spilled_ += memory_.size();
+	memory_.clear();
+}
+
+void ShardedWriter::Shard::copy(const Record& record, std::ostream& out, std::vector<char>& scratch) {
+	if (record.offset >= spilled_) {
+		out.write(memory_.data() + (record.offset - spilled_), record.size);
+		return;
+	}
+
+	// Records are spilled whole
+	scratch.resize(record.size);
+
+	spill_->seekg(record.offset);
+	spill_->read(scratch.data(), record.size);
+
+	if (static_cast<std::size_t>(spill_->gcount()) != record.size) {
+		throw WriterError("Can't read the temporary file of the shard");
+	}
+
+	out.write(scratch.data(), record.size);
+}
+
+ShardedWriter::ShardedWriter(Writer&& writer, std::string spill_directory, std::size_t shard_memory)
+	: writer_(std::move(writer)), spill_directory_(std::move(spill_directory)), shard_memory_(shard_memory),
+	  mutex_(std::make_unique<std::mutex>()) {}
+
+ShardedWriter ShardedWriter::create(const char* filename, const Metadata& md, const WriterOptions& options,
+                                    std::size_t shard_memory) {
+	return ShardedWriter(Writer::create(filename, md, options), detail::parent_directory(filename), shard_memory);
+}
+
+ShardedWriter ShardedWriter::create(std::unique_ptr<std::ostream>&& stream, const Metadata& md,
+                                    std::size_t shard_memory) {
+	return ShardedWriter(Writer::create(std::move(stream), md), temporary_directory(), shard_memory);
+}
+
+ShardedWriter::Shard& ShardedWriter::shard() {
+	std::lock_guard<std::mutex> lock(*mutex_);
+
+	shards_.push_back(std::make_unique<Shard>(spill_directory_, shard_memory_));
+	return *shards_.back();
+}
+
+std::unique_ptr<std::ostream> ShardedWriter::finalize() && {
+	using Record = Shard::Record;
+
+	for (auto& shard : shards_) {
+		// The producers usually write their records in order already
+		auto& records = shard->records_;
+		const auto by_sequence = [](const Record& a, const Record& b) { return a.sequence < b.sequence; };
+
+		if (!std::is_sorted(records.begin(), records.end(), by_sequence)) {
+			std::stable_sort(records.begin(), records.end(), by_sequence);
+		}
+	}
+
+	// Merge the shards: (sequence, shard, index of the record in the shard), smallest first
+	using Head = std::tuple<std::uint64_t, std::size_t, std::size_t>;
+	std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+
+	for (std::size_t i = 0; i < shards_.size(); ++i) {
+		if (!shards_[i]->records_.empty()) {
+			heads.emplace(shards_[i]->records_.front().sequence, i, 0);
+		}
+	}
+
+	auto& out = writer_.stream();
+	std::vector<char> scratch;
+
+	while (!heads.empty()) {
+		std::size_t shard_index;
+		std::size_t record_index;
+		std::tie(std::ignore, shard_index, record_index) = heads.top();
+		heads.pop();
+
+		auto& shard = *shards_[shard_index];
+		shard.copy(shard.records_[record_index], out, scratch);
+
+		if (record_index + 1 < shard.records_.size()) {
+			heads.emplace(shard.records_[record_index + 1].sequence, shard_index, record_index + 1);
+		}
+	}
+
+	shards_.clear();
+
+	auto stream = std::move(writer_).finalize();
+
+	if (!*stream) {
+		throw WriterError("Can't write the records");
+	}
+
+	return stream;
+}
+
+}} // namespace reven::binresource
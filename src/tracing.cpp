@@ -0,0 +1,105 @@
+#include "tracing.h"
+
+#include <cstdio>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace reven {
+namespace binresource {
+
+namespace {
+
+std::mutex tracer_mutex;
+std::shared_ptr<Tracer> global_tracer;
+
+void write_json_string(std::ostream& out, const char* str) {
+	out << '"';
+
+	for (; *str != '\0'; ++str) {
+		const char c = *str;
+
+		if (c == '"' || c == '\\') {
+			out << '\\' << c;
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			char escaped[8];
+			std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			out << escaped;
+		} else {
+			out << c;
+		}
+	}
+
+	out << '"';
+}
+
+} // anonymous namespace
+
+const char* trace_event_name(TraceEventType type) {
+	switch (type) {
+		case TraceEventType::ReaderOpen:
+			return "Reader::open";
+		case TraceEventType::WriterCreate:
+			return "Writer::create";
+		case TraceEventType::WriterOpen:
+			return "Writer::open";
+		case TraceEventType::WriterSetMetadata:
+			return "Writer::set_metadata";
+		case TraceEventType::Read:
+			return "read";
+		case TraceEventType::Write:
+			return "write";
+		case TraceEventType::Seek:
+			return "seek";
+		case TraceEventType::Flush:
+			return "flush";
+	}
+
+	return "unknown";
+}
+
+void set_tracer(std::shared_ptr<Tracer> tracer) {
+	std::lock_guard<std::mutex> lock(tracer_mutex);
+	global_tracer = std::move(tracer);
+}
+
+std::shared_ptr<Tracer> tracer() {
+	std::lock_guard<std::mutex> lock(tracer_mutex);
+	return global_tracer;
+}
+
+ChromeTraceSink::ChromeTraceSink(std::ostream& out) : out_(out) {
+	out_ << "[\n";
+}
+
+ChromeTraceSink::~ChromeTraceSink() {
+	out_ << "\n]\n";
+	out_.flush();
+}
+
+void ChromeTraceSink::begin(const TraceEvent&) {
+	// Complete events are written at the end, when the duration is known
+}
+
+void ChromeTraceSink::end(const TraceEvent& event) {
+	static const auto pid = ::getpid();
+	const auto tid = ::syscall(SYS_gettid);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	if (!first_) {
+		out_ << ",\n";
+	}
+	first_ = false;
+
+	// Timestamps are in microseconds
+	out_ << "{\"name\":\"" << trace_event_name(event.type) << "\",\"cat\":\"binresource\",\"ph\":\"X\""
+	     << ",\"ts\":" << event.timestamp_ns / 1000 << "." << event.timestamp_ns / 100 % 10
+	     << ",\"dur\":" << event.duration_ns / 1000 << "." << event.duration_ns / 100 % 10
+	     << ",\"pid\":" << pid << ",\"tid\":" << tid
+	     << ",\"args\":{\"path\":";
+	write_json_string(out_, event.path);
+	out_ << ",\"offset\":" << event.offset << ",\"size\":" << event.size << "}}";
+}
+
+}} // namespace reven::binresource
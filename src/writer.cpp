@@ -1,36 +1,220 @@
 #include "writer.h"
+#include "commit_journal.h"
 #include "common.h"
+#include "file_buf.h"
+#include "header_extension.h"
+#include "instrumented_buf.h"
+#include "mapped_buf.h"
+#include "pipe_buf.h"
+#include "reader.h"
 
-#include <fstream>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace reven {
 namespace binresource {
 
-Writer Writer::create(const char* filename, const Metadata& md) {
-	return Writer::create(std::make_unique<std::ofstream>(filename, std::ios::binary | std::ios::trunc), md);
+namespace {
+
+constexpr std::size_t max_header_size = detail::header_size(metadata_version);
+
+//! Open the file for writing and lock it until it is closed or unlocked, so that the readers following the file know
+//! it is being written. The truncation is done after the locking, so that the readers don't see an empty file as done.
+//! Throw if another writer holds the lock, even in the same process.
+int open_locked(const char* filename, int flags, bool truncate) {
+	const int fd = ::open(filename, flags | O_CLOEXEC, 0666);
+
+	if (fd < 0) {
+		return fd;
+	}
+
+	const bool locked = detail::lock_file(fd);
+
+	if (!locked && errno == EWOULDBLOCK) {
+		::close(fd);
+		throw WriterError("The resource is already being written");
+	}
+
+	if (!locked || (truncate && ::ftruncate(fd, 0) != 0)) {
+		::close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+//! Create and lock a new file next to `filename`, to be renamed to it once complete. `path` receives its filename.
+int create_temporary(const char* filename, std::string& path) {
+	static std::atomic<std::uint64_t> counter{0};
+
+	while (true) {
+		path = std::string(filename) + ".tmp." + std::to_string(::getpid()) + "." + std::to_string(counter++);
+
+		const int fd = open_locked(path.c_str(), O_RDWR | O_CREAT | O_EXCL, false);
+		if (fd >= 0 || errno != EEXIST) {
+			return fd;
+		}
+	}
+}
+
+} // anonymous namespace
+
+Writer Writer::create(const char* filename, const Metadata& md, const WriterOptions& options) {
+	std::string temporary_path;
+	const int fd = options.atomic ? create_temporary(filename, temporary_path)
+	                              : open_locked(filename, O_RDWR | O_CREAT, true);
+
+	auto stream = std::make_unique<detail::FileStream>(fd, options.buffer_size);
+	auto& buf = stream->buf();
+
+	if (fd >= 0 && options.atomic) {
+		buf.temporary(std::move(temporary_path));
+	}
+
+	Writer writer = Writer::do_create(std::move(stream), md, filename, buf.fd());
+	writer.apply_options(buf, options);
+
+	buf.hash_from(writer.md_size_);
+
+	return writer;
 }
 
 Writer Writer::create(std::unique_ptr<std::ostream>&& stream, const Metadata& md) {
-	Writer writer(std::move(stream));
+	return Writer::do_create(std::move(stream), md, "");
+}
+
+Writer Writer::create_streaming(int fd, const Metadata& md, std::size_t buffer_size) {
+	auto stream = std::make_unique<detail::PipeStream>(fd, buffer_size);
+	auto* pipe = &stream->buf();
+
+	Writer writer = Writer::do_create(std::move(stream), md, "", -1, true);
+	writer.pipe_ = pipe;
+	pipe->end_with_trailer();
+
+	return writer;
+}
+
+Writer Writer::do_create(std::unique_ptr<std::ostream>&& stream, const Metadata& md, const char* path, int fd,
+                         bool streaming) {
+	const auto tracer = binresource::tracer();
+	detail::TraceScope scope(tracer, TraceEventType::WriterCreate, path);
+
+	Writer writer(std::move(stream), streaming);
+	writer.path_ = path;
 
 	if (!*writer.stream_) {
 		throw WriterError("Bad stream");
 	}
 
-	writer.stream_->write(reinterpret_cast<const char*>(&magic), sizeof(magic));
-	writer.stream_->write(reinterpret_cast<const char*>(&metadata_version), sizeof(metadata_version));
-	writer.write_metadata(md);
+	// Only the resources created from a filename and the streaming ones use the extension. The others are written with
+	// the previous version of the header, so that the versions of the library older than the extension can read them.
+	writer.metadata_version_ = fd >= 0 || streaming ? metadata_version : detail::metadata_version_without_extension;
+	const auto header_size = detail::header_size(writer.metadata_version_);
+
+	// Write the whole header at once
+	char header[max_header_size];
+	detail::serialize_header(md, writer.metadata_version_, header);
+
+	if (streaming) {
+		detail::HeaderExtension extension;
+		extension.stream_trailer = true;
+		extension.serialize(header + detail::HeaderExtension::offset);
+	}
+
+	try {
+		if (fd >= 0) {
+			// Written directly so that the header is never pending in the buffer of the stream, where it would
+			// overwrite the updates of set_metadata when flushed. This costs a write per resource, as the header
+			// can't be batched with the first payload write anymore.
+			if (!detail::write_all(fd, header, header_size, 0)) {
+				writer.stream_->setstate(std::ios_base::badbit);
+			}
+			writer.stream_->seekp(header_size);
+		} else {
+			writer.stream_->write(header, header_size);
+		}
+	} catch (const std::ios_base::failure& e) {
+		throw WriterError((std::string("While writing metadata: IO error: ") + e.what()).c_str());
+	}
+
+	if (!*writer.stream_) {
+		throw WriterError("While writing metadata: Can't write the metadata");
+	}
 
 	writer.md_size_ = writer.stream_->tellp();
 
+	scope.set_size(writer.md_size_);
+	detail::trace(*writer.stream_, writer.instrumented_, tracer, path);
+
+	return writer;
+}
+
+Writer Writer::create_mapped(const char* filename, const Metadata& md, std::size_t growth) {
+	auto stream = std::make_unique<detail::MappedStream>(filename, growth);
+	auto* mapped = &stream->buf();
+
+	Writer writer = Writer::do_create(std::move(stream), md, filename);
+	writer.mapped_ = mapped;
+
 	return writer;
 }
 
-Writer Writer::open(const char* filename) {
-	return Writer::open(std::make_unique<std::fstream>(filename, std::ios::binary | std::ios::in | std::ios::out));
+Writer Writer::open(const char* filename, const WriterOptions& options) {
+	auto stream = std::make_unique<detail::FileStream>(open_locked(filename, O_RDWR, false), options.buffer_size);
+	auto& buf = stream->buf();
+
+	Writer writer = Writer::do_open(std::move(stream), filename);
+
+	if (detail::has_extension(writer.metadata_version_)) {
+		writer.open_extension(buf, options);
+	}
+
+	writer.apply_options(buf, options);
+
+	return writer;
+}
+
+void Writer::open_extension(detail::FileBuf& buf, const WriterOptions& options) {
+	char buffer[metadata_extension_size];
+	if (::pread(buf.fd(), buffer, sizeof(buffer), detail::HeaderExtension::offset) != sizeof(buffer)) {
+		throw WriterError("While reading metadata: Can't read enough data for the extension");
+	}
+
+	const auto extension = detail::HeaderExtension::deserialize(buffer);
+
+	// The payload is going to change
+	if (extension.has_content_hash && !detail::write_content_hash(buf.fd(), false, 0)) {
+		throw WriterError("While writing metadata: Can't write the extension");
+	}
+
+	// Drop what was written after the last commit, in case the previous writer crashed
+	if (extension.committed_size != 0) {
+		if (!detail::CommitJournal::recover(buf.fd(), md_size_, extension)) {
+			throw WriterError("The committed payload is missing or corrupted");
+		}
+
+		// Keep the journal up to date even if the commits aren't periodic anymore
+		buf.journal(std::make_unique<detail::CommitJournal>(buf.fd(), md_size_, options.commit_interval));
+	}
 }
 
 Writer Writer::open(std::unique_ptr<std::iostream>&& stream) {
+	return Writer::do_open(std::move(stream), "");
+}
+
+Writer Writer::do_open(std::unique_ptr<std::iostream>&& stream, const char* path) {
+	const auto tracer = binresource::tracer();
+	detail::TraceScope scope(tracer, TraceEventType::WriterOpen, path);
+
 	if (!*stream) {
 		throw WriterError("Bad stream");
 	}
@@ -56,12 +240,19 @@ Writer Writer::open(std::unique_ptr<std::iostream>&& stream) {
 		throw WriterError("Wrong magic");
 	}
 
-	if (metadata_version != ::reven::binresource::metadata_version) {
-		throw WriterError("Writer can't open resource with different metadata version than the current");
+	// The metadata of the previous version is a prefix of the current one: it can be updated the same way
+	if (metadata_version != ::reven::binresource::metadata_version &&
+	    metadata_version != detail::metadata_version_without_extension) {
+		throw WriterError("Writer can't open resource with this metadata version");
 	}
 
 	try {
 		const auto md = Metadata::deserialize(metadata_version, *stream);
+
+		// The payload is followed by the trailer of the stream
+		if (detail::HeaderExtension::of(md).stream_trailer) {
+			throw WriterError("The resource was sent by a streaming writer and can't be updated");
+		}
 	} catch (const MetadataError& e) {
 		throw WriterError((std::string("While reading metadata: ") + e.what()).c_str());
 	}
@@ -71,12 +262,318 @@ Writer Writer::open(std::unique_ptr<std::iostream>&& stream) {
 	Writer writer(std::move(stream));
 
 	writer.md_size_ = md_size;
+	writer.metadata_version_ = metadata_version;
+	writer.path_ = path;
 	writer.stream_->seekp(md_size);
 
+	scope.set_size(md_size);
+	detail::trace(*writer.stream_, writer.instrumented_, tracer, path);
+
 	return writer;
 }
 
+void Writer::restamp(const char* source, const char* destination, const Metadata& md, const WriterOptions& options) {
+	std::size_t source_md_size = 0;
+	detail::HeaderExtension source_extension;
+
+	try {
+		const auto reader = Reader::open(source);
+		source_md_size = reader.md_size();
+		source_extension = detail::HeaderExtension::of(reader.metadata());
+	} catch (const ReaderError& e) {
+		throw WriterError((std::string("While reading the resource: ") + e.what()).c_str());
+	}
+
+	const int in = ::open(source, O_RDONLY | O_CLOEXEC);
+
+	struct stat source_st;
+	if (in < 0 || ::fstat(in, &source_st) != 0 || static_cast<std::uint64_t>(source_st.st_size) < source_md_size) {
+		if (in >= 0) {
+			::close(in);
+		}
+		throw WriterError("Can't read the resource");
+	}
+
+	// The creation of the copy would truncate the source
+	struct stat destination_st;
+	if (::stat(destination, &destination_st) == 0 && destination_st.st_dev == source_st.st_dev &&
+	    destination_st.st_ino == source_st.st_ino) {
+		::close(in);
+		throw WriterError("The source and the destination are the same file");
+	}
+
+	const std::uint64_t payload_size = source_st.st_size - source_md_size;
+
+	bool ok = true;
+	std::unique_ptr<Writer> writer;
+
+	try {
+		writer = std::make_unique<Writer>(Writer::create(destination, md, options));
+	} catch (const WriterError&) {
+		::close(in);
+		throw;
+	}
+
+	const int out = writer->file_->fd();
+
+	bool cloned = false;
+	if (source_md_size == writer->md_size_) {
+		// Share all the extents of the source, then write the header again: only its blocks are copied on write
+		cloned = ::ioctl(out, FICLONE, in) == 0;
+
+		if (cloned) {
+			char header[max_header_size];
+			detail::serialize_header(md, writer->metadata_version_, header);
+			ok = detail::write_all(out, header, writer->md_size_, 0);
+		}
+	}
+
+	if (!cloned) {
+		ok = detail::copy_range(in, source_md_size, out, writer->md_size_, payload_size);
+	}
+
+	::close(in);
+
+	// The payload isn't written through the stream, but it is the same as the one of the source
+	writer->file_->stop_hashing();
+
+	if (ok && source_extension.has_content_hash) {
+		ok = detail::write_content_hash(out, true, source_extension.content_hash);
+	}
+
+	if (!ok) {
+		throw WriterError("Can't copy the payload");
+	}
+
+	writer->stream_->seekp(writer->md_size_ + payload_size);
+
+	const auto stream = std::move(*writer).finalize();
+
+	if (!*stream) {
+		throw WriterError("Can't write the resource");
+	}
+}
+
+void Writer::apply_options(detail::FileBuf& buf, const WriterOptions& options) {
+	file_ = &buf;
+
+	if (options.size_hint != 0) {
+		buf.preallocate(md_size_ + options.size_hint);
+	}
+
+	auto writeback_interval = options.writeback_interval;
+	if (options.durability == Durability::Periodic && writeback_interval == 0) {
+		writeback_interval = default_writeback_interval;
+	}
+
+	buf.pace_writeback(writeback_interval, options.drop_written_pages);
+	durability_ = options.durability;
+
+	if (options.commit_interval != 0 && detail::has_extension(metadata_version_)) {
+		buf.journal(std::make_unique<detail::CommitJournal>(buf.fd(), md_size_, options.commit_interval));
+	}
+}
+
+void Writer::commit() {
+	stream_->flush();
+
+	if (file_ == nullptr) {
+		return;
+	}
+
+	if (!file_->journaled() && detail::has_extension(metadata_version_)) {
+		file_->journal(std::make_unique<detail::CommitJournal>(file_->fd(), md_size_, 0));
+	}
+
+	// Without the extension, there is no room to record the committed size: the payload is only made durable
+	const bool ok = file_->journaled() ? file_->commit() : file_->datasync();
+
+	if (!ok) {
+		stream_->setstate(std::ios_base::badbit);
+		throw WriterError("Can't commit the payload");
+	}
+}
+
+std::unique_ptr<std::ostream> Writer::finalize() && {
+	stream_->flush();
+
+	if (file_ != nullptr && !complete()) {
+		stream_->setstate(std::ios_base::badbit);
+	}
+
+	if (pipe_ != nullptr && !pipe_->end_stream()) {
+		stream_->setstate(std::ios_base::badbit);
+	}
+
+	// Let the readers following the file know that it is complete
+	if (file_ != nullptr) {
+		detail::unlock_file(file_->fd());
+	}
+
+	// The instrumentation buffer is owned by the writer: don't leave it in the stream
+	detail::uninstrument(*stream_, instrumented_);
+
+	// The pack can go on with its next member
+	pack_member_.reset();
+
+	return std::move(stream_);
+}
+
+bool Writer::complete() {
+	if (!file_->commit()) {
+		return false;
+	}
+
+	if (!file_->store_content_hash()) {
+		return false;
+	}
+
+	const bool durable = durability_ != Durability::None;
+
+	if (durable && !file_->datasync()) {
+		return false;
+	}
+
+	// A temporary file that isn't published is removed with the stream
+	return !file_->is_temporary() || file_->publish(path_.c_str(), durable);
+}
+
+void Writer::write_vec(const ConstBuffer* buffers, std::size_t count) {
+	if (file_ == nullptr) {
+		for (std::size_t i = 0; i < count; ++i) {
+			stream_->write(static_cast<const char*>(buffers[i].data), buffers[i].size);
+		}
+
+		if (!*stream_) {
+			throw WriterError("Can't write the buffers");
+		}
+
+		return;
+	}
+
+	if (!*stream_) {
+		throw WriterError("Bad stream");
+	}
+
+	std::vector<struct iovec> iov(count);
+	std::uint64_t size = 0;
+	for (std::size_t i = 0; i < count; ++i) {
+		iov[i].iov_base = const_cast<void*>(buffers[i].data);
+		iov[i].iov_len = buffers[i].size;
+		size += buffers[i].size;
+	}
+
+	const auto offset = static_cast<std::uint64_t>(stream_->tellp());
+	const auto timestamp = detail::now_ns();
+
+	if (!file_->writev(iov.data(), count)) {
+		stream_->setstate(std::ios_base::badbit);
+		throw WriterError("Can't write the buffers");
+	}
+
+	if (instrumented_ != nullptr) {
+		instrumented_->record(IoOperation::Write, offset, size, timestamp);
+		instrumented_->moved(std::ios_base::out, size);
+	}
+}
+
+void Writer::write_at(std::uint64_t offset, const void* data, std::size_t size) {
+	if (streaming_) {
+		throw WriterError("Can't write at an offset of a streaming resource");
+	}
+
+	if (file_ == nullptr) {
+		std::lock_guard<std::mutex> lock(*write_at_mutex_);
+
+		const auto previous_pos = stream_->tellp();
+
+		stream_->seekp(md_size_ + offset);
+		stream_->write(static_cast<const char*>(data), size);
+		stream_->seekp(previous_pos);
+
+		if (!*stream_) {
+			throw WriterError("Can't write the data");
+		}
+
+		return;
+	}
+
+	const auto timestamp = detail::now_ns();
+
+	// The payload isn't written sequentially anymore
+	file_->stop_hashing();
+
+	if (!detail::write_all(file_->fd(), static_cast<const char*>(data), size, md_size_ + offset)) {
+		throw WriterError("Can't write the data");
+	}
+
+	file_->written_directly();
+
+	if (instrumented_ != nullptr) {
+		instrumented_->record(IoOperation::Write, md_size_ + offset, size, timestamp);
+	}
+}
+
+char* Writer::map(std::size_t size) {
+	if (mapped_ == nullptr) {
+		throw WriterError("Writer isn't memory-mapped");
+	}
+
+	char* data = mapped_->map(size);
+
+	if (data == nullptr) {
+		throw WriterError("Can't grow the mapped file");
+	}
+
+	if (instrumented_ != nullptr) {
+		instrumented_->moved(std::ios_base::out, size);
+	}
+
+	return data;
+}
+
+void Writer::instrument(std::shared_ptr<IoStats> stats) {
+	detail::instrument(*stream_, instrumented_, std::move(stats));
+}
+
+std::shared_ptr<IoStats> Writer::stats() const {
+	return instrumented_ != nullptr ? instrumented_->stats() : nullptr;
+}
+
 void Writer::set_metadata(const Metadata& md) {
+	// The header was already sent
+	if (streaming_) {
+		throw WriterError("Can't update the metadata of a streaming resource");
+	}
+
+	detail::TraceScope scope(binresource::tracer(), TraceEventType::WriterSetMetadata, path_.c_str(),
+	                         sizeof(magic) + sizeof(metadata_version));
+	scope.set_size(md_size_ - sizeof(magic) - sizeof(metadata_version));
+
+	int fd = -1;
+	if (file_ != nullptr) {
+		fd = file_->fd();
+	} else if (mapped_ != nullptr) {
+		fd = mapped_->fd();
+	}
+
+	if (fd >= 0) {
+		// A single positional write of the whole metadata doesn't use the position of the stream, so the payload can
+		// still be written concurrently, and the metadata is never seen half-updated.
+		// The extension is maintained by the writer itself and left as is.
+		char buffer[Metadata::serialized_size];
+		md.serialize(buffer);
+
+		if (!detail::write_all(fd, buffer, Metadata::serialized_size - metadata_extension_size,
+		                       sizeof(magic) + sizeof(metadata_version))) {
+			throw WriterError("While writing metadata: Can't write the metadata");
+		}
+
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(*write_at_mutex_);
+
 	const auto previous_pos = stream_->tellp();
 
 	stream_->seekp(sizeof(magic) + sizeof(metadata_version));
@@ -86,10 +583,18 @@ void Writer::set_metadata(const Metadata& md) {
 }
 
 void Writer::write_metadata(const Metadata& md) {
+	char buffer[Metadata::serialized_size];
+	md.serialize(buffer);
+
+	// The extension is maintained by the writer itself and left as is
 	try {
-		return md.serialize(*stream_);
-	} catch (const MetadataError& e) {
-		throw WriterError((std::string("While writing metadata: ") + e.what()).c_str());
+		stream_->write(buffer, Metadata::serialized_size - metadata_extension_size);
+	} catch (const std::ios_base::failure& e) {
+		throw WriterError((std::string("While writing metadata: IO error: ") + e.what()).c_str());
+	}
+
+	if (!*stream_) {
+		throw WriterError("While writing metadata: Can't write the metadata");
 	}
 }
 
@@ -0,0 +1,197 @@
+#define BOOST_TEST_MODULE RVN_BINRESOURCE_CONCURRENT_WRITER
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "concurrent_writer.h"
+#include "metadata.h"
+#include "reader.h"
+
+using MD = reven::binresource::Metadata;
+using Reader = reven::binresource::Reader;
+using ConcurrentWriter = reven::binresource::ConcurrentWriter;
+
+class TestMDWriter : reven::binresource::MetadataWriter {
+public:
+	static MD dummy_md() {
+		return write(42, "1.0.0-dummy", "TestMetaDataWriter", "1.0.0", "Tests version 1.0.0", 42424242);
+	}
+
+	static MD dummy_md2() {
+		return write(24, "1.2.0-dummy", "TestMetaDataWriter2", "1.2.0", "Tests version 1.2.0", 42424243);
+	}
+};
+
+struct transient_directory {
+	//! Path of created directory.
+	boost::filesystem::path path;
+
+	//! Create a uniquely named temporary directory in base_dir.
+	//! A suffix is generated and appended to the given prefix to ensure the directory name is unique.
+	//! Throw if directory cannot be created.
+	transient_directory(const boost::filesystem::path& base_dir = boost::filesystem::temp_directory_path(),
+	                    std::string prefix = {}) {
+		boost::filesystem::path tmp_path = boost::filesystem::unique_path(prefix + "%%%%-%%%%-%%%%-%%%%");
+		tmp_path = base_dir / tmp_path;
+
+		if (!boost::filesystem::create_directories(tmp_path)) {
+			throw std::runtime_error(("Can't create the directory " + tmp_path.native()).c_str());
+		}
+
+		this->path = tmp_path;
+	}
+
+	//! Delete created directory.
+	~transient_directory() {
+		boost::filesystem::remove_all(this->path);
+	}
+};
+
+// Chunk `i` is filled with the value `i`
+std::vector<std::uint64_t> chunk(std::uint64_t i, std::size_t size) {
+	return std::vector<std::uint64_t>(size, i);
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_append)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	constexpr std::size_t thread_count = 8;
+	constexpr std::size_t chunks_per_thread = 100;
+	constexpr std::size_t chunk_size = 512;
+
+	// Offset in the payload of each chunk
+	std::vector<std::uint64_t> offsets(thread_count * chunks_per_thread);
+
+	reven::binresource::WriterOptions options;
+	options.size_hint = 2 * offsets.size() * chunk_size * sizeof(std::uint64_t);
+
+	auto writer = ConcurrentWriter::create(tmp_file.c_str(), TestMDWriter::dummy_md(), options);
+
+	std::vector<std::thread> threads;
+	for (std::size_t t = 0; t < thread_count; ++t) {
+		threads.emplace_back([&, t]() {
+			for (std::size_t i = t * chunks_per_thread; i < (t + 1) * chunks_per_thread; ++i) {
+				const auto data = chunk(i, chunk_size);
+				offsets[i] = writer.append(data.data(), data.size() * sizeof(std::uint64_t));
+			}
+		});
+	}
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	const auto md_size = writer.md_size();
+	BOOST_CHECK_EQUAL(writer.size(), offsets.size() * chunk_size * sizeof(std::uint64_t));
+
+	std::move(writer).finalize();
+
+	BOOST_CHECK_EQUAL(boost::filesystem::file_size(tmp_file),
+	                  md_size + offsets.size() * chunk_size * sizeof(std::uint64_t));
+
+	auto reader = Reader::open(tmp_file.c_str());
+
+	BOOST_CHECK_EQUAL(reader.md_size(), md_size);
+	BOOST_CHECK_EQUAL(reader.metadata().tool_info(), TestMDWriter::dummy_md().tool_info());
+
+	for (std::size_t i = 0; i < offsets.size(); ++i) {
+		std::vector<std::uint64_t> data(chunk_size);
+		const reven::binresource::MutableBuffer buffer{data.data(), data.size() * sizeof(std::uint64_t)};
+		BOOST_REQUIRE_EQUAL(reader.read_vec(offsets[i], &buffer, 1), buffer.size);
+		BOOST_REQUIRE(data == chunk(i, chunk_size));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_reserve_out_of_order)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	auto writer = ConcurrentWriter::create(tmp_file.c_str(), TestMDWriter::dummy_md());
+
+	const auto first = writer.reserve(sizeof(std::uint64_t));
+	const auto second = writer.reserve(sizeof(std::uint64_t));
+
+	BOOST_CHECK_EQUAL(first, 0);
+	BOOST_CHECK_EQUAL(second, sizeof(std::uint64_t));
+
+	const std::uint64_t values[] = {1, 2};
+
+	// The finalization waits for the first range, written last
+	std::thread late_writer([&]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		writer.write(first, &values[0], sizeof(values[0]));
+	});
+
+	writer.write(second, &values[1], sizeof(values[1]));
+	writer.set_metadata(TestMDWriter::dummy_md2());
+
+	std::move(writer).finalize();
+	late_writer.join();
+
+	auto reader = Reader::open(tmp_file.c_str());
+
+	BOOST_CHECK_EQUAL(reader.metadata().tool_info(), TestMDWriter::dummy_md2().tool_info());
+
+	std::uint64_t read_values[2] = {0, 0};
+	reader.stream().read(reinterpret_cast<char*>(read_values), sizeof(read_values));
+	BOOST_CHECK_EQUAL(read_values[0], values[0]);
+	BOOST_CHECK_EQUAL(read_values[1], values[1]);
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_range_never_written)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	// The producer of the first range failed: the finalization gives up instead of waiting forever
+	{
+		auto writer = ConcurrentWriter::create(tmp_file.c_str(), TestMDWriter::dummy_md());
+
+		writer.reserve(3);
+		writer.append("bar", 3);
+
+		BOOST_CHECK_THROW(std::move(writer).finalize(std::chrono::milliseconds(50)), reven::binresource::WriterError);
+	}
+
+	// And the destruction doesn't wait at all
+	const auto begin = std::chrono::steady_clock::now();
+
+	{
+		auto writer = ConcurrentWriter::create(tmp_file.c_str(), TestMDWriter::dummy_md());
+		writer.reserve(3);
+	}
+
+	BOOST_CHECK(std::chrono::steady_clock::now() - begin < reven::binresource::default_finalize_timeout);
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_move)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	auto writer = ConcurrentWriter::create(tmp_file.c_str(), TestMDWriter::dummy_md());
+	auto other = std::move(writer);
+
+	const auto md_size = other.md_size();
+
+	other.append("foo", 3);
+	std::move(other).finalize();
+
+	BOOST_CHECK_EQUAL(boost::filesystem::file_size(tmp_file), md_size + 3);
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_create_failed)
+{
+	BOOST_CHECK_THROW(ConcurrentWriter::create("/nonexistent/foo.bin", TestMDWriter::dummy_md()),
+	                  reven::binresource::WriterError);
+}
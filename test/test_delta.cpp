@@ -0,0 +1,171 @@
+#define BOOST_TEST_MODULE RVN_BINRESOURCE_DELTA
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include <sstream>
+#include <vector>
+
+#include "delta.h"
+#include "metadata.h"
+#include "reader.h"
+#include "writer.h"
+
+using MD = reven::binresource::Metadata;
+using Reader = reven::binresource::Reader;
+using Writer = reven::binresource::Writer;
+using Signature = reven::binresource::Signature;
+using DeltaError = reven::binresource::DeltaError;
+
+class TestMDWriter : reven::binresource::MetadataWriter {
+public:
+	static MD dummy_md() {
+		return write(42, "1.0.0-dummy", "TestMetaDataWriter", "1.0.0", "Tests version 1.0.0", 42424242);
+	}
+
+	static MD dummy_md2() {
+		return write(24, "1.2.0-dummy", "TestMetaDataWriter2", "1.2.0", "Tests version 1.2.0", 42424243);
+	}
+
+	//! Same type as dummy_md
+	static MD dummy_md3() {
+		return write(42, "1.0.0-dummy", "TestMetaDataWriter", "1.1.0", "Tests version 1.1.0", 42424244);
+	}
+};
+struct transient_directory {
+	//! Path of created directory.
+	boost::filesystem::path path;
+
+	//! Create a uniquely named temporary directory in base_dir.
+	//! A suffix is generated and appended to the given prefix to ensure the directory name is unique.
+	//! Throw if directory cannot be created.
+	transient_directory(const boost::filesystem::path& base_dir = boost::filesystem::temp_directory_path(),
+	                    std::string prefix = {}) {
+		boost::filesystem::path tmp_path = boost::filesystem::unique_path(prefix + "%%%%-%%%%-%%%%-%%%%");
+		tmp_path = base_dir / tmp_path;
+
+		if (!boost::filesystem::create_directories(tmp_path)) {
+			throw std::runtime_error(("Can't create the directory " + tmp_path.native()).c_str());
+		}
+
+		this->path = tmp_path;
+	}
+
+	//! Delete created directory.
+	~transient_directory() {
+		boost::filesystem::remove_all(this->path);
+	}
+};
+
+
+constexpr std::size_t block_size = 4096;
+
+void write_values(const boost::filesystem::path& path, const MD& md, const std::vector<std::uint64_t>& values) {
+	auto writer = Writer::create(path.c_str(), md);
+	writer.stream().write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(std::uint64_t));
+}
+
+std::vector<std::uint64_t> read_values(const boost::filesystem::path& path) {
+	auto reader = Reader::open(path.c_str());
+
+	std::vector<std::uint64_t> values;
+	std::uint64_t value = 0;
+	while (reader.stream().read(reinterpret_cast<char*>(&value), sizeof(value))) {
+		values.push_back(value);
+	}
+
+	return values;
+}
+
+std::vector<std::uint64_t> base_values() {
+	std::vector<std::uint64_t> values(100000);
+	for (std::uint64_t i = 0; i < values.size(); ++i) {
+		values[i] = i * 0x9e3779b97f4a7c15;
+	}
+
+	return values;
+}
+
+BOOST_AUTO_TEST_CASE(delta_make_apply)
+{
+	transient_directory tmp_dir{};
+
+	const auto base_file = tmp_dir.path / "base.bin";
+	const auto new_file = tmp_dir.path / "new.bin";
+	const auto patched_file = tmp_dir.path / "patched.bin";
+
+	auto values = base_values();
+	write_values(base_file, TestMDWriter::dummy_md(), values);
+
+	// A few values changed, a block moved to the beginning and some values appended
+	values[50000] = 0;
+	values[50001] = 1;
+	values.insert(values.begin(), values.begin() + 512 * 10, values.begin() + 512 * 11);
+	values.resize(values.size() + 1000, 42);
+	write_values(new_file, TestMDWriter::dummy_md3(), values);
+
+	// The signature is sent to where the new version is
+	std::stringstream signature_stream;
+	Signature::compute(base_file.c_str(), block_size).serialize(signature_stream);
+	const auto signature = Signature::deserialize(signature_stream);
+
+	BOOST_CHECK_EQUAL(signature.type(), TestMDWriter::dummy_md().type());
+	BOOST_CHECK_EQUAL(signature.payload_size(), base_values().size() * sizeof(std::uint64_t));
+
+	std::stringstream delta;
+	const auto stats = reven::binresource::make_delta(signature, new_file.c_str(), delta);
+
+	BOOST_CHECK_EQUAL(stats.copied_size + stats.literal_size, values.size() * sizeof(std::uint64_t));
+	BOOST_CHECK(stats.literal_size < 4 * block_size);
+	BOOST_CHECK(delta.str().size() < 8 * block_size);
+
+	reven::binresource::apply_delta(base_file.c_str(), delta, patched_file.c_str());
+
+	auto reader = Reader::open(patched_file.c_str());
+	BOOST_CHECK_EQUAL(reader.metadata().tool_version(), TestMDWriter::dummy_md3().tool_version());
+	BOOST_CHECK_EQUAL(reader.content_hash(), Reader::open(new_file.c_str()).content_hash());
+
+	BOOST_CHECK(read_values(patched_file) == values);
+
+	// The base resource can be patched in place
+	delta.clear();
+	delta.seekg(0);
+	reven::binresource::apply_delta(base_file.c_str(), delta, base_file.c_str());
+
+	BOOST_CHECK(read_values(base_file) == values);
+}
+
+BOOST_AUTO_TEST_CASE(delta_mismatch)
+{
+	transient_directory tmp_dir{};
+
+	const auto base_file = tmp_dir.path / "base.bin";
+	const auto new_file = tmp_dir.path / "new.bin";
+	const auto patched_file = tmp_dir.path / "patched.bin";
+
+	auto values = base_values();
+	write_values(base_file, TestMDWriter::dummy_md(), values);
+	write_values(new_file, TestMDWriter::dummy_md2(), values);
+
+	const auto signature = Signature::compute(base_file.c_str(), block_size);
+
+	// Different types
+	std::stringstream delta;
+	BOOST_CHECK_THROW(reven::binresource::make_delta(signature, new_file.c_str(), delta), DeltaError);
+
+	values[10] = 0;
+	write_values(new_file, TestMDWriter::dummy_md(), values);
+
+	delta.str("");
+	reven::binresource::make_delta(signature, new_file.c_str(), delta);
+
+	// The base resource changed since its signature was computed
+	values[20000] = 0;
+	write_values(base_file, TestMDWriter::dummy_md(), values);
+
+	BOOST_CHECK_THROW(reven::binresource::apply_delta(base_file.c_str(), delta, patched_file.c_str()), DeltaError);
+
+	// Nothing is left of the new version
+	BOOST_CHECK(!boost::filesystem::exists(patched_file));
+	BOOST_CHECK_EQUAL(std::distance(boost::filesystem::directory_iterator(tmp_dir.path),
+	                                boost::filesystem::directory_iterator()), 2);
+}
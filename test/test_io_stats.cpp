@@ -0,0 +1,102 @@
+#define BOOST_TEST_MODULE RVN_BINRESOURCE_IO_STATS
+#include <boost/test/unit_test.hpp>
+
+#include <sstream>
+
+#include "common.h"
+#include "io_stats.h"
+#include "metadata.h"
+#include "reader.h"
+#include "writer.h"
+
+using MD = reven::binresource::Metadata;
+using Reader = reven::binresource::Reader;
+using Writer = reven::binresource::Writer;
+using IoStats = reven::binresource::IoStats;
+using IoOperation = reven::binresource::IoOperation;
+using LatencyHistogram = reven::binresource::LatencyHistogram;
+
+class TestMDWriter : reven::binresource::MetadataWriter {
+public:
+	static MD dummy_md() {
+		return write(42, "1.0.0-dummy", "TestMetaDataWriter", "1.0.0", "Tests version 1.0.0", 42424242);
+	}
+};
+
+constexpr std::uint64_t foo = 0x42424242424242;
+
+BOOST_AUTO_TEST_CASE(histogram)
+{
+	LatencyHistogram histogram;
+
+	histogram.record(0);
+	histogram.record(1);
+	histogram.record(3);
+	histogram.record(1000);
+
+	BOOST_CHECK_EQUAL(histogram.count(), 4);
+	BOOST_CHECK_EQUAL(histogram.bucket(0), 2);
+	BOOST_CHECK_EQUAL(histogram.bucket(1), 1);
+	BOOST_CHECK_EQUAL(histogram.bucket(9), 1);
+
+	BOOST_CHECK_EQUAL(histogram.percentile(50), 4);
+	BOOST_CHECK_EQUAL(histogram.percentile(100), 1024);
+
+	histogram.reset();
+	BOOST_CHECK_EQUAL(histogram.count(), 0);
+	BOOST_CHECK_EQUAL(histogram.percentile(50), 0);
+}
+
+BOOST_AUTO_TEST_CASE(instrument_writer_reader)
+{
+	auto stats = std::make_shared<IoStats>();
+
+	auto writer = Writer::create(std::make_unique<std::stringstream>(), TestMDWriter::dummy_md());
+	writer.instrument(stats);
+	BOOST_CHECK_EQUAL(writer.stats(), stats);
+
+	writer.stream().write(reinterpret_cast<const char*>(&foo), sizeof(foo));
+	writer.stream().write(reinterpret_cast<const char*>(&foo), sizeof(foo));
+	writer.stream().seekp(writer.md_size());
+	writer.stream().write(reinterpret_cast<const char*>(&foo), sizeof(foo));
+
+	BOOST_CHECK_EQUAL(stats->calls(IoOperation::Write), 3);
+	BOOST_CHECK_EQUAL(stats->bytes(IoOperation::Write), 3 * sizeof(foo));
+	BOOST_CHECK_EQUAL(stats->calls(IoOperation::Seek), 1);
+	BOOST_CHECK_EQUAL(stats->latency(IoOperation::Write).count(), 3);
+
+	auto stream = std::unique_ptr<std::stringstream>(static_cast<std::stringstream*>(std::move(writer).finalize().release()));
+	// The stream got its own buffer back
+	BOOST_CHECK(dynamic_cast<std::stringbuf*>(static_cast<std::ostream&>(*stream).rdbuf()) != nullptr);
+	BOOST_CHECK_EQUAL(stats->calls(IoOperation::Flush), 1);
+
+	stream->seekg(0);
+	auto reader = Reader::open(std::move(stream));
+	BOOST_CHECK(reader.stats() == nullptr);
+
+	stats->reset();
+	BOOST_CHECK_EQUAL(stats->calls(IoOperation::Write), 0);
+
+	reader.instrument(stats);
+
+	std::uint64_t bar = 0;
+	reader.stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+	BOOST_CHECK_EQUAL(foo, bar);
+	reader.stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+	BOOST_CHECK_EQUAL(foo, bar);
+	reader.stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+	BOOST_CHECK(reader.stream().eof());
+
+	BOOST_CHECK_EQUAL(stats->calls(IoOperation::Read), 3);
+	BOOST_CHECK_EQUAL(stats->bytes(IoOperation::Read), 2 * sizeof(foo));
+
+	std::stringstream dump;
+	stats->dump(dump);
+	BOOST_CHECK(dump.str().find("read   calls: 3 bytes: 16") != std::string::npos);
+
+	// Stopping the instrumentation keeps the state of the stream
+	reader.instrument(nullptr);
+	BOOST_CHECK(reader.stats() == nullptr);
+	BOOST_CHECK(reader.stream().eof());
+	BOOST_CHECK_EQUAL(stats->calls(IoOperation::Read), 3);
+}
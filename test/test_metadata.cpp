@@ -54,6 +54,45 @@ BOOST_AUTO_TEST_CASE(serialize_deserialize)
 	BOOST_CHECK_EQUAL(md.generation_date(), md2.generation_date());
 }
 
+BOOST_AUTO_TEST_CASE(serialize_deserialize_v1)
+{
+	const auto md = TestMDWriter::dummy_md();
+
+	std::stringstream stream;
+	md.serialize(1, stream);
+
+	BOOST_CHECK_EQUAL(stream.str().size(), MD::serialized_size - reven::binresource::metadata_extension_size);
+
+	const auto md2 = MD::deserialize(1, stream);
+
+	BOOST_CHECK_EQUAL(md.type(), md2.type());
+	BOOST_CHECK_EQUAL(md.format_version(), md2.format_version());
+	BOOST_CHECK_EQUAL(md.tool_name(), md2.tool_name());
+	BOOST_CHECK_EQUAL(md.tool_version(), md2.tool_version());
+	BOOST_CHECK_EQUAL(md.tool_info(), md2.tool_info());
+	BOOST_CHECK_EQUAL(md.generation_date(), md2.generation_date());
+	BOOST_CHECK_EQUAL(stream.peek(), std::char_traits<char>::eof());
+
+	BOOST_CHECK_THROW(md.serialize(0, stream), reven::binresource::WriteMetadataError);
+	BOOST_CHECK_THROW(md.serialize(reven::binresource::metadata_version + 1, stream),
+	                  reven::binresource::WriteMetadataError);
+}
+
+BOOST_AUTO_TEST_CASE(serialized_size)
+{
+	const auto md = TestMDWriter::dummy_md();
+
+	std::stringstream stream;
+	md.serialize(stream);
+
+	BOOST_CHECK_EQUAL(stream.str().size(), MD::serialized_size);
+
+	std::string buffer(MD::serialized_size, '\xff');
+	md.serialize(&buffer[0]);
+
+	BOOST_CHECK(buffer == stream.str());
+}
+
 BOOST_AUTO_TEST_CASE(serialize_failed_stream)
 {
 	std::stringstream stream;
@@ -277,6 +316,21 @@ void test_bad_format(std::uint32_t metadata_version) {
 	const std::uint64_t generation_date = 0x42424242424242;
 	stream.write(reinterpret_cast<const char*>(&generation_date), sizeof(generation_date));
 
+	///////////////////////////
+	// EXTENSION
+	///////////////////////////
+
+	if (metadata_version >= 2) {
+		// Can't read enough data for the extension
+		BOOST_CHECK_THROW(MD::deserialize(metadata_version, stream), reven::binresource::ReadMetadataError);
+		stream.clear();
+		stream.seekg(0, std::ios_base::beg);
+		stream.seekp(0, std::ios_base::end);
+
+		const char extension[reven::binresource::metadata_extension_size] = {'\0'};
+		stream.write(extension, sizeof(extension));
+	}
+
 	auto md = MD::deserialize(metadata_version, stream);
 
 	BOOST_CHECK_EQUAL(md.type(), type);
@@ -303,6 +357,11 @@ BOOST_AUTO_TEST_CASE(deserialize_bad_format_v1)
 	test_bad_format(1);
 }
 
+BOOST_AUTO_TEST_CASE(deserialize_bad_format_v2)
+{
+	test_bad_format(2);
+}
+
 BOOST_AUTO_TEST_CASE(format_version_too_long)
 {
 	BOOST_CHECK_THROW(TestMDWriter::format_version_too_long(), reven::binresource::WriteMetadataError);
@@ -0,0 +1,398 @@
+#define BOOST_TEST_MODULE RVN_BINRESOURCE_PACK
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "metadata.h"
+#include "pack.h"
+#include "reader.h"
+#include "writer.h"
+
+using MD = reven::binresource::Metadata;
+using PackReader = reven::binresource::PackReader;
+using PackWriter = reven::binresource::PackWriter;
+using Reader = reven::binresource::Reader;
+using Writer = reven::binresource::Writer;
+
+class TestMDWriter : reven::binresource::MetadataWriter {
+public:
+	static MD dummy_md() {
+		return write(42, "1.0.0-dummy", "TestMetaDataWriter", "1.0.0", "Tests version 1.0.0", 42424242);
+	}
+
+	static MD dummy_md2() {
+		return write(24, "1.2.0-dummy", "TestMetaDataWriter2", "1.2.0", "Tests version 1.2.0", 42424243);
+	}
+};
+
+struct transient_directory {
+	//! Path of created directory.
+	boost::filesystem::path path;
+
+	//! Create a uniquely named temporary directory in base_dir.
+	//! A suffix is generated and appended to the given prefix to ensure the directory name is unique.
+	//! Throw if directory cannot be created.
+	transient_directory(const boost::filesystem::path& base_dir = boost::filesystem::temp_directory_path(),
+	                    std::string prefix = {}) {
+		boost::filesystem::path tmp_path = boost::filesystem::unique_path(prefix + "%%%%-%%%%-%%%%-%%%%");
+		tmp_path = base_dir / tmp_path;
+
+		if (!boost::filesystem::create_directories(tmp_path)) {
+			throw std::runtime_error(("Can't create the directory " + tmp_path.native()).c_str());
+		}
+
+		this->path = tmp_path;
+	}
+
+	//! Delete created directory.
+	~transient_directory() {
+		boost::filesystem::remove_all(this->path);
+	}
+};
+
+
+constexpr std::uint64_t member_count = 1000;
+
+std::string member_name(std::uint64_t i) {
+	return "member-" + std::to_string(i);
+}
+
+// The member `i` is `i % 32` copies of `i`
+void write_member(Writer& writer, std::uint64_t i) {
+	for (std::uint64_t j = 0; j < i % 32; ++j) {
+		writer.stream().write(reinterpret_cast<const char*>(&i), sizeof(i));
+	}
+}
+
+void check_member(Reader& reader, std::uint64_t i) {
+	std::uint64_t count = 0;
+	std::uint64_t value = 0;
+
+	while (reader.stream().read(reinterpret_cast<char*>(&value), sizeof(value))) {
+		BOOST_REQUIRE_EQUAL(value, i);
+		++count;
+	}
+
+	// The reading stops at the end of the member
+	BOOST_CHECK_EQUAL(reader.stream().gcount(), 0);
+	BOOST_CHECK_EQUAL(count, i % 32);
+}
+
+BOOST_AUTO_TEST_CASE(pack_write_read)
+{
+	transient_directory tmp_dir{};
+
+	const auto pack_file = tmp_dir.path / "foo.pack";
+	const auto resource_file = tmp_dir.path / "bar.bin";
+
+	{
+		auto writer = Writer::create(resource_file.c_str(), TestMDWriter::dummy_md2());
+		write_member(writer, 31);
+	}
+
+	{
+		auto pack = PackWriter::create(pack_file.c_str());
+
+		// Added in reverse order of the names
+		for (std::uint64_t i = member_count; i-- > 0;) {
+			auto writer = pack.add(member_name(i).c_str(), TestMDWriter::dummy_md());
+			write_member(writer, i);
+		}
+
+		pack.add("bar", resource_file.c_str());
+
+		BOOST_CHECK_EQUAL(pack.member_count(), member_count + 1);
+
+		std::move(pack).finalize();
+	}
+
+	auto pack = PackReader::open(pack_file.c_str());
+
+	BOOST_REQUIRE_EQUAL(pack.member_count(), member_count + 1);
+
+	for (std::size_t i = 1; i < pack.member_count(); ++i) {
+		BOOST_CHECK(pack.name(i - 1) < pack.name(i));
+	}
+
+	for (std::uint64_t i = 0; i < member_count; ++i) {
+		const auto index = pack.find(member_name(i).c_str());
+		BOOST_REQUIRE(index != PackReader::npos);
+		BOOST_CHECK_EQUAL(pack.name(index), member_name(i));
+
+		auto reader = pack.open_member(index);
+		BOOST_CHECK_EQUAL(reader.metadata().tool_name(), TestMDWriter::dummy_md().tool_name());
+		BOOST_CHECK_EQUAL(pack.member_size(index), reader.md_size() + (i % 32) * sizeof(std::uint64_t));
+		check_member(reader, i);
+	}
+
+	auto reader = pack.open_member("bar");
+	BOOST_CHECK_EQUAL(reader.metadata().tool_name(), TestMDWriter::dummy_md2().tool_name());
+	check_member(reader, 31);
+
+	BOOST_CHECK(pack.find("baz") == PackReader::npos);
+	BOOST_CHECK_THROW(pack.open_member("baz"), reven::binresource::ReaderError);
+}
+
+BOOST_AUTO_TEST_CASE(pack_member_set_metadata)
+{
+	transient_directory tmp_dir{};
+
+	const auto pack_file = tmp_dir.path / "foo.pack";
+
+	{
+		auto pack = PackWriter::create(pack_file.c_str());
+
+		{
+			auto writer = pack.add("foo", TestMDWriter::dummy_md());
+			write_member(writer, 7);
+			writer.set_metadata(TestMDWriter::dummy_md2());
+		}
+
+		auto writer = pack.add("bar", TestMDWriter::dummy_md());
+		write_member(writer, 3);
+		std::move(writer).finalize();
+
+		BOOST_CHECK_THROW(pack.add("foo", TestMDWriter::dummy_md()), reven::binresource::WriterError);
+
+		std::move(pack).finalize();
+	}
+
+	auto pack = PackReader::open(pack_file.c_str());
+	BOOST_REQUIRE_EQUAL(pack.member_count(), 2);
+
+	auto foo = pack.open_member("foo");
+	BOOST_CHECK_EQUAL(foo.metadata().tool_name(), TestMDWriter::dummy_md2().tool_name());
+	check_member(foo, 7);
+
+	auto bar = pack.open_member("bar");
+	BOOST_CHECK_EQUAL(bar.metadata().tool_name(), TestMDWriter::dummy_md().tool_name());
+	check_member(bar, 3);
+}
+
+BOOST_AUTO_TEST_CASE(pack_not_finalized)
+{
+	transient_directory tmp_dir{};
+
+	const auto pack_file = tmp_dir.path / "foo.pack";
+
+	{
+		auto pack = PackWriter::create(pack_file.c_str());
+		auto writer = pack.add("foo", TestMDWriter::dummy_md());
+		write_member(writer, 7);
+	}
+
+	BOOST_CHECK_THROW(PackReader::open(pack_file.c_str()), reven::binresource::ReaderError);
+}
+
+BOOST_AUTO_TEST_CASE(pack_abandoned_update)
+{
+	transient_directory tmp_dir{};
+
+	const auto pack_file = tmp_dir.path / "foo.pack";
+
+	{
+		auto pack = PackWriter::create(pack_file.c_str());
+
+		for (std::uint64_t i = 0; i < 10; ++i) {
+			auto writer = pack.add(member_name(i).c_str(), TestMDWriter::dummy_md());
+			write_member(writer, i);
+		}
+
+		std::move(pack).finalize();
+	}
+
+	// Abandoned after appending members larger than a read of the reader looking for the previous directory
+	{
+		auto pack = PackWriter::open(pack_file.c_str());
+
+		auto writer = pack.replace(member_name(1).c_str(), TestMDWriter::dummy_md());
+		// Full of bytes looking like the end of a trailer
+		const auto magic = reven::binresource::pack_magic;
+		for (std::uint64_t i = 0; i < 100000; ++i) {
+			writer.stream().write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+		}
+		std::move(writer).finalize();
+
+		auto other = pack.add(member_name(10).c_str(), TestMDWriter::dummy_md());
+		write_member(other, 10);
+	}
+
+	{
+		auto pack = PackReader::open(pack_file.c_str());
+
+		BOOST_REQUIRE_EQUAL(pack.member_count(), 10);
+		BOOST_CHECK(pack.find(member_name(10).c_str()) == PackReader::npos);
+
+		for (std::uint64_t i = 0; i < 10; ++i) {
+			auto reader = pack.open_member(member_name(i).c_str());
+			check_member(reader, i);
+		}
+	}
+
+	// The abandoned members are dead space
+	{
+		auto pack = PackWriter::open(pack_file.c_str());
+		auto writer = pack.add(member_name(10).c_str(), TestMDWriter::dummy_md());
+		write_member(writer, 10);
+		std::move(writer).finalize();
+		std::move(pack).finalize();
+	}
+
+	auto pack = PackReader::open(pack_file.c_str());
+
+	BOOST_REQUIRE_EQUAL(pack.member_count(), 11);
+	BOOST_CHECK(pack.dead_size() > 100000 * sizeof(std::uint64_t));
+
+	for (std::uint64_t i = 0; i <= 10; ++i) {
+		auto reader = pack.open_member(member_name(i).c_str());
+		check_member(reader, i);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(pack_exclusive_writers)
+{
+	transient_directory tmp_dir{};
+
+	const auto pack_file = tmp_dir.path / "foo.pack";
+	const auto resource_file = tmp_dir.path / "bar.bin";
+
+	{
+		auto writer = Writer::create(resource_file.c_str(), TestMDWriter::dummy_md2());
+		write_member(writer, 13);
+	}
+
+	{
+		auto pack = PackWriter::create(pack_file.c_str());
+		pack.add(member_name(0).c_str(), resource_file.c_str());
+		std::move(pack).finalize();
+	}
+
+	{
+		auto pack = PackWriter::open(pack_file.c_str());
+
+		// The concurrent updates of the pack fail, and leave it untouched
+		BOOST_CHECK_THROW(PackWriter::open(pack_file.c_str()), reven::binresource::WriterError);
+		BOOST_CHECK_THROW(PackWriter::create(pack_file.c_str()), reven::binresource::WriterError);
+		BOOST_CHECK_THROW(PackWriter::compact(pack_file.c_str()), reven::binresource::WriterError);
+		BOOST_CHECK_EQUAL(PackReader::open(pack_file.c_str()).member_count(), 1);
+
+		// A single member is written at a time
+		auto writer = pack.add(member_name(1).c_str(), TestMDWriter::dummy_md());
+		write_member(writer, 1);
+
+		BOOST_CHECK_THROW(pack.add(member_name(2).c_str(), TestMDWriter::dummy_md()), reven::binresource::WriterError);
+		BOOST_CHECK_THROW(pack.add(member_name(2).c_str(), resource_file.c_str()), reven::binresource::WriterError);
+		BOOST_CHECK_THROW(pack.remove(member_name(0).c_str()), reven::binresource::WriterError);
+
+		write_member(writer, 1);
+		std::move(writer).finalize();
+
+		pack.add(member_name(2).c_str(), resource_file.c_str());
+		std::move(pack).finalize();
+	}
+
+	auto pack = PackReader::open(pack_file.c_str());
+	BOOST_REQUIRE_EQUAL(pack.member_count(), 3);
+
+	auto reader = pack.open_member(member_name(1).c_str());
+	std::uint64_t value = 0;
+	for (std::uint64_t i = 0; i < 2; ++i) {
+		BOOST_CHECK(reader.stream().read(reinterpret_cast<char*>(&value), sizeof(value)));
+		BOOST_CHECK_EQUAL(value, 1);
+	}
+	BOOST_CHECK(!reader.stream().read(reinterpret_cast<char*>(&value), sizeof(value)));
+	BOOST_CHECK_EQUAL(reader.stream().gcount(), 0);
+
+	reader = pack.open_member(member_name(2).c_str());
+	check_member(reader, 13);
+
+	// The pack can be updated again
+	PackWriter::compact(pack_file.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(pack_replace_and_compact)
+{
+	transient_directory tmp_dir{};
+
+	const auto pack_file = tmp_dir.path / "foo.pack";
+	const auto resource_file = tmp_dir.path / "bar.bin";
+
+	{
+		auto writer = Writer::create(resource_file.c_str(), TestMDWriter::dummy_md2());
+		write_member(writer, 13);
+	}
+
+	{
+		auto pack = PackWriter::create(pack_file.c_str());
+
+		for (std::uint64_t i = 0; i < 10; ++i) {
+			auto writer = pack.add(member_name(i).c_str(), TestMDWriter::dummy_md());
+			write_member(writer, i);
+		}
+
+		std::move(pack).finalize();
+	}
+
+	BOOST_CHECK_EQUAL(PackReader::open(pack_file.c_str()).dead_size(), 0);
+
+	{
+		auto pack = PackWriter::open(pack_file.c_str());
+
+		BOOST_CHECK_EQUAL(pack.member_count(), 10);
+		BOOST_CHECK_THROW(pack.add(member_name(1).c_str(), TestMDWriter::dummy_md()), reven::binresource::WriterError);
+
+		// The resource isn't left open when the name is refused
+		const auto fd_count = std::distance(boost::filesystem::directory_iterator("/proc/self/fd"),
+		                                    boost::filesystem::directory_iterator());
+		BOOST_CHECK_THROW(pack.add(member_name(1).c_str(), resource_file.c_str()), reven::binresource::WriterError);
+		BOOST_CHECK_EQUAL(std::distance(boost::filesystem::directory_iterator("/proc/self/fd"),
+		                                boost::filesystem::directory_iterator()), fd_count);
+
+		{
+			auto writer = pack.replace(member_name(1).c_str(), TestMDWriter::dummy_md());
+			write_member(writer, 25);
+		}
+
+		pack.replace(member_name(2).c_str(), resource_file.c_str());
+		pack.remove(member_name(3).c_str());
+		BOOST_CHECK_THROW(pack.remove(member_name(3).c_str()), reven::binresource::WriterError);
+
+		auto writer = pack.add(member_name(10).c_str(), TestMDWriter::dummy_md());
+		write_member(writer, 10);
+		std::move(writer).finalize();
+
+		std::move(pack).finalize();
+	}
+
+	const auto check_pack = [&pack_file] {
+		auto pack = PackReader::open(pack_file.c_str());
+
+		BOOST_REQUIRE_EQUAL(pack.member_count(), 10);
+		BOOST_CHECK(pack.find(member_name(3).c_str()) == PackReader::npos);
+
+		for (std::uint64_t i = 0; i <= 10; ++i) {
+			if (i == 3) {
+				continue;
+			}
+
+			auto reader = pack.open_member(member_name(i).c_str());
+			check_member(reader, i == 1 ? 25 : (i == 2 ? 13 : i));
+		}
+
+		return pack.dead_size();
+	};
+
+	const auto size = boost::filesystem::file_size(pack_file);
+	const auto dead_size = check_pack();
+	BOOST_CHECK(dead_size > 0);
+
+	PackWriter::compact(pack_file.c_str());
+
+	BOOST_CHECK_EQUAL(check_pack(), 0);
+	BOOST_CHECK_EQUAL(boost::filesystem::file_size(pack_file), size - dead_size);
+	BOOST_CHECK_EQUAL(std::distance(boost::filesystem::directory_iterator(tmp_dir.path),
+	                                boost::filesystem::directory_iterator()), 2);
+}
@@ -2,13 +2,22 @@
 #include <boost/test/unit_test.hpp>
 #include <boost/filesystem.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iterator>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 #include "common.h"
 #include "metadata.h"
 #include "reader.h"
 #include "writer.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+
 using MD = reven::binresource::Metadata;
 using Reader = reven::binresource::Reader;
 using Writer = reven::binresource::Writer;
@@ -192,3 +201,1231 @@ BOOST_AUTO_TEST_CASE(read_write_set_metadata_file)
 	BOOST_CHECK_EQUAL(md.tool_info(), md2.tool_info());
 	BOOST_CHECK_EQUAL(md.generation_date(), md2.generation_date());
 }
+
+BOOST_AUTO_TEST_CASE(read_write_mapped)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	auto md = TestMDWriter::dummy_md();
+	constexpr std::size_t count = 10000;
+	std::size_t md_size = 0;
+
+	{
+		// Small growth to force several remappings
+		auto writer = Writer::create_mapped(tmp_file.c_str(), md, 4096);
+		md_size = writer.md_size();
+
+		writer.stream().write(reinterpret_cast<const char*>(&foo), sizeof(foo));
+
+		auto* values = reinterpret_cast<std::uint64_t*>(writer.map(count * sizeof(std::uint64_t)));
+		for (std::size_t i = 0; i < count; ++i) {
+			values[i] = i;
+		}
+
+		writer.stream().write(reinterpret_cast<const char*>(&foo), sizeof(foo));
+
+		md = TestMDWriter::dummy_md2();
+		writer.set_metadata(md);
+
+		std::move(writer).finalize();
+	}
+
+	BOOST_CHECK_EQUAL(boost::filesystem::file_size(tmp_file), md_size + (count + 2) * sizeof(std::uint64_t));
+
+	auto reader = Reader::open(tmp_file.c_str());
+
+	std::uint64_t bar = 0;
+	reader.stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+	BOOST_CHECK_EQUAL(foo, bar);
+
+	for (std::size_t i = 0; i < count; ++i) {
+		reader.stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+		BOOST_REQUIRE_EQUAL(bar, i);
+	}
+
+	reader.stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+	BOOST_CHECK_EQUAL(foo, bar);
+
+	BOOST_CHECK_EQUAL(md.type(), reader.metadata().type());
+	BOOST_CHECK_EQUAL(md.tool_info(), reader.metadata().tool_info());
+}
+
+BOOST_AUTO_TEST_CASE(read_write_file_preallocated)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	const auto md = TestMDWriter::dummy_md();
+	std::vector<std::uint64_t> values(100000);
+	for (std::size_t i = 0; i < values.size(); ++i) {
+		values[i] = i;
+	}
+
+	reven::binresource::WriterOptions options;
+	// Hint bigger than the real payload: the unused space must not appear in the file
+	options.size_hint = 2 * values.size() * sizeof(std::uint64_t);
+	options.writeback_interval = 64 * 1024;
+	options.drop_written_pages = true;
+
+	std::size_t md_size = 0;
+
+	{
+		auto writer = Writer::create(tmp_file.c_str(), md, options);
+		md_size = writer.md_size();
+
+		for (std::size_t i = 0; i < values.size(); i += 1000) {
+			writer.stream().write(reinterpret_cast<const char*>(&values[i]), 1000 * sizeof(std::uint64_t));
+		}
+	}
+
+	BOOST_CHECK_EQUAL(boost::filesystem::file_size(tmp_file), md_size + values.size() * sizeof(std::uint64_t));
+
+	auto reader = Reader::open(tmp_file.c_str());
+
+	std::vector<std::uint64_t> read_values(values.size());
+	reader.stream().read(reinterpret_cast<char*>(read_values.data()), read_values.size() * sizeof(std::uint64_t));
+
+	BOOST_CHECK_EQUAL(reader.stream().gcount(), read_values.size() * sizeof(std::uint64_t));
+	BOOST_CHECK(values == read_values);
+}
+
+BOOST_AUTO_TEST_CASE(read_file_access_patterns)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	{
+		auto writer = Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md());
+
+		for (std::uint64_t i = 0; i < 1000; ++i) {
+			writer.stream().write(reinterpret_cast<const char*>(&i), sizeof(i));
+		}
+	}
+
+	reven::binresource::ReaderOptions options;
+	options.access_pattern = reven::binresource::AccessPattern::Sequential;
+	auto reader = Reader::open(tmp_file.c_str(), options);
+
+	reader.prefetch(0, 1000 * sizeof(std::uint64_t));
+
+	std::uint64_t bar = 0;
+	reader.stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+	BOOST_CHECK_EQUAL(bar, 0);
+
+	reader.advise(reven::binresource::AccessPattern::Random);
+
+	reader.stream().seekg(reader.md_size() + 500 * sizeof(std::uint64_t));
+	reader.stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+	BOOST_CHECK_EQUAL(bar, 500);
+
+	reader.advise(reven::binresource::AccessPattern::WillNeed);
+	reader.advise(reven::binresource::AccessPattern::Normal);
+
+	reader.stream().seekg(reader.md_size() + 10 * sizeof(std::uint64_t));
+	reader.stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+	BOOST_CHECK_EQUAL(bar, 10);
+}
+
+BOOST_AUTO_TEST_CASE(read_file_read_ahead)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+	constexpr std::uint64_t count = 100000;
+
+	{
+		auto writer = Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md());
+
+		for (std::uint64_t i = 0; i < count; ++i) {
+			writer.stream().write(reinterpret_cast<const char*>(&i), sizeof(i));
+		}
+	}
+
+	reven::binresource::ReaderOptions options;
+	options.read_ahead_chunks = 4;
+	// Not a multiple of the size of the values to read them across chunks
+	options.read_ahead_chunk_size = 4093;
+	auto reader = Reader::open(tmp_file.c_str(), options);
+
+	const auto md = TestMDWriter::dummy_md();
+	BOOST_CHECK_EQUAL(md.tool_info(), reader.metadata().tool_info());
+
+	std::uint64_t bar = 0;
+	for (std::uint64_t i = 0; i < count; ++i) {
+		reader.stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+		BOOST_REQUIRE_EQUAL(bar, i);
+	}
+
+	reader.stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+	BOOST_CHECK(reader.stream().eof());
+
+	reader.stream().clear();
+	reader.stream().seekg(reader.md_size() + 500 * sizeof(std::uint64_t));
+	reader.stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+	BOOST_CHECK_EQUAL(bar, 500);
+
+	reader.stream().seekg(reader.md_size() + 50000 * sizeof(std::uint64_t));
+	reader.stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+	BOOST_CHECK_EQUAL(bar, 50000);
+	BOOST_CHECK_EQUAL(reader.stream().tellg(), reader.md_size() + 50001 * sizeof(std::uint64_t));
+
+	reader.stream().seekg(0, std::ios_base::end);
+	BOOST_CHECK_EQUAL(reader.stream().tellg(), reader.md_size() + count * sizeof(std::uint64_t));
+}
+
+BOOST_AUTO_TEST_CASE(read_write_file_large_first_write)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	// Bypasses the buffer of the stream
+	std::vector<std::uint64_t> values(128 * 1024);
+	for (std::size_t i = 0; i < values.size(); ++i) {
+		values[i] = i;
+	}
+
+	std::size_t md_size = 0;
+
+	{
+		auto writer = Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md());
+		md_size = writer.md_size();
+
+		writer.stream().write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(std::uint64_t));
+		writer.stream().write(reinterpret_cast<const char*>(&foo), sizeof(foo));
+	}
+
+	BOOST_CHECK_EQUAL(boost::filesystem::file_size(tmp_file), md_size + (values.size() + 1) * sizeof(std::uint64_t));
+
+	auto reader = Reader::open(tmp_file.c_str());
+
+	BOOST_CHECK_EQUAL(reader.metadata().tool_info(), TestMDWriter::dummy_md().tool_info());
+
+	std::vector<std::uint64_t> read_values(values.size());
+	reader.stream().read(reinterpret_cast<char*>(read_values.data()), read_values.size() * sizeof(std::uint64_t));
+	BOOST_CHECK(values == read_values);
+
+	std::uint64_t bar = 0;
+	reader.stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+	BOOST_CHECK_EQUAL(foo, bar);
+}
+
+BOOST_AUTO_TEST_CASE(read_write_file_straddling_writes)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	std::string data(100000, '\0');
+	for (std::size_t i = 0; i < data.size(); ++i) {
+		data[i] = static_cast<char>(i * 31 + i / 251);
+	}
+
+	// Writes of various sizes, many of them not fitting in the rest of the buffer
+	{
+		reven::binresource::WriterOptions options;
+		options.buffer_size = 4096;
+
+		auto writer = Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md(), options);
+
+		std::size_t written = 0;
+		for (std::size_t size = 1; written < data.size(); size = size * 7 % 5003 + 1) {
+			size = std::min(size, data.size() - written);
+			writer.stream().write(data.data() + written, size);
+			written += size;
+		}
+	}
+
+	auto reader = Reader::open(tmp_file.c_str());
+
+	std::string read(data.size() + 1, '\0');
+	reader.stream().read(&read[0], read.size());
+
+	BOOST_CHECK_EQUAL(reader.stream().gcount(), data.size());
+	read.resize(data.size());
+	BOOST_CHECK(read == data);
+}
+
+BOOST_AUTO_TEST_CASE(read_write_vec_stringstream)
+{
+	auto writer = Writer::create(std::make_unique<std::stringstream>(), TestMDWriter::dummy_md());
+
+	const std::uint32_t header = 0x1234;
+	const std::string blob = "variable length blob";
+	const char padding[4] = {0};
+
+	writer.stream().write(reinterpret_cast<const char*>(&foo), sizeof(foo));
+
+	const reven::binresource::ConstBuffer buffers[] = {
+		{&header, sizeof(header)}, {blob.data(), blob.size()}, {padding, sizeof(padding)},
+	};
+	writer.write_vec(buffers, 3);
+
+	auto stream = std::unique_ptr<std::stringstream>(static_cast<std::stringstream*>(std::move(writer).finalize().release()));
+	auto reader = Reader::open(std::move(stream));
+
+	std::uint32_t read_header = 0;
+	std::string read_blob(blob.size(), '\0');
+	char read_padding[8] = {1};
+
+	const reven::binresource::MutableBuffer read_buffers[] = {
+		{&read_header, sizeof(read_header)}, {&read_blob[0], read_blob.size()}, {read_padding, sizeof(read_padding)},
+	};
+
+	// Stops at the end of the file
+	BOOST_CHECK_EQUAL(reader.read_vec(sizeof(foo), read_buffers, 3), sizeof(header) + blob.size() + sizeof(padding));
+	BOOST_CHECK_EQUAL(read_header, header);
+	BOOST_CHECK_EQUAL(read_blob, blob);
+
+	// The position of the stream is unchanged
+	std::uint64_t bar = 0;
+	reader.stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+	BOOST_CHECK_EQUAL(foo, bar);
+}
+
+BOOST_AUTO_TEST_CASE(read_write_vec_file)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	const std::uint32_t header = 0x1234;
+	const std::string blob = "variable length blob";
+	const char padding[4] = {0};
+
+	// More buffers than a single system call accepts
+	std::vector<std::uint64_t> values(3000);
+	std::vector<reven::binresource::ConstBuffer> buffers;
+	for (std::size_t i = 0; i < values.size(); ++i) {
+		values[i] = i;
+		buffers.push_back({&values[i], sizeof(values[i])});
+	}
+
+	std::size_t md_size = 0;
+
+	{
+		auto writer = Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md());
+		md_size = writer.md_size();
+
+		// Pending in the buffer of the stream
+		writer.stream().write(reinterpret_cast<const char*>(&foo), sizeof(foo));
+
+		const reven::binresource::ConstBuffer record[] = {
+			{&header, sizeof(header)}, {blob.data(), blob.size()}, {padding, sizeof(padding)},
+		};
+		writer.write_vec(record, 3);
+		writer.write_vec(buffers.data(), buffers.size());
+
+		writer.stream().write(reinterpret_cast<const char*>(&foo), sizeof(foo));
+	}
+
+	const auto payload_size = 2 * sizeof(foo) + sizeof(header) + blob.size() + sizeof(padding) +
+	                          values.size() * sizeof(std::uint64_t);
+	BOOST_CHECK_EQUAL(boost::filesystem::file_size(tmp_file), md_size + payload_size);
+
+	auto reader = Reader::open(tmp_file.c_str());
+
+	std::uint32_t read_header = 0;
+	std::string read_blob(blob.size(), '\0');
+	char read_padding[sizeof(padding)] = {1};
+
+	const reven::binresource::MutableBuffer read_record[] = {
+		{&read_header, sizeof(read_header)}, {&read_blob[0], read_blob.size()}, {read_padding, sizeof(read_padding)},
+	};
+	BOOST_CHECK_EQUAL(reader.read_vec(sizeof(foo), read_record, 3), sizeof(header) + blob.size() + sizeof(padding));
+	BOOST_CHECK_EQUAL(read_header, header);
+	BOOST_CHECK_EQUAL(read_blob, blob);
+	BOOST_CHECK_EQUAL(read_padding[0], 0);
+
+	std::vector<std::uint64_t> read_values(values.size());
+	std::vector<reven::binresource::MutableBuffer> read_buffers;
+	for (auto& value : read_values) {
+		read_buffers.push_back({&value, sizeof(value)});
+	}
+
+	const auto values_offset = sizeof(foo) + sizeof(header) + blob.size() + sizeof(padding);
+	BOOST_CHECK_EQUAL(reader.read_vec(values_offset, read_buffers.data(), read_buffers.size()),
+	                  values.size() * sizeof(std::uint64_t));
+	BOOST_CHECK(values == read_values);
+
+	// Stops at the end of the file
+	std::uint64_t bar[2] = {0, 0};
+	const reven::binresource::MutableBuffer last[] = {{bar, sizeof(bar)}};
+	BOOST_CHECK_EQUAL(reader.read_vec(payload_size - sizeof(foo), last, 1), sizeof(foo));
+	BOOST_CHECK_EQUAL(bar[0], foo);
+}
+
+BOOST_AUTO_TEST_CASE(read_write_file_buffer_size)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	std::vector<std::uint64_t> values(10000);
+	for (std::size_t i = 0; i < values.size(); ++i) {
+		values[i] = i;
+	}
+
+	reven::binresource::WriterOptions writer_options;
+	writer_options.buffer_size = 1000;
+
+	{
+		auto writer = Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md(), writer_options);
+
+		for (std::size_t i = 0; i < values.size() / 2; ++i) {
+			writer.stream().write(reinterpret_cast<const char*>(&values[i]), sizeof(values[i]));
+		}
+	}
+
+	{
+		// Append the end of the values after reopening the resource
+		auto writer = Writer::open(tmp_file.c_str(), writer_options);
+		writer.stream().seekp(0, std::ios_base::end);
+
+		for (std::size_t i = values.size() / 2; i < values.size(); ++i) {
+			writer.stream().write(reinterpret_cast<const char*>(&values[i]), sizeof(values[i]));
+		}
+	}
+
+	reven::binresource::ReaderOptions reader_options;
+	reader_options.buffer_size = 3 * 4096 + 1;
+
+	auto reader = Reader::open(tmp_file.c_str(), reader_options);
+
+	for (std::size_t i = 0; i < values.size(); ++i) {
+		std::uint64_t value = 0;
+		reader.stream().read(reinterpret_cast<char*>(&value), sizeof(value));
+		BOOST_REQUIRE_EQUAL(value, values[i]);
+	}
+
+	char c;
+	reader.stream().read(&c, 1);
+	BOOST_CHECK(reader.stream().eof());
+}
+
+BOOST_AUTO_TEST_CASE(read_write_file_write_at)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	constexpr std::size_t thread_count = 4;
+	constexpr std::size_t entry_count = 10000;
+
+	{
+		auto writer = Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md());
+
+		writer.stream().write(reinterpret_cast<const char*>(&foo), sizeof(foo));
+		writer.stream().flush();
+
+		// Table after the first value, with the odd entries filled backwards in parallel and the even ones left empty
+		std::vector<std::thread> threads;
+		for (std::size_t t = 0; t < thread_count; ++t) {
+			threads.emplace_back([&writer, t]() {
+				for (std::size_t i = entry_count - 1 - 2 * t; i < entry_count; i -= 2 * thread_count) {
+					const std::uint64_t value = i;
+					writer.write_at((i + 1) * sizeof(std::uint64_t), &value, sizeof(value));
+				}
+			});
+		}
+
+		for (auto& thread : threads) {
+			thread.join();
+		}
+
+		// The position of the stream is unchanged
+		BOOST_CHECK_EQUAL(writer.stream().tellp(), writer.md_size() + sizeof(foo));
+	}
+
+	auto reader = Reader::open(tmp_file.c_str());
+
+	// Each thread stopped the hashing of the payload
+	BOOST_CHECK(!reader.has_content_hash());
+
+	std::uint64_t bar = 0;
+	reader.stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+	BOOST_CHECK_EQUAL(foo, bar);
+
+	for (std::size_t i = 0; i < entry_count; ++i) {
+		std::uint64_t value = 42;
+		reader.stream().read(reinterpret_cast<char*>(&value), sizeof(value));
+		BOOST_REQUIRE_EQUAL(value, i % 2 == 1 ? i : 0);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(read_write_stringstream_write_at)
+{
+	auto writer = Writer::create(std::make_unique<std::stringstream>(), TestMDWriter::dummy_md());
+
+	const std::uint64_t values[] = {1, 2, 3};
+	writer.stream().write(reinterpret_cast<const char*>(values), sizeof(values));
+
+	const std::uint64_t value = 42;
+	writer.write_at(sizeof(std::uint64_t), &value, sizeof(value));
+
+	writer.stream().write(reinterpret_cast<const char*>(&foo), sizeof(foo));
+
+	auto stream = std::unique_ptr<std::stringstream>(static_cast<std::stringstream*>(std::move(writer).finalize().release()));
+	auto reader = Reader::open(std::move(stream));
+
+	std::uint64_t read_values[4] = {0, 0, 0, 0};
+	reader.stream().read(reinterpret_cast<char*>(read_values), sizeof(read_values));
+
+	BOOST_CHECK_EQUAL(read_values[0], 1);
+	BOOST_CHECK_EQUAL(read_values[1], 42);
+	BOOST_CHECK_EQUAL(read_values[2], 3);
+	BOOST_CHECK_EQUAL(read_values[3], foo);
+}
+
+BOOST_AUTO_TEST_CASE(read_write_file_set_metadata_concurrent)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	constexpr std::size_t count = 100000;
+
+	{
+		auto writer = Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md());
+
+		std::thread producer([&writer]() {
+			for (std::uint64_t i = 0; i < count; ++i) {
+				writer.stream().write(reinterpret_cast<const char*>(&i), sizeof(i));
+			}
+		});
+
+		// Progress updates while the payload is written
+		for (std::size_t i = 0; i < 100; ++i) {
+			writer.set_metadata(i % 2 == 0 ? TestMDWriter::dummy_md2() : TestMDWriter::dummy_md());
+		}
+		writer.set_metadata(TestMDWriter::dummy_md2());
+
+		producer.join();
+
+		BOOST_CHECK_EQUAL(writer.stream().tellp(), writer.md_size() + count * sizeof(std::uint64_t));
+	}
+
+	auto reader = Reader::open(tmp_file.c_str());
+
+	const auto md = TestMDWriter::dummy_md2();
+	BOOST_CHECK_EQUAL(reader.metadata().tool_info(), md.tool_info());
+	BOOST_CHECK_EQUAL(reader.metadata().generation_date(), md.generation_date());
+
+	for (std::uint64_t i = 0; i < count; ++i) {
+		std::uint64_t value = 0;
+		reader.stream().read(reinterpret_cast<char*>(&value), sizeof(value));
+		BOOST_REQUIRE_EQUAL(value, i);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(read_file_follow)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	constexpr std::uint64_t count = 1000;
+
+	auto writer = std::make_unique<Writer>(Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md()));
+	writer->stream().flush();
+
+	std::thread producer([&writer]() {
+		for (std::uint64_t i = 0; i < count; ++i) {
+			writer->stream().write(reinterpret_cast<const char*>(&i), sizeof(i));
+
+			if (i % 100 == 0) {
+				writer->stream().flush();
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			}
+		}
+
+		writer.reset();
+	});
+
+	reven::binresource::ReaderOptions options;
+	options.follow = true;
+	options.buffer_size = 4096;
+
+	auto reader = Reader::open(tmp_file.c_str(), options);
+	BOOST_CHECK_EQUAL(reader.metadata().tool_info(), TestMDWriter::dummy_md().tool_info());
+
+	for (std::uint64_t i = 0; i < count; ++i) {
+		std::uint64_t value = count;
+		reader.stream().read(reinterpret_cast<char*>(&value), sizeof(value));
+		BOOST_REQUIRE_EQUAL(value, i);
+	}
+
+	// The end is only reached once the writer is done
+	char c;
+	reader.stream().read(&c, 1);
+	BOOST_CHECK(reader.stream().eof());
+
+	producer.join();
+}
+
+BOOST_AUTO_TEST_CASE(read_file_follow_readsome)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	auto writer = Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md());
+	writer.stream().write(reinterpret_cast<const char*>(&foo), sizeof(foo));
+	writer.stream().flush();
+
+	reven::binresource::ReaderOptions options;
+	options.follow = true;
+
+	auto reader = Reader::open(tmp_file.c_str(), options);
+
+	std::uint64_t values[2] = {0, 0};
+
+	// Only what is available, without waiting
+	BOOST_CHECK_EQUAL(reader.stream().readsome(reinterpret_cast<char*>(values), sizeof(values)), sizeof(foo));
+	BOOST_CHECK_EQUAL(values[0], foo);
+	BOOST_CHECK_EQUAL(reader.stream().readsome(reinterpret_cast<char*>(values), sizeof(values)), 0);
+	BOOST_CHECK(!reader.stream().eof());
+
+	std::move(writer).finalize();
+
+	// The writer is done: the end is reached without waiting
+	BOOST_CHECK_EQUAL(reader.stream().readsome(reinterpret_cast<char*>(values), sizeof(values)), 0);
+	BOOST_CHECK(reader.stream().eof());
+}
+
+BOOST_AUTO_TEST_CASE(read_file_follow_reopen)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	constexpr std::uint64_t count = 500;
+
+	std::size_t md_size = 0;
+	{
+		auto writer = Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md());
+		md_size = writer.md_size();
+	}
+
+	std::atomic<bool> done{false};
+
+	// Readers keep checking whether the resource is being written while it is reopened
+	std::vector<std::thread> followers;
+	for (int i = 0; i < 4; ++i) {
+		followers.emplace_back([&tmp_file, &done]() {
+			reven::binresource::ReaderOptions options;
+			options.follow = true;
+
+			auto reader = Reader::open(tmp_file.c_str(), options);
+			while (!done) {
+				reader.stream().seekg(0, std::ios_base::end);
+				reader.stream().rdbuf()->in_avail();
+			}
+		});
+	}
+
+	// The checks of the readers never make a writer fail
+	bool failed = false;
+	for (std::uint64_t i = 0; i < count && !failed; ++i) {
+		try {
+			auto writer = Writer::open(tmp_file.c_str());
+			writer.stream().seekp(0, std::ios_base::end);
+			writer.stream().write(reinterpret_cast<const char*>(&i), sizeof(i));
+		} catch (const reven::binresource::WriterError&) {
+			failed = true;
+		}
+	}
+
+	done = true;
+	for (auto& follower : followers) {
+		follower.join();
+	}
+
+	BOOST_CHECK(!failed);
+	BOOST_CHECK_EQUAL(boost::filesystem::file_size(tmp_file), md_size + count * sizeof(std::uint64_t));
+}
+
+BOOST_AUTO_TEST_CASE(read_write_file_already_written)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	{
+		auto writer = Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md());
+		writer.stream().write(reinterpret_cast<const char*>(&foo), sizeof(foo));
+		writer.stream().flush();
+
+		// Fails at once instead of waiting for the first writer, and leaves the resource untouched
+		BOOST_CHECK_THROW(Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md2()), reven::binresource::WriterError);
+		BOOST_CHECK_THROW(Writer::open(tmp_file.c_str()), reven::binresource::WriterError);
+	}
+
+	auto reader = Reader::open(tmp_file.c_str());
+	BOOST_CHECK_EQUAL(reader.metadata().type(), TestMDWriter::dummy_md().type());
+
+	std::uint64_t bar = 0;
+	reader.stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+	BOOST_CHECK_EQUAL(foo, bar);
+
+	// Available again once the first writer is done
+	auto writer = Writer::open(tmp_file.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(read_write_file_commit_recover)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+	const auto crashed_file = tmp_dir.path / "crashed.bin";
+	const auto corrupted_file = tmp_dir.path / "corrupted.bin";
+
+	constexpr std::uint64_t count = 100000;
+	constexpr std::uint64_t committed_count = 50000;
+
+	std::size_t md_size = 0;
+
+	{
+		auto writer = Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md());
+		md_size = writer.md_size();
+
+		for (std::uint64_t i = 0; i < committed_count; ++i) {
+			writer.stream().write(reinterpret_cast<const char*>(&i), sizeof(i));
+		}
+
+		writer.commit();
+
+		for (std::uint64_t i = committed_count; i < count; ++i) {
+			writer.stream().write(reinterpret_cast<const char*>(&i), sizeof(i));
+		}
+
+		// Freeze the state of the file as if the writer crashed, with data written after the last commit
+		writer.stream().flush();
+		boost::filesystem::copy_file(tmp_file, crashed_file);
+		boost::filesystem::copy_file(tmp_file, corrupted_file);
+	}
+
+	// A finalized resource is committed completely
+	{
+		auto writer = Writer::open(tmp_file.c_str());
+	}
+	BOOST_CHECK_EQUAL(boost::filesystem::file_size(tmp_file), md_size + count * sizeof(std::uint64_t));
+
+	// The uncommitted data is dropped, and the writing can resume
+	BOOST_CHECK(boost::filesystem::file_size(crashed_file) > md_size + committed_count * sizeof(std::uint64_t));
+
+	{
+		auto writer = Writer::open(crashed_file.c_str());
+		BOOST_CHECK_EQUAL(boost::filesystem::file_size(crashed_file), md_size + committed_count * sizeof(std::uint64_t));
+
+		writer.stream().seekp(0, std::ios_base::end);
+		for (std::uint64_t i = committed_count; i < count; ++i) {
+			writer.stream().write(reinterpret_cast<const char*>(&i), sizeof(i));
+		}
+	}
+
+	auto reader = Reader::open(crashed_file.c_str());
+	BOOST_CHECK_EQUAL(reader.metadata().tool_info(), TestMDWriter::dummy_md().tool_info());
+
+	for (std::uint64_t i = 0; i < count; ++i) {
+		std::uint64_t value = count;
+		reader.stream().read(reinterpret_cast<char*>(&value), sizeof(value));
+		BOOST_REQUIRE_EQUAL(value, i);
+	}
+
+	// The end of the committed payload didn't reach the disk
+	{
+		std::fstream file(corrupted_file.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+		file.seekp(md_size + (committed_count - 1) * sizeof(std::uint64_t));
+		const std::uint64_t zero = 0;
+		file.write(reinterpret_cast<const char*>(&zero), sizeof(zero));
+	}
+
+	BOOST_CHECK_THROW(Writer::open(corrupted_file.c_str()), reven::binresource::WriterError);
+}
+
+BOOST_AUTO_TEST_CASE(read_write_file_commit_write_at)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	std::size_t md_size = 0;
+
+	{
+		auto writer = Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md());
+		md_size = writer.md_size();
+
+		writer.stream().write("hello", 5);
+		writer.commit();
+
+		// Not written through the stream, but committed all the same
+		writer.write_at(5, " world", 6);
+		writer.write_at(0, "H", 1);
+
+		BOOST_CHECK(*std::move(writer).finalize());
+	}
+
+	BOOST_CHECK_EQUAL(boost::filesystem::file_size(tmp_file), md_size + 11);
+
+	{
+		auto writer = Writer::open(tmp_file.c_str());
+	}
+
+	BOOST_CHECK_EQUAL(boost::filesystem::file_size(tmp_file), md_size + 11);
+
+	auto reader = Reader::open(tmp_file.c_str());
+
+	std::string content(11, '\0');
+	reader.stream().read(&content[0], content.size());
+	BOOST_CHECK_EQUAL(content, "Hello world");
+}
+
+BOOST_AUTO_TEST_CASE(read_write_file_commit_interval)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+	const auto crashed_file = tmp_dir.path / "crashed.bin";
+
+	reven::binresource::WriterOptions options;
+	options.commit_interval = 64 * 1024;
+	options.buffer_size = 4096;
+
+	constexpr std::uint64_t count = 100000;
+
+	std::size_t md_size = 0;
+
+	{
+		auto writer = Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md(), options);
+		md_size = writer.md_size();
+
+		for (std::uint64_t i = 0; i < count; ++i) {
+			writer.stream().write(reinterpret_cast<const char*>(&i), sizeof(i));
+		}
+
+		writer.stream().flush();
+		boost::filesystem::copy_file(tmp_file, crashed_file);
+	}
+
+	// Recovered at the last periodic commit
+	{
+		auto writer = Writer::open(crashed_file.c_str());
+	}
+
+	const auto size = boost::filesystem::file_size(crashed_file);
+	BOOST_CHECK(size >= md_size + count * sizeof(std::uint64_t) - options.commit_interval - options.buffer_size);
+	BOOST_CHECK(size <= md_size + count * sizeof(std::uint64_t));
+
+	auto reader = Reader::open(crashed_file.c_str());
+
+	for (std::uint64_t i = 0; i < (size - md_size) / sizeof(std::uint64_t); ++i) {
+		std::uint64_t value = count;
+		reader.stream().read(reinterpret_cast<char*>(&value), sizeof(value));
+		BOOST_REQUIRE_EQUAL(value, i);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(read_write_file_without_extension)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	constexpr std::uint64_t count = 1000;
+
+	std::size_t md_size = 0;
+
+	// Written to a stream, the resource has the header of the metadata version 1
+	{
+		auto writer = Writer::create(std::make_unique<std::fstream>(tmp_file.c_str(), std::ios::binary | std::ios::out),
+		                             TestMDWriter::dummy_md());
+		md_size = writer.md_size();
+
+		for (std::uint64_t i = 0; i < count / 2; ++i) {
+			writer.stream().write(reinterpret_cast<const char*>(&i), sizeof(i));
+		}
+	}
+
+	reven::binresource::WriterOptions options;
+	options.commit_interval = 1024;
+
+	// Opened and updated in place, without writing an extension over the payload
+	{
+		auto writer = Writer::open(tmp_file.c_str(), options);
+		BOOST_CHECK_EQUAL(writer.md_size(), md_size);
+
+		writer.stream().seekp(0, std::ios_base::end);
+		for (std::uint64_t i = count / 2; i < count; ++i) {
+			writer.stream().write(reinterpret_cast<const char*>(&i), sizeof(i));
+		}
+
+		writer.commit();
+		writer.set_metadata(TestMDWriter::dummy_md2());
+
+		BOOST_CHECK(*std::move(writer).finalize());
+	}
+
+	BOOST_CHECK_EQUAL(boost::filesystem::file_size(tmp_file), md_size + count * sizeof(std::uint64_t));
+
+	auto reader = Reader::open(tmp_file.c_str());
+	BOOST_CHECK_EQUAL(reader.md_size(), md_size);
+	BOOST_CHECK_EQUAL(reader.metadata().tool_info(), TestMDWriter::dummy_md2().tool_info());
+	BOOST_CHECK(!reader.has_content_hash());
+
+	for (std::uint64_t i = 0; i < count; ++i) {
+		std::uint64_t value = count;
+		reader.stream().read(reinterpret_cast<char*>(&value), sizeof(value));
+		BOOST_REQUIRE_EQUAL(value, i);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(read_write_file_atomic)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	reven::binresource::WriterOptions options;
+	options.atomic = true;
+	options.durability = reven::binresource::Durability::AtEnd;
+
+	{
+		auto writer = Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md(), options);
+		writer.stream().write(reinterpret_cast<const char*>(&foo), sizeof(foo));
+		writer.stream().flush();
+
+		// Only the temporary file exists until the finalization
+		BOOST_CHECK(!boost::filesystem::exists(tmp_file));
+
+		auto stream = std::move(writer).finalize();
+		BOOST_CHECK(static_cast<bool>(*stream));
+	}
+
+	BOOST_CHECK_EQUAL(std::distance(boost::filesystem::directory_iterator(tmp_dir.path),
+	                                boost::filesystem::directory_iterator()), 1);
+
+	auto reader = Reader::open(tmp_file.c_str());
+
+	std::uint64_t bar = 0;
+	reader.stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+
+	BOOST_CHECK_EQUAL(reader.stream().gcount(), sizeof(bar));
+	BOOST_CHECK_EQUAL(foo, bar);
+}
+
+BOOST_AUTO_TEST_CASE(read_write_file_atomic_not_finalized)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	{
+		auto writer = Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md());
+		writer.stream().write(reinterpret_cast<const char*>(&foo), sizeof(foo));
+	}
+
+	reven::binresource::WriterOptions options;
+	options.atomic = true;
+	options.durability = reven::binresource::Durability::Periodic;
+
+	{
+		auto writer = Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md2(), options);
+
+		for (std::uint64_t i = 0; i < 100000; ++i) {
+			writer.stream().write(reinterpret_cast<const char*>(&i), sizeof(i));
+		}
+	}
+
+	// The previous resource is left untouched, and the temporary file is removed
+	BOOST_CHECK_EQUAL(std::distance(boost::filesystem::directory_iterator(tmp_dir.path),
+	                                boost::filesystem::directory_iterator()), 1);
+
+	auto reader = Reader::open(tmp_file.c_str());
+
+	BOOST_CHECK_EQUAL(reader.metadata().tool_name(), TestMDWriter::dummy_md().tool_name());
+
+	std::uint64_t bar = 0;
+	reader.stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+	BOOST_CHECK_EQUAL(foo, bar);
+}
+
+BOOST_AUTO_TEST_CASE(read_write_file_restamp)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+	const auto restamped_file = tmp_dir.path / "bar.bin";
+
+	constexpr std::uint64_t count = 100000;
+
+	{
+		auto writer = Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md());
+
+		for (std::uint64_t i = 0; i < count; ++i) {
+			writer.stream().write(reinterpret_cast<const char*>(&i), sizeof(i));
+		}
+	}
+
+	Writer::restamp(tmp_file.c_str(), restamped_file.c_str(), TestMDWriter::dummy_md2());
+
+	BOOST_CHECK_EQUAL(boost::filesystem::file_size(restamped_file), boost::filesystem::file_size(tmp_file));
+
+	auto reader = Reader::open(restamped_file.c_str());
+
+	BOOST_CHECK_EQUAL(reader.metadata().tool_name(), TestMDWriter::dummy_md2().tool_name());
+
+	for (std::uint64_t i = 0; i < count; ++i) {
+		std::uint64_t value = count;
+		reader.stream().read(reinterpret_cast<char*>(&value), sizeof(value));
+		BOOST_REQUIRE_EQUAL(value, i);
+	}
+
+	// The source is untouched
+	BOOST_CHECK_EQUAL(Reader::open(tmp_file.c_str()).metadata().tool_name(), TestMDWriter::dummy_md().tool_name());
+
+	BOOST_CHECK_THROW(Writer::restamp(tmp_file.c_str(), tmp_file.c_str(), TestMDWriter::dummy_md2()),
+	                  reven::binresource::WriterError);
+}
+
+BOOST_AUTO_TEST_CASE(read_write_file_content_hash)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+	const auto other_file = tmp_dir.path / "bar.bin";
+
+	{
+		auto writer = Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md());
+		writer.stream().write("abc", 3);
+	}
+
+	// Reference value of XXH64
+	{
+		auto reader = Reader::open(tmp_file.c_str());
+		BOOST_REQUIRE(reader.has_content_hash());
+		BOOST_CHECK_EQUAL(reader.content_hash(), 0x44bc2cf5ad770999);
+
+		// The state of the resource stays in the library
+		std::stringstream stream;
+		reader.metadata().serialize(stream);
+
+		const auto serialized = stream.str();
+		BOOST_CHECK(serialized.substr(serialized.size() - reven::binresource::metadata_extension_size) ==
+		            std::string(reven::binresource::metadata_extension_size, '\0'));
+	}
+
+	std::vector<std::uint64_t> values(100000);
+	for (std::uint64_t i = 0; i < values.size(); ++i) {
+		values[i] = i * 0x9e3779b97f4a7c15;
+	}
+
+	// The same payload written in different ways, with different metadata
+	{
+		auto writer = Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md());
+		for (const auto value : values) {
+			writer.stream().write(reinterpret_cast<const char*>(&value), sizeof(value));
+		}
+	}
+
+	{
+		reven::binresource::WriterOptions options;
+		options.buffer_size = 4096;
+
+		auto writer = Writer::create(other_file.c_str(), TestMDWriter::dummy_md2(), options);
+
+		const char* data = reinterpret_cast<const char*>(values.data());
+		const std::size_t size = values.size() * sizeof(std::uint64_t);
+
+		const reven::binresource::ConstBuffer buffers[] = {{data, 13}, {data + 13, 100000}};
+		writer.write_vec(buffers, 2);
+		writer.stream().write(data + 100013, size - 100013);
+	}
+
+	const auto content_hash = Reader::open(tmp_file.c_str()).content_hash();
+
+	BOOST_CHECK(Reader::open(other_file.c_str()).has_content_hash());
+	BOOST_CHECK_EQUAL(Reader::open(other_file.c_str()).content_hash(), content_hash);
+
+	// Kept by a copy with another metadata
+	Writer::restamp(tmp_file.c_str(), other_file.c_str(), TestMDWriter::dummy_md2());
+	BOOST_CHECK_EQUAL(Reader::open(other_file.c_str()).content_hash(), content_hash);
+
+	// Not hashed when the payload isn't written sequentially, nor when it is changed afterwards
+	{
+		auto writer = Writer::create(other_file.c_str(), TestMDWriter::dummy_md());
+		writer.stream().write("abc", 3);
+		writer.write_at(10, "abc", 3);
+	}
+
+	BOOST_CHECK(!Reader::open(other_file.c_str()).has_content_hash());
+
+	{
+		auto writer = Writer::open(tmp_file.c_str());
+	}
+
+	BOOST_CHECK(!Reader::open(tmp_file.c_str()).has_content_hash());
+}
+
+BOOST_AUTO_TEST_CASE(read_write_pipe_streaming)
+{
+	int fds[2];
+	BOOST_REQUIRE(::pipe(fds) == 0);
+
+	const auto md = TestMDWriter::dummy_md();
+
+	// More than the capacity of the pipe, so that the writer and the reader run concurrently
+	std::vector<std::uint64_t> values(100000);
+	for (std::uint64_t i = 0; i < values.size(); ++i) {
+		values[i] = i * 0x9e3779b97f4a7c15;
+	}
+
+	// The checks are done in the main thread
+	std::size_t writer_md_size = 0;
+	bool set_metadata_failed = false;
+	bool write_at_failed = false;
+	std::uint64_t end_position = 0;
+	bool written = false;
+
+	std::thread producer([&] {
+		auto writer = Writer::create_streaming(fds[1], md, 4096);
+		writer_md_size = writer.md_size();
+
+		// The header was already sent and the stream can't be sought
+		try {
+			writer.set_metadata(TestMDWriter::dummy_md2());
+		} catch (const reven::binresource::WriterError&) {
+			set_metadata_failed = true;
+		}
+
+		try {
+			writer.write_at(0, "abc", 3);
+		} catch (const reven::binresource::WriterError&) {
+			write_at_failed = true;
+		}
+
+		const char* data = reinterpret_cast<const char*>(values.data());
+		const reven::binresource::ConstBuffer buffers[] = {{data, 13}, {data + 13, 100000}};
+		writer.write_vec(buffers, 2);
+		writer.stream().write(data + 100013, values.size() * sizeof(std::uint64_t) - 100013);
+
+		end_position = writer.stream().tellp();
+
+		// Closes the pipe
+		written = static_cast<bool>(*std::move(writer).finalize());
+	});
+
+	auto reader = Reader::open_streaming(fds[0], 4096);
+
+	BOOST_CHECK_EQUAL(reader.metadata().type(), md.type());
+	BOOST_CHECK_EQUAL(reader.metadata().tool_name(), md.tool_name());
+	BOOST_CHECK_EQUAL(static_cast<std::uint64_t>(reader.stream().tellg()), reader.md_size());
+
+	reven::binresource::MutableBuffer buffer{nullptr, 0};
+	BOOST_CHECK_THROW(reader.read_vec(0, &buffer, 1), reven::binresource::ReaderError);
+
+	std::vector<std::uint64_t> read(values.size());
+	reader.stream().read(reinterpret_cast<char*>(read.data()), read.size() * sizeof(std::uint64_t));
+	BOOST_CHECK_EQUAL(reader.stream().gcount(), read.size() * sizeof(std::uint64_t));
+
+	BOOST_CHECK(read == values);
+	BOOST_CHECK_EQUAL(reader.stream().get(), EOF);
+
+	producer.join();
+
+	BOOST_CHECK_EQUAL(reader.md_size(), writer_md_size);
+	BOOST_CHECK(set_metadata_failed);
+	BOOST_CHECK(write_at_failed);
+	BOOST_CHECK_EQUAL(end_position, writer_md_size + values.size() * sizeof(std::uint64_t));
+	BOOST_CHECK(written);
+}
+
+BOOST_AUTO_TEST_CASE(read_write_pipe_streaming_from_file)
+{
+	transient_directory tmp_dir;
+	const auto tmp_file = (tmp_dir.path / "file.bin").native();
+
+	{
+		auto writer = Writer::create(tmp_file.c_str(), TestMDWriter::dummy_md());
+		writer.stream().write(reinterpret_cast<const char*>(&foo), sizeof(foo));
+	}
+
+	// Like `cat file.bin | consumer`
+	int fds[2];
+	BOOST_REQUIRE(::pipe(fds) == 0);
+
+	std::ifstream file(tmp_file, std::ios::binary);
+	const std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	ssize_t written = 0;
+	std::thread producer([&] {
+		written = ::write(fds[1], content.data(), content.size());
+		::close(fds[1]);
+	});
+
+	auto reader = Reader::open_streaming(fds[0]);
+
+	BOOST_CHECK_EQUAL(reader.md_size(), Reader::open(tmp_file.c_str()).md_size());
+	BOOST_CHECK(reader.has_content_hash());
+	BOOST_CHECK_EQUAL(reader.content_hash(), Reader::open(tmp_file.c_str()).content_hash());
+
+	std::uint64_t bar = 0;
+	reader.stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+	BOOST_CHECK_EQUAL(foo, bar);
+
+	producer.join();
+
+	BOOST_CHECK_EQUAL(written, static_cast<ssize_t>(content.size()));
+}
+
+BOOST_AUTO_TEST_CASE(read_write_pipe_streaming_truncated)
+{
+	transient_directory tmp_dir;
+	const auto tmp_file = (tmp_dir.path / "stream.bin").native();
+
+	std::vector<std::uint64_t> values(1000);
+	for (std::uint64_t i = 0; i < values.size(); ++i) {
+		values[i] = i;
+	}
+
+	// What goes through the stream, saved as is
+	{
+		auto writer = Writer::create_streaming(::open(tmp_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666),
+		                                       TestMDWriter::dummy_md(), 4096);
+		writer.stream().write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(std::uint64_t));
+		BOOST_CHECK(*std::move(writer).finalize());
+	}
+
+	// The trailer isn't part of the payload, which must be read from the stream
+	BOOST_CHECK_THROW(Reader::open(tmp_file.c_str()), reven::binresource::ReaderError);
+
+	const auto read_all = [&tmp_file](std::vector<std::uint64_t>& read) {
+		auto reader = Reader::open_streaming(::open(tmp_file.c_str(), O_RDONLY | O_CLOEXEC), 4096);
+
+		std::uint64_t value = 0;
+		while (reader.stream().read(reinterpret_cast<char*>(&value), sizeof(value))) {
+			read.push_back(value);
+		}
+
+		return !reader.stream().bad();
+	};
+
+	std::vector<std::uint64_t> read;
+	BOOST_CHECK(read_all(read));
+	BOOST_CHECK(read == values);
+
+	// A stream cut anywhere is detected, even within the trailer
+	const auto size = boost::filesystem::file_size(tmp_file);
+
+	for (const auto cut : {1, 16, 17, 4096}) {
+		boost::filesystem::resize_file(tmp_file, size - cut);
+
+		read.clear();
+		BOOST_CHECK(!read_all(read));
+		BOOST_CHECK(read.size() * sizeof(std::uint64_t) <= size - cut);
+	}
+}
@@ -0,0 +1,199 @@
+#define BOOST_TEST_MODULE RVN_BINRESOURCE_RESOURCE_CACHE
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include "common.h"
+#include "metadata.h"
+#include "reader.h"
+#include "resource_cache.h"
+#include "writer.h"
+
+using MD = reven::binresource::Metadata;
+using Reader = reven::binresource::Reader;
+using Writer = reven::binresource::Writer;
+using ResourceCache = reven::binresource::ResourceCache;
+using CacheLimits = reven::binresource::CacheLimits;
+
+class TestMDWriter : reven::binresource::MetadataWriter {
+public:
+	static MD dummy_md() {
+		return write(42, "1.0.0-dummy", "TestMetaDataWriter", "1.0.0", "Tests version 1.0.0", 42424242);
+	}
+
+	static MD dummy_md2() {
+		return write(24, "1.2.0-dummy", "TestMetaDataWriter2", "1.2.0", "Tests version 1.2.0", 42424243);
+	}
+};
+
+struct transient_directory {
+	//! Path of created directory.
+	boost::filesystem::path path;
+
+	//! Create a uniquely named temporary directory in base_dir.
+	//! A suffix is generated and appended to the given prefix to ensure the directory name is unique.
+	//! Throw if directory cannot be created.
+	transient_directory(const boost::filesystem::path& base_dir = boost::filesystem::temp_directory_path(),
+	                    std::string prefix = {}) {
+		boost::filesystem::path tmp_path = boost::filesystem::unique_path(prefix + "%%%%-%%%%-%%%%-%%%%");
+		tmp_path = base_dir / tmp_path;
+
+		if (!boost::filesystem::create_directories(tmp_path)) {
+			throw std::runtime_error(("Can't create the directory " + tmp_path.native()).c_str());
+		}
+
+		this->path = tmp_path;
+	}
+
+	//! Delete created directory.
+	~transient_directory() {
+		boost::filesystem::remove_all(this->path);
+	}
+};
+
+constexpr std::uint64_t foo = 0x42424242424242;
+
+void write_resource(const boost::filesystem::path& path, const MD& md, std::size_t count = 1) {
+	auto writer = Writer::create(path.c_str(), md);
+
+	for (std::size_t i = 0; i < count; ++i) {
+		writer.stream().write(reinterpret_cast<const char*>(&foo), sizeof(foo));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(hit_and_miss)
+{
+	transient_directory tmp_dir{};
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+	write_resource(tmp_file, TestMDWriter::dummy_md());
+
+	ResourceCache cache;
+
+	auto reader = cache.open(tmp_file.c_str());
+	auto reader2 = cache.open(tmp_file.c_str());
+
+	BOOST_CHECK_EQUAL(reader.get(), reader2.get());
+	BOOST_CHECK_EQUAL(reader->metadata().type(), 42);
+
+	std::uint64_t bar = 0;
+	reader2->stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+	BOOST_CHECK_EQUAL(foo, bar);
+
+	const auto stats = cache.stats();
+	BOOST_CHECK_EQUAL(stats.hits, 1);
+	BOOST_CHECK_EQUAL(stats.misses, 1);
+	BOOST_CHECK_EQUAL(stats.evictions, 0);
+	BOOST_CHECK_EQUAL(stats.open, 1);
+	BOOST_CHECK(stats.memory > reader->md_size());
+}
+
+BOOST_AUTO_TEST_CASE(evict_least_recently_used)
+{
+	transient_directory tmp_dir{};
+	const auto file_a = tmp_dir.path / "a.bin";
+	const auto file_b = tmp_dir.path / "b.bin";
+	const auto file_c = tmp_dir.path / "c.bin";
+	write_resource(file_a, TestMDWriter::dummy_md());
+	write_resource(file_b, TestMDWriter::dummy_md());
+	write_resource(file_c, TestMDWriter::dummy_md());
+
+	CacheLimits limits;
+	limits.max_open = 2;
+	ResourceCache cache(limits);
+
+	auto reader_a = cache.open(file_a.c_str());
+	cache.open(file_b.c_str());
+	// a is now the most recently used
+	cache.open(file_a.c_str());
+	// b is evicted
+	cache.open(file_c.c_str());
+
+	BOOST_CHECK_EQUAL(cache.stats().evictions, 1);
+	BOOST_CHECK_EQUAL(cache.stats().open, 2);
+
+	BOOST_CHECK_EQUAL(cache.open(file_a.c_str()).get(), reader_a.get());
+	BOOST_CHECK_EQUAL(cache.stats().hits, 2);
+
+	cache.open(file_b.c_str());
+	BOOST_CHECK_EQUAL(cache.stats().misses, 4);
+
+	// An evicted reader stays valid for its users
+	limits.max_open = 0;
+	cache.set_limits(limits);
+	BOOST_CHECK_EQUAL(cache.stats().open, 0);
+	BOOST_CHECK_EQUAL(reader_a->metadata().type(), 42);
+}
+
+BOOST_AUTO_TEST_CASE(evict_memory)
+{
+	transient_directory tmp_dir{};
+	const auto file_a = tmp_dir.path / "a.bin";
+	const auto file_b = tmp_dir.path / "b.bin";
+	write_resource(file_a, TestMDWriter::dummy_md());
+	write_resource(file_b, TestMDWriter::dummy_md());
+
+	ResourceCache cache;
+	cache.open(file_a.c_str());
+
+	CacheLimits limits;
+	limits.max_memory = cache.stats().memory;
+	cache.set_limits(limits);
+
+	cache.open(file_b.c_str());
+
+	BOOST_CHECK_EQUAL(cache.stats().open, 1);
+	BOOST_CHECK_EQUAL(cache.stats().evictions, 1);
+}
+
+BOOST_AUTO_TEST_CASE(default_limits)
+{
+	transient_directory tmp_dir{};
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+	write_resource(tmp_file, TestMDWriter::dummy_md());
+
+	// The default limits allow to keep `max_open` resources open
+	ResourceCache cache;
+	cache.open(tmp_file.c_str());
+
+	const CacheLimits limits;
+	BOOST_CHECK_LE(cache.stats().memory * limits.max_open, limits.max_memory);
+
+	// The buffer of the readers dominates their cost
+	auto options = ResourceCache::default_reader_options();
+	options.buffer_size = 16 * reven::binresource::default_cached_stream_buffer_size;
+
+	ResourceCache large_cache(limits, options);
+	large_cache.open(tmp_file.c_str());
+
+	BOOST_CHECK_GT(large_cache.stats().memory, limits.max_memory / limits.max_open);
+}
+
+BOOST_AUTO_TEST_CASE(reopen_modified_file)
+{
+	transient_directory tmp_dir{};
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+	write_resource(tmp_file, TestMDWriter::dummy_md());
+
+	ResourceCache cache;
+	auto reader = cache.open(tmp_file.c_str());
+
+	write_resource(tmp_file, TestMDWriter::dummy_md2(), 2);
+
+	auto reader2 = cache.open(tmp_file.c_str());
+
+	BOOST_CHECK_NE(reader.get(), reader2.get());
+	BOOST_CHECK_EQUAL(reader->metadata().type(), 42);
+	BOOST_CHECK_EQUAL(reader2->metadata().type(), 24);
+	BOOST_CHECK_EQUAL(cache.stats().misses, 2);
+	BOOST_CHECK_EQUAL(cache.stats().open, 1);
+}
+
+BOOST_AUTO_TEST_CASE(missing_file)
+{
+	transient_directory tmp_dir{};
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	ResourceCache cache;
+
+	BOOST_CHECK_THROW(cache.open(tmp_file.c_str()), reven::binresource::ReaderError);
+	BOOST_CHECK_EQUAL(cache.stats().open, 0);
+}
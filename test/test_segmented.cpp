@@ -0,0 +1,232 @@
+#define BOOST_TEST_MODULE RVN_BINRESOURCE_SEGMENTED
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include <thread>
+#include <vector>
+
+#include "metadata.h"
+#include "reader.h"
+#include "segmented.h"
+
+using MD = reven::binresource::Metadata;
+using SegmentedReader = reven::binresource::SegmentedReader;
+using SegmentedWriter = reven::binresource::SegmentedWriter;
+
+class TestMDWriter : reven::binresource::MetadataWriter {
+public:
+	static MD dummy_md() {
+		return write(42, "1.0.0-dummy", "TestMetaDataWriter", "1.0.0", "Tests version 1.0.0", 42424242);
+	}
+
+	static MD dummy_md2() {
+		return write(24, "1.2.0-dummy", "TestMetaDataWriter2", "1.2.0", "Tests version 1.2.0", 42424243);
+	}
+};
+
+struct transient_directory {
+	//! Path of created directory.
+	boost::filesystem::path path;
+
+	//! Create a uniquely named temporary directory in base_dir.
+	//! A suffix is generated and appended to the given prefix to ensure the directory name is unique.
+	//! Throw if directory cannot be created.
+	transient_directory(const boost::filesystem::path& base_dir = boost::filesystem::temp_directory_path(),
+	                    std::string prefix = {}) {
+		boost::filesystem::path tmp_path = boost::filesystem::unique_path(prefix + "%%%%-%%%%-%%%%-%%%%");
+		tmp_path = base_dir / tmp_path;
+
+		if (!boost::filesystem::create_directories(tmp_path)) {
+			throw std::runtime_error(("Can't create the directory " + tmp_path.native()).c_str());
+		}
+
+		this->path = tmp_path;
+	}
+
+	//! Delete created directory.
+	~transient_directory() {
+		boost::filesystem::remove_all(this->path);
+	}
+};
+
+
+constexpr std::uint64_t count = 100000;
+constexpr std::uint64_t segment_size = 64 * 1024;
+
+// Write the integers up to `count`, in several calls not aligned on the segments
+void write_integers(SegmentedWriter& writer) {
+	std::vector<std::uint64_t> chunk;
+
+	for (std::uint64_t i = 0; i < count; ++i) {
+		chunk.push_back(i);
+
+		if (chunk.size() == 1000 || i + 1 == count) {
+			writer.write(chunk.data(), chunk.size() * sizeof(std::uint64_t));
+			chunk.clear();
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(segmented_write_read)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	auto writer = SegmentedWriter::create(tmp_file.c_str(), TestMDWriter::dummy_md(), segment_size);
+	write_integers(writer);
+
+	const auto segment_count = (count * sizeof(std::uint64_t) + segment_size - 1) / segment_size;
+
+	BOOST_CHECK_EQUAL(writer.size(), count * sizeof(std::uint64_t));
+	BOOST_CHECK_EQUAL(writer.segment_count(), segment_count);
+
+	std::move(writer).finalize();
+
+	auto reader = SegmentedReader::open(tmp_file.c_str());
+
+	BOOST_CHECK_EQUAL(reader.size(), count * sizeof(std::uint64_t));
+	BOOST_REQUIRE_EQUAL(reader.segment_count(), segment_count);
+	BOOST_CHECK_EQUAL(reader.metadata().tool_name(), TestMDWriter::dummy_md().tool_name());
+
+	// Each segment is a standalone resource
+	for (std::size_t i = 0; i < segment_count; ++i) {
+		BOOST_CHECK_EQUAL(reader.segment_offset(i), i * segment_size);
+		BOOST_CHECK(boost::filesystem::exists(reven::binresource::segment_filename(tmp_file.c_str(), i)));
+	}
+
+	// A range spanning several segments
+	std::vector<std::uint64_t> values(30000);
+	const auto first = 5000;
+
+	const auto read = reader.read_at(first * sizeof(std::uint64_t), values.data(), values.size() * sizeof(std::uint64_t));
+	BOOST_REQUIRE_EQUAL(read, values.size() * sizeof(std::uint64_t));
+
+	for (std::size_t i = 0; i < values.size(); ++i) {
+		BOOST_REQUIRE_EQUAL(values[i], first + i);
+	}
+
+	// Up to the end of the payload
+	BOOST_CHECK_EQUAL(reader.read_at((count - 10) * sizeof(std::uint64_t), values.data(), 100), 10 * sizeof(std::uint64_t));
+	BOOST_CHECK_EQUAL(values[9], count - 1);
+	BOOST_CHECK_EQUAL(reader.read_at(count * sizeof(std::uint64_t), values.data(), 100), 0);
+}
+
+BOOST_AUTO_TEST_CASE(segmented_read_parallel)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	auto writer = SegmentedWriter::create(tmp_file.c_str(), TestMDWriter::dummy_md(), segment_size);
+	write_integers(writer);
+	std::move(writer).finalize();
+
+	auto reader = SegmentedReader::open(tmp_file.c_str());
+
+	// Each thread reads its segments with their own stream
+	std::vector<char> valid(reader.segment_count(), false);
+	std::vector<std::thread> threads;
+
+	for (std::size_t t = 0; t < 4; ++t) {
+		threads.emplace_back([&reader, &valid, t] {
+			for (std::size_t i = t; i < reader.segment_count(); i += 4) {
+				auto& segment = reader.segment(i);
+				std::uint64_t expected = reader.segment_offset(i) / sizeof(std::uint64_t);
+				std::uint64_t value = 0;
+
+				bool ok = true;
+				while (segment.stream().read(reinterpret_cast<char*>(&value), sizeof(value))) {
+					ok = ok && value == expected++;
+				}
+
+				valid[i] = ok && expected * sizeof(std::uint64_t) == reader.segment_offset(i + 1);
+			}
+		});
+	}
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	for (std::size_t i = 0; i < valid.size(); ++i) {
+		BOOST_CHECK(valid[i]);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(segmented_set_metadata_and_rewrite)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	{
+		auto writer = SegmentedWriter::create(tmp_file.c_str(), TestMDWriter::dummy_md(), segment_size);
+		write_integers(writer);
+		writer.set_metadata(TestMDWriter::dummy_md2());
+		std::move(writer).finalize();
+	}
+
+	{
+		auto reader = SegmentedReader::open(tmp_file.c_str());
+
+		for (std::size_t i = 0; i < reader.segment_count(); ++i) {
+			BOOST_CHECK_EQUAL(reader.segment(i).metadata().tool_name(), TestMDWriter::dummy_md2().tool_name());
+		}
+	}
+
+	// The segments of the previous resource are removed
+	{
+		auto writer = SegmentedWriter::create(tmp_file.c_str(), TestMDWriter::dummy_md(), 4 * segment_size);
+		write_integers(writer);
+		std::move(writer).finalize();
+	}
+
+	auto reader = SegmentedReader::open(tmp_file.c_str());
+
+	BOOST_CHECK_EQUAL(reader.segment_count(), (count * sizeof(std::uint64_t) + 4 * segment_size - 1) / (4 * segment_size));
+	BOOST_CHECK_EQUAL(reader.size(), count * sizeof(std::uint64_t));
+	BOOST_CHECK_EQUAL(reader.metadata().tool_name(), TestMDWriter::dummy_md().tool_name());
+}
+
+BOOST_AUTO_TEST_CASE(segmented_not_finalized)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+	const auto segment_count = (count * sizeof(std::uint64_t) + segment_size - 1) / segment_size;
+
+	{
+		auto writer = SegmentedWriter::create(tmp_file.c_str(), TestMDWriter::dummy_md(), segment_size);
+		write_integers(writer);
+		std::move(writer).finalize();
+	}
+
+	// Abandoned before writing as many segments as the previous resource
+	{
+		auto writer = SegmentedWriter::create(tmp_file.c_str(), TestMDWriter::dummy_md(), segment_size);
+		const std::uint64_t data[segment_size / sizeof(std::uint64_t)] = {};
+		writer.write(data, sizeof(data));
+		writer.write(data, sizeof(data));
+	}
+
+	// The segments left by the previous resource aren't part of this one
+	{
+		auto reader = SegmentedReader::open(tmp_file.c_str());
+
+		BOOST_CHECK_EQUAL(reader.segment_count(), 2);
+		BOOST_CHECK_EQUAL(reader.size(), 2 * segment_size);
+	}
+
+	{
+		auto writer = SegmentedWriter::create(tmp_file.c_str(), TestMDWriter::dummy_md(), segment_size);
+		write_integers(writer);
+		std::move(writer).finalize();
+	}
+
+	BOOST_CHECK_EQUAL(SegmentedReader::open(tmp_file.c_str()).segment_count(), segment_count);
+
+	// A finalized resource must have all its segments
+	boost::filesystem::remove(reven::binresource::segment_filename(tmp_file.c_str(), segment_count - 1));
+	BOOST_CHECK_THROW(SegmentedReader::open(tmp_file.c_str()), reven::binresource::ReaderError);
+}
@@ -0,0 +1,152 @@
+#define BOOST_TEST_MODULE RVN_BINRESOURCE_SHARDED_WRITER
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "metadata.h"
+#include "reader.h"
+#include "sharded_writer.h"
+
+using MD = reven::binresource::Metadata;
+using Reader = reven::binresource::Reader;
+using ShardedWriter = reven::binresource::ShardedWriter;
+
+class TestMDWriter : reven::binresource::MetadataWriter {
+public:
+	static MD dummy_md() {
+		return write(42, "1.0.0-dummy", "TestMetaDataWriter", "1.0.0", "Tests version 1.0.0", 42424242);
+	}
+
+	static MD dummy_md2() {
+		return write(24, "1.2.0-dummy", "TestMetaDataWriter2", "1.2.0", "Tests version 1.2.0", 42424243);
+	}
+};
+
+struct transient_directory {
+	//! Path of created directory.
+	boost::filesystem::path path;
+
+	//! Create a uniquely named temporary directory in base_dir.
+	//! A suffix is generated and appended to the given prefix to ensure the directory name is unique.
+	//! Throw if directory cannot be created.
+	transient_directory(const boost::filesystem::path& base_dir = boost::filesystem::temp_directory_path(),
+	                    std::string prefix = {}) {
+		boost::filesystem::path tmp_path = boost::filesystem::unique_path(prefix + "%%%%-%%%%-%%%%-%%%%");
+		tmp_path = base_dir / tmp_path;
+
+		if (!boost::filesystem::create_directories(tmp_path)) {
+			throw std::runtime_error(("Can't create the directory " + tmp_path.native()).c_str());
+		}
+
+		this->path = tmp_path;
+	}
+
+	//! Delete created directory.
+	~transient_directory() {
+		boost::filesystem::remove_all(this->path);
+	}
+};
+
+constexpr std::size_t thread_count = 4;
+constexpr std::size_t records_per_thread = 1000;
+
+// The record `i` is `i % 16 + 1` copies of `i`
+std::vector<std::uint64_t> record(std::uint64_t i) {
+	return std::vector<std::uint64_t>(i % 16 + 1, i);
+}
+
+// Each thread writes the records whose sequence number modulo thread_count is its index
+void write_records(ShardedWriter& writer) {
+	std::vector<std::thread> threads;
+	for (std::size_t t = 0; t < thread_count; ++t) {
+		threads.emplace_back([&writer, t]() {
+			auto& shard = writer.shard();
+
+			for (std::uint64_t i = t; i < thread_count * records_per_thread; i += thread_count) {
+				const auto data = record(i);
+				shard.write(i, data.data(), data.size() * sizeof(std::uint64_t));
+			}
+		});
+	}
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+void check_records(std::istream& stream) {
+	for (std::uint64_t i = 0; i < thread_count * records_per_thread; ++i) {
+		const auto expected = record(i);
+
+		std::vector<std::uint64_t> data(expected.size());
+		stream.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(std::uint64_t));
+
+		BOOST_REQUIRE(data == expected);
+	}
+
+	char c;
+	stream.read(&c, 1);
+	BOOST_CHECK(stream.eof());
+}
+
+BOOST_AUTO_TEST_CASE(sharded_file)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	auto writer = ShardedWriter::create(tmp_file.c_str(), TestMDWriter::dummy_md());
+	write_records(writer);
+	std::move(writer).finalize();
+
+	auto reader = Reader::open(tmp_file.c_str());
+	BOOST_CHECK_EQUAL(reader.metadata().tool_info(), TestMDWriter::dummy_md().tool_info());
+	check_records(reader.stream());
+}
+
+BOOST_AUTO_TEST_CASE(sharded_file_spilled)
+{
+	transient_directory tmp_dir{};
+
+	const auto tmp_file = tmp_dir.path / "foo.bin";
+
+	// Spill each shard several times
+	auto writer = ShardedWriter::create(tmp_file.c_str(), TestMDWriter::dummy_md(), {}, 4096);
+	write_records(writer);
+	std::move(writer).finalize();
+
+	// The temporary files are gone
+	BOOST_CHECK_EQUAL(std::distance(boost::filesystem::directory_iterator(tmp_dir.path),
+	                                boost::filesystem::directory_iterator()), 1);
+
+	auto reader = Reader::open(tmp_file.c_str());
+	check_records(reader.stream());
+}
+
+BOOST_AUTO_TEST_CASE(sharded_stringstream_out_of_order)
+{
+	auto writer = ShardedWriter::create(std::make_unique<std::stringstream>(), TestMDWriter::dummy_md(), 64);
+
+	auto& first = writer.shard();
+	auto& second = writer.shard();
+
+	// Out of order in a shard, and the same sequence number in both shards
+	const std::string records[] = {"d", "b", "c1", "a", "c2"};
+	second.write(3, records[0].data(), records[0].size());
+	first.write(1, records[1].data(), records[1].size());
+	first.write(2, records[2].data(), records[2].size());
+	first.write(0, records[3].data(), records[3].size());
+	second.write(2, records[4].data(), records[4].size());
+
+	auto stream = std::move(writer).finalize();
+
+	auto reader = Reader::open(std::unique_ptr<std::istream>(static_cast<std::stringstream*>(stream.release())));
+
+	std::string payload(7, '\0');
+	reader.stream().read(&payload[0], payload.size());
+	BOOST_CHECK_EQUAL(reader.stream().gcount(), 7);
+	BOOST_CHECK_EQUAL(payload, "abc1c2d");
+}
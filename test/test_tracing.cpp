@@ -0,0 +1,171 @@
+#define BOOST_TEST_MODULE RVN_BINRESOURCE_TRACING
+#include <boost/test/unit_test.hpp>
+
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "common.h"
+#include "metadata.h"
+#include "reader.h"
+#include "tracing.h"
+#include "writer.h"
+
+using MD = reven::binresource::Metadata;
+using Reader = reven::binresource::Reader;
+using Writer = reven::binresource::Writer;
+using TraceEvent = reven::binresource::TraceEvent;
+using TraceEventType = reven::binresource::TraceEventType;
+
+class TestMDWriter : reven::binresource::MetadataWriter {
+public:
+	static MD dummy_md() {
+		return write(42, "1.0.0-dummy", "TestMetaDataWriter", "1.0.0", "Tests version 1.0.0", 42424242);
+	}
+};
+
+constexpr std::uint64_t foo = 0x42424242424242;
+
+class RecordingTracer : public reven::binresource::Tracer {
+public:
+	void begin(const TraceEvent& event) override {
+		std::lock_guard<std::mutex> lock(mutex);
+		begins.push_back(event.type);
+	}
+
+	void end(const TraceEvent& event) override {
+		std::lock_guard<std::mutex> lock(mutex);
+		ends.push_back(event);
+	}
+
+	std::mutex mutex;
+	std::vector<TraceEventType> begins;
+	std::vector<TraceEvent> ends;
+};
+
+//! Remove the tracer at the end of the test
+struct scoped_tracer {
+	scoped_tracer(std::shared_ptr<reven::binresource::Tracer> tracer) {
+		reven::binresource::set_tracer(std::move(tracer));
+	}
+
+	~scoped_tracer() {
+		reven::binresource::set_tracer(nullptr);
+	}
+};
+
+BOOST_AUTO_TEST_CASE(trace_events)
+{
+	auto tracer = std::make_shared<RecordingTracer>();
+
+	std::unique_ptr<std::stringstream> stream;
+
+	{
+		scoped_tracer scope(tracer);
+		BOOST_CHECK_EQUAL(reven::binresource::tracer(), tracer);
+
+		auto writer = Writer::create(std::make_unique<std::stringstream>(), TestMDWriter::dummy_md());
+		writer.stream().write(reinterpret_cast<const char*>(&foo), sizeof(foo));
+		writer.set_metadata(TestMDWriter::dummy_md());
+
+		stream.reset(static_cast<std::stringstream*>(std::move(writer).finalize().release()));
+		stream->seekg(0);
+	}
+
+	BOOST_CHECK(reven::binresource::tracer() == nullptr);
+
+	const auto writer_events = tracer->ends.size();
+	BOOST_REQUIRE(writer_events >= 3);
+	BOOST_CHECK_EQUAL(tracer->begins.size(), writer_events);
+
+	BOOST_CHECK(tracer->ends[0].type == TraceEventType::WriterCreate);
+	BOOST_CHECK(tracer->ends[1].type == TraceEventType::Write);
+	BOOST_CHECK_EQUAL(tracer->ends[1].offset, tracer->ends[0].size);
+	BOOST_CHECK_EQUAL(tracer->ends[1].size, sizeof(foo));
+	BOOST_CHECK_EQUAL(std::string(tracer->ends[1].path), "");
+
+	bool set_metadata_found = false;
+	for (const auto& event : tracer->ends) {
+		set_metadata_found |= event.type == TraceEventType::WriterSetMetadata;
+	}
+	BOOST_CHECK(set_metadata_found);
+
+	// Not traced anymore
+	auto reader = Reader::open(std::move(stream));
+	std::uint64_t bar = 0;
+	reader.stream().read(reinterpret_cast<char*>(&bar), sizeof(bar));
+	BOOST_CHECK_EQUAL(foo, bar);
+	BOOST_CHECK_EQUAL(tracer->ends.size(), writer_events);
+}
+
+//! Stream counting the queries of its position
+class CountingStream : public std::ostream {
+public:
+	CountingStream() : std::ostream(nullptr) { rdbuf(&buf_); }
+
+	std::size_t queries() const { return buf_.queries; }
+
+private:
+	struct Buf : std::stringbuf {
+		pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+			queries += off == 0 && dir == std::ios_base::cur;
+			return std::stringbuf::seekoff(off, dir, which);
+		}
+
+		std::size_t queries = 0;
+	};
+
+	Buf buf_;
+};
+
+BOOST_AUTO_TEST_CASE(trace_offsets_tracked)
+{
+	auto tracer = std::make_shared<RecordingTracer>();
+	scoped_tracer scope(tracer);
+
+	auto stream = std::make_unique<CountingStream>();
+	auto* counting = stream.get();
+
+	auto writer = Writer::create(std::move(stream), TestMDWriter::dummy_md());
+	const auto queries = counting->queries();
+
+	for (int i = 0; i < 10; ++i) {
+		writer.stream().write(reinterpret_cast<const char*>(&foo), sizeof(foo));
+	}
+
+	// The position is only queried once, and then tracked
+	BOOST_CHECK_LE(counting->queries(), queries + 1);
+
+	std::vector<std::uint64_t> offsets;
+	for (const auto& event : tracer->ends) {
+		if (event.type == TraceEventType::Write) {
+			offsets.push_back(event.offset);
+		}
+	}
+
+	BOOST_REQUIRE_EQUAL(offsets.size(), 10);
+	for (std::size_t i = 0; i < offsets.size(); ++i) {
+		BOOST_CHECK_EQUAL(offsets[i], writer.md_size() + i * sizeof(foo));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(chrome_trace_sink)
+{
+	std::stringstream out;
+
+	{
+		auto sink = std::make_shared<reven::binresource::ChromeTraceSink>(out);
+		scoped_tracer scope(sink);
+
+		auto writer = Writer::create(std::make_unique<std::stringstream>(), TestMDWriter::dummy_md());
+		writer.stream().write(reinterpret_cast<const char*>(&foo), sizeof(foo));
+	}
+
+	const auto trace = out.str();
+
+	BOOST_CHECK_EQUAL(trace.front(), '[');
+	BOOST_CHECK_EQUAL(trace.substr(trace.size() - 2), "]\n");
+	BOOST_CHECK(trace.find("\"name\":\"Writer::create\"") != std::string::npos);
+	BOOST_CHECK(trace.find("\"name\":\"write\"") != std::string::npos);
+	BOOST_CHECK(trace.find("\"ph\":\"X\"") != std::string::npos);
+}
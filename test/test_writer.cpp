@@ -48,7 +48,8 @@ BOOST_AUTO_TEST_CASE(written_metadata)
 	std::uint32_t written_metadata_version = 0;
 	stream->read(reinterpret_cast<char*>(&written_metadata_version), sizeof(written_metadata_version));
 
-	BOOST_CHECK_EQUAL(written_metadata_version, reven::binresource::metadata_version);
+	// The resources written to a stream have no extension, as with the metadata version 1
+	BOOST_CHECK_EQUAL(written_metadata_version, 1u);
 
 	const auto md2 = MD::deserialize(written_metadata_version, *stream);
 
@@ -180,7 +181,8 @@ BOOST_AUTO_TEST_CASE(set_metadata)
 	std::uint32_t written_metadata_version = 0;
 	stream->read(reinterpret_cast<char*>(&written_metadata_version), sizeof(written_metadata_version));
 
-	BOOST_CHECK_EQUAL(written_metadata_version, reven::binresource::metadata_version);
+	// The resources written to a stream have no extension, as with the metadata version 1
+	BOOST_CHECK_EQUAL(written_metadata_version, 1u);
 
 	const auto md2 = MD::deserialize(written_metadata_version, *stream);
 
@@ -212,3 +214,10 @@ BOOST_AUTO_TEST_CASE(write_uint64)
 
 	BOOST_CHECK_EQUAL(foo, written_foo);
 }
+
+BOOST_AUTO_TEST_CASE(map_not_mapped)
+{
+	auto writer = Writer::create(std::make_unique<std::stringstream>(), TestMDWriter::dummy_md());
+
+	BOOST_CHECK_THROW(writer.map(8), reven::binresource::WriterError);
+}